@@ -0,0 +1,257 @@
+#include "../src/affine_simd.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <fmt/format.h>
+#include <glm/gtx/quaternion.hpp>
+
+using namespace cinder::types;
+using FpMili = std::chrono::duration<f64, std::chrono::milliseconds::period>;
+
+static auto affine_to_mat4(glm::mat4x3 const & transform) -> glm::mat4
+{
+    return glm::mat4(
+        glm::vec4(transform[0], 0.0f),
+        glm::vec4(transform[1], 0.0f),
+        glm::vec4(transform[2], 0.0f),
+        glm::vec4(transform[3], 1.0f));
+}
+
+/// NOTE: Rotation, non uniform scale and translation, far enough from singular for a stable inverse.
+static auto random_transform(std::mt19937 & rng) -> glm::mat4x3
+{
+    std::uniform_real_distribution<f32> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<f32> scale(0.5f, 2.0f);
+    glm::vec3 const axis_x = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(2.0f, 0.0f, 0.0f));
+    glm::vec3 const axis_y = glm::normalize(glm::cross(glm::vec3(unit(rng), unit(rng), 1.5f), axis_x));
+    glm::vec3 const axis_z = glm::cross(axis_x, axis_y);
+    glm::mat4x3 transform = {};
+    transform[0] = axis_x * scale(rng);
+    transform[1] = axis_y * scale(rng);
+    transform[2] = axis_z * scale(rng);
+    transform[3] = glm::vec3(unit(rng), unit(rng), unit(rng)) * 100.0f;
+    return transform;
+}
+
+static auto random_trs(std::mt19937 & rng) -> cinder::Trs
+{
+    std::uniform_real_distribution<f32> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<f32> scale(0.5f, 2.0f);
+    return {
+        .translation = glm::vec3(unit(rng), unit(rng), unit(rng)) * 100.0f,
+        .rotation = glm::normalize(glm::quat(unit(rng), unit(rng), unit(rng), unit(rng))),
+        .scale = glm::vec3(scale(rng), scale(rng), scale(rng)),
+    };
+}
+
+static auto random_aabb(std::mt19937 & rng) -> cinder::Aabb
+{
+    std::uniform_real_distribution<f32> unit(-10.0f, 10.0f);
+    glm::vec3 const a = {unit(rng), unit(rng), unit(rng)};
+    glm::vec3 const b = {unit(rng), unit(rng), unit(rng)};
+    return {glm::min(a, b), glm::max(a, b)};
+}
+
+static auto max_difference(f32 const * a, f32 const * b, u32 count) -> f32
+{
+    f32 difference = 0.0f;
+    for (u32 i = 0; i < count; ++i)
+    {
+        difference = std::max(difference, std::abs(a[i] - b[i]) / std::max(1.0f, std::abs(b[i])));
+    }
+    return difference;
+}
+
+struct GlmReference
+{
+    static auto compose(glm::mat4x3 const & lhs, glm::mat4x3 const & rhs) -> glm::mat4x3
+    {
+        return glm::mat4x3(affine_to_mat4(lhs) * affine_to_mat4(rhs));
+    }
+    static auto inverse(glm::mat4x3 const & transform) -> glm::mat4x3
+    {
+        return glm::mat4x3(glm::inverse(affine_to_mat4(transform)));
+    }
+    // Transforms all eight corners.
+    static auto transform_aabb(glm::mat4x3 const & transform, cinder::Aabb const & aabb) -> cinder::Aabb
+    {
+        cinder::Aabb result = {glm::vec3(INFINITY), glm::vec3(-INFINITY)};
+        for (u32 corner = 0; corner < 8; ++corner)
+        {
+            glm::vec3 const point = {
+                (corner & 1) ? aabb.max.x : aabb.min.x,
+                (corner & 2) ? aabb.max.y : aabb.min.y,
+                (corner & 4) ? aabb.max.z : aabb.min.z,
+            };
+            glm::vec3 const transformed = transform * glm::vec4(point, 1.0f);
+            result.min = glm::min(result.min, transformed);
+            result.max = glm::max(result.max, transformed);
+        }
+        return result;
+    }
+    // The matrix product the gltf loader built for TRS nodes.
+    static auto from_trs(cinder::Trs const & trs) -> glm::mat4x3
+    {
+        auto const scale = glm::scale(glm::identity<glm::mat4x4>(), trs.scale);
+        auto const rotation = glm::toMat4(trs.rotation);
+        auto const translation = glm::translate(glm::identity<glm::mat4x4>(), trs.translation);
+        return glm::mat4x3(translation * (rotation * scale));
+    }
+    // The element wise transpose Scene::create_and_record_build_as used.
+    static void store_row_major_3x4(glm::mat4x3 const & t, f32 * out)
+    {
+        f32 const rows[12] = {
+            t[0][0], t[1][0], t[2][0], t[3][0],
+            t[0][1], t[1][1], t[2][1], t[3][1],
+            t[0][2], t[1][2], t[2][2], t[3][2],
+        };
+        std::copy(std::begin(rows), std::end(rows), out);
+    }
+};
+
+/// NOTE: Batch sizes are odd so the AVX2 kernels also run their single matrix tail.
+static auto check_against_glm() -> bool
+{
+    static constexpr u32 COUNT = 1001;
+    std::mt19937 rng{7};
+    std::vector<glm::mat4x3> lhs(COUNT), rhs(COUNT), out(COUNT);
+    std::vector<cinder::Aabb> aabbs(COUNT), out_aabbs(COUNT);
+    std::vector<cinder::Trs> trs(COUNT);
+    for (u32 i = 0; i < COUNT; ++i)
+    {
+        lhs[i] = random_transform(rng);
+        rhs[i] = random_transform(rng);
+        aabbs[i] = random_aabb(rng);
+        trs[i] = random_trs(rng);
+    }
+    auto report = [](char const * kernel, u32 index, f32 difference)
+    {
+        fmt::print("{} differs from glm at {} by {}\n", kernel, index, difference);
+        return false;
+    };
+
+    cinder::affine::compose(lhs, rhs, out);
+    for (u32 i = 0; i < COUNT; ++i)
+    {
+        glm::mat4x3 const expected = GlmReference::compose(lhs[i], rhs[i]);
+        glm::mat4x3 const single = cinder::affine::compose(lhs[i], rhs[i]);
+        // Same summation order as glm, the results have to be bit identical.
+        if (!(out[i] == expected) || !(single == expected)) { return report("compose", i, max_difference(&out[i][0].x, &expected[0].x, 12)); }
+    }
+
+    cinder::affine::inverse(lhs, out);
+    for (u32 i = 0; i < COUNT; ++i)
+    {
+        glm::mat4x3 const expected = GlmReference::inverse(lhs[i]);
+        glm::mat4x3 const single = cinder::affine::inverse(lhs[i]);
+        f32 const difference = std::max(max_difference(&out[i][0].x, &expected[0].x, 12), max_difference(&single[0].x, &expected[0].x, 12));
+        if (difference > 1e-4f) { return report("inverse", i, difference); }
+    }
+
+    cinder::affine::transform_aabbs(lhs, aabbs, out_aabbs);
+    for (u32 i = 0; i < COUNT; ++i)
+    {
+        cinder::Aabb const expected = GlmReference::transform_aabb(lhs[i], aabbs[i]);
+        cinder::Aabb const single = cinder::affine::transform_aabb(lhs[i], aabbs[i]);
+        f32 const difference = std::max(max_difference(&out_aabbs[i].min.x, &expected.min.x, 6), max_difference(&single.min.x, &expected.min.x, 6));
+        if (difference > 1e-4f) { return report("transform_aabb", i, difference); }
+    }
+
+    for (u32 i = 0; i < COUNT; ++i)
+    {
+        glm::mat4x3 const expected = GlmReference::from_trs(trs[i]);
+        glm::mat4x3 const matrix = cinder::affine::from_trs(trs[i]);
+        f32 const difference = max_difference(&matrix[0].x, &expected[0].x, 12);
+        if (difference > 1e-5f) { return report("from_trs", i, difference); }
+    }
+
+    /// NOTE: Written with a stride like the instance array, the padding between outputs has to stay untouched.
+    static constexpr u32 STRIDE = 16;
+    std::vector<f32> rows(COUNT * STRIDE, -1.0f);
+    cinder::affine::store_row_major_3x4(lhs, rows.data(), STRIDE);
+    for (u32 i = 0; i < COUNT; ++i)
+    {
+        f32 expected[STRIDE] = {};
+        std::fill(std::begin(expected), std::end(expected), -1.0f);
+        GlmReference::store_row_major_3x4(lhs[i], expected);
+        f32 single[12] = {};
+        cinder::affine::store_row_major_3x4(lhs[i], single);
+        if (!std::equal(expected, expected + STRIDE, rows.data() + i * STRIDE) || !std::equal(single, single + 12, expected))
+        {
+            return report("store_row_major_3x4", i, max_difference(rows.data() + i * STRIDE, expected, STRIDE));
+        }
+    }
+    return true;
+}
+
+template <typename FnT>
+static auto time_ms(u32 repetitions, FnT && fn) -> f64
+{
+    f64 best = INFINITY;
+    for (u32 repetition = 0; repetition < repetitions; ++repetition)
+    {
+        auto const start = std::chrono::steady_clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main()
+{
+    if (!check_against_glm())
+    {
+        return 1;
+    }
+#if defined(CINDER_AFFINE_AVX2)
+    char const * const kernels = "AVX2";
+#elif defined(CINDER_AFFINE_SSE)
+    char const * const kernels = "SSE";
+#else
+    char const * const kernels = "scalar";
+#endif
+    fmt::print("{} kernels match glm\n", kernels);
+
+    static constexpr u32 COUNT = 1'000'000;
+    static constexpr u32 REPETITIONS = 5;
+    std::mt19937 rng{42};
+    std::vector<glm::mat4x3> lhs(COUNT), rhs(COUNT), out(COUNT);
+    std::vector<cinder::Aabb> aabbs(COUNT), out_aabbs(COUNT);
+    std::vector<f32> rows(COUNT * 12);
+    std::vector<cinder::Trs> trs(COUNT);
+    for (u32 i = 0; i < COUNT; ++i)
+    {
+        lhs[i] = random_transform(rng);
+        rhs[i] = random_transform(rng);
+        aabbs[i] = random_aabb(rng);
+        trs[i] = random_trs(rng);
+    }
+
+    fmt::print("{} matrices, best of {} runs\n", COUNT, REPETITIONS);
+    fmt::print("{:>20} | {:>10} | {:>10} | {:>8}\n", "kernel", "glm ms", "affine ms", "speedup");
+    auto print_row = [](char const * kernel, f64 glm_ms, f64 simd_ms)
+    {
+        fmt::print("{:>20} | {:>10.3f} | {:>10.3f} | {:>7.2f}x\n", kernel, glm_ms, simd_ms, glm_ms / simd_ms);
+    };
+    print_row("compose",
+        time_ms(REPETITIONS, [&] { for (u32 i = 0; i < COUNT; ++i) { out[i] = GlmReference::compose(lhs[i], rhs[i]); } }),
+        time_ms(REPETITIONS, [&] { cinder::affine::compose(lhs, rhs, out); }));
+    print_row("inverse",
+        time_ms(REPETITIONS, [&] { for (u32 i = 0; i < COUNT; ++i) { out[i] = GlmReference::inverse(lhs[i]); } }),
+        time_ms(REPETITIONS, [&] { cinder::affine::inverse(lhs, out); }));
+    print_row("transform_aabb",
+        time_ms(REPETITIONS, [&] { for (u32 i = 0; i < COUNT; ++i) { out_aabbs[i] = GlmReference::transform_aabb(lhs[i], aabbs[i]); } }),
+        time_ms(REPETITIONS, [&] { cinder::affine::transform_aabbs(lhs, aabbs, out_aabbs); }));
+    print_row("store_row_major_3x4",
+        time_ms(REPETITIONS, [&] { for (u32 i = 0; i < COUNT; ++i) { GlmReference::store_row_major_3x4(lhs[i], rows.data() + i * 12); } }),
+        time_ms(REPETITIONS, [&] { cinder::affine::store_row_major_3x4(lhs, rows.data(), 12); }));
+    print_row("from_trs",
+        time_ms(REPETITIONS, [&] { for (u32 i = 0; i < COUNT; ++i) { out[i] = GlmReference::from_trs(trs[i]); } }),
+        time_ms(REPETITIONS, [&] { for (u32 i = 0; i < COUNT; ++i) { out[i] = cinder::affine::from_trs(trs[i]); } }));
+    /// NOTE: Keeps the outputs alive so the glm loops are not optimized away.
+    f32 checksum = out[COUNT / 2][3][0] + out_aabbs[COUNT / 3].min.x + rows[COUNT * 6];
+    fmt::print("checksum {}\n", checksum);
+    return 0;
+}
@@ -0,0 +1,190 @@
+#include "../src/concurrent_slot_map.hpp"
+#include "../src/slot_map.hpp"
+
+#include <algorithm>
+#include <barrier>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <fmt/format.h>
+
+using namespace cinder::types;
+using FpMili = std::chrono::duration<f64, std::chrono::milliseconds::period>;
+
+/// NOTE: Knows the id it was created for, a reader that finds anything else saw a recycled or torn slot.
+//        The string is long enough to live on the heap, reading a destroyed value shows up in asan builds.
+struct StressValue
+{
+    u32 index = {};
+    u32 version = {};
+    u64 checksum = {};
+    std::string name = {};
+};
+
+static auto stress_checksum(u32 index, u32 version) -> u64
+{
+    return (u64(index) * 0x9E3779B97F4A7C15ull) ^ version;
+}
+
+static constexpr std::string_view STRESS_NAME = "stress value with a name that does not fit into sso";
+
+/// NOTE: The baseline, the single threaded SlotMap behind one mutex.
+struct LockedSlotMap
+{
+    using Id = cinder::SlotMap<StressValue>::Id;
+    std::mutex mutex = {};
+    cinder::SlotMap<StressValue> map = {};
+    void reclaim_destroyed_slots() {}
+};
+
+struct ConcurrentMapOps
+{
+    using MapT = cinder::ConcurrentSlotMap<StressValue>;
+    using Id = MapT::Id;
+    static auto create(MapT & map) -> Id
+    {
+        Id const id = map.create_slot();
+        /// NOTE: Only the creating thread knows the id yet, nobody else can look at the value.
+        StressValue & value = *map.slot(id);
+        value = StressValue{.index = id.index, .version = id.version, .checksum = stress_checksum(id.index, id.version), .name = std::string{STRESS_NAME}};
+        return id;
+    }
+    static auto destroy(MapT & map, Id id) -> bool { return map.destroy_slot(id); }
+    template <typename FnT>
+    static void visit(MapT & map, Id id, FnT && fn)
+    {
+        if (StressValue const * value = map.slot(id)) { fn(*value); }
+    }
+};
+
+struct LockedMapOps
+{
+    using MapT = LockedSlotMap;
+    using Id = MapT::Id;
+    static auto create(MapT & map) -> Id
+    {
+        std::lock_guard lock{map.mutex};
+        Id const id = map.map.create_slot();
+        *map.map.slot(id) = StressValue{.index = id.index, .version = id.version, .checksum = stress_checksum(id.index, id.version), .name = std::string{STRESS_NAME}};
+        return id;
+    }
+    static auto destroy(MapT & map, Id id) -> bool
+    {
+        std::lock_guard lock{map.mutex};
+        return map.map.destroy_slot(id);
+    }
+    template <typename FnT>
+    static void visit(MapT & map, Id id, FnT && fn)
+    {
+        std::lock_guard lock{map.mutex};
+        if (StressValue const * value = map.map.slot(id)) { fn(*value); }
+    }
+};
+
+struct StressResult
+{
+    f64 mops_per_s = {};
+    u64 corrupted_reads = {};
+    u64 live_mismatch = {};
+};
+
+/// NOTE: Every thread runs a mix of lookups (60%), creates (20%) and destroys (20%) on ids shared through a table.
+//        The threads meet at a barrier after every round, that is where destroyed slots are reclaimed (the frame end).
+template <typename OpsT>
+static auto stress(u32 thread_count, u32 rounds, u32 ops_per_round) -> StressResult
+{
+    using MapT = typename OpsT::MapT;
+    using Id = typename OpsT::Id;
+    static constexpr u32 SHARED_IDS = 1u << 14u;
+    MapT map = {};
+    std::vector<std::atomic_uint64_t> shared_ids(SHARED_IDS);
+    auto pack = [](Id id) { return (u64(id.version) << 32ull) | id.index; };
+    auto unpack = [](u64 packed) { return Id{s_cast<u32>(packed), s_cast<u32>(packed >> 32ull)}; };
+    for (u32 i = 0; i < SHARED_IDS; ++i) { shared_ids[i] = pack(OpsT::create(map)); }
+
+    std::atomic_int64_t live = SHARED_IDS;
+    std::atomic_uint64_t corrupted_reads = {};
+    std::barrier round_end{s_cast<std::ptrdiff_t>(thread_count), [&]() noexcept
+        { map.reclaim_destroyed_slots(); }};
+    auto run = [&](u32 thread_index)
+    {
+        std::mt19937 rng{thread_index + 1};
+        for (u32 round = 0; round < rounds; ++round)
+        {
+            for (u32 op = 0; op < ops_per_round; ++op)
+            {
+                u32 const roll = rng() % 10;
+                std::atomic_uint64_t & shared = shared_ids[rng() % SHARED_IDS];
+                if (roll < 6)
+                {
+                    Id const id = unpack(shared.load(std::memory_order_acquire));
+                    OpsT::visit(map, id, [&](StressValue const & value)
+                        {
+                            bool const intact = value.index == id.index && value.version == id.version &&
+                                                value.checksum == stress_checksum(id.index, id.version) && value.name == STRESS_NAME;
+                            if (!intact) { corrupted_reads.fetch_add(1, std::memory_order_relaxed); } });
+                }
+                else if (roll < 8)
+                {
+                    Id const id = OpsT::create(map);
+                    live.fetch_add(1, std::memory_order_relaxed);
+                    // The replaced id is simply forgotten, it stays alive until the end of the run.
+                    shared.store(pack(id), std::memory_order_release);
+                }
+                else
+                {
+                    if (OpsT::destroy(map, unpack(shared.load(std::memory_order_acquire)))) { live.fetch_sub(1, std::memory_order_relaxed); }
+                }
+            }
+            round_end.arrive_and_wait();
+        }
+    };
+    auto const start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads = {};
+    for (u32 thread_index = 1; thread_index < thread_count; ++thread_index) { threads.emplace_back(run, thread_index); }
+    run(0);
+    for (std::thread & thread : threads) { thread.join(); }
+    f64 const ms = std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - start).count();
+
+    StressResult result = {};
+    result.mops_per_s = (u64(thread_count) * rounds * ops_per_round) / (ms * 1000.0);
+    result.corrupted_reads = corrupted_reads.load();
+    if constexpr (std::is_same_v<OpsT, ConcurrentMapOps>)
+    {
+        result.live_mismatch = s_cast<u64>(std::abs(s_cast<i64>(map.size()) - live.load()));
+    }
+    else
+    {
+        result.live_mismatch = s_cast<u64>(std::abs(s_cast<i64>(map.map.size()) - live.load()));
+    }
+    return result;
+}
+
+int main()
+{
+    u32 const max_threads = std::max(2u, std::thread::hardware_concurrency());
+    u32 const rounds = 64;
+    u32 const ops_per_round = 20'000;
+    fmt::print("{:>8} | {:>22} | {:>22} | {:>10}\n", "threads", "ConcurrentSlotMap Mops/s", "mutex + SlotMap Mops/s", "failures");
+    bool failed = false;
+    std::vector<u32> thread_counts = {};
+    for (u32 thread_count = 1; thread_count < max_threads; thread_count *= 2) { thread_counts.push_back(thread_count); }
+    thread_counts.push_back(max_threads);
+    for (u32 const thread_count : thread_counts)
+    {
+        StressResult const concurrent = stress<ConcurrentMapOps>(thread_count, rounds, ops_per_round);
+        StressResult const locked = stress<LockedMapOps>(thread_count, rounds, ops_per_round);
+        u64 const failures = concurrent.corrupted_reads + concurrent.live_mismatch + locked.corrupted_reads + locked.live_mismatch;
+        fmt::print("{:>8} | {:>22.3f} | {:>22.3f} | {:>10}\n", thread_count, concurrent.mops_per_s, locked.mops_per_s, failures);
+        failed = failed || failures != 0;
+    }
+    if (failed)
+    {
+        fmt::print("Stress test found corrupted reads or a wrong live count\n");
+        return 1;
+    }
+    return 0;
+}
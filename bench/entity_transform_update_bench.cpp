@@ -0,0 +1,265 @@
+#include "../src/scene/entity_transform_update.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <thread>
+#include <fmt/format.h>
+
+using namespace cinder::types;
+using FpMili = std::chrono::duration<f64, std::chrono::milliseconds::period>;
+
+struct UpdateBenchEntity;
+using UpdateBenchSlotMap = cinder::DenseSlotMap<UpdateBenchEntity>;
+using UpdateBenchId = UpdateBenchSlotMap::Id;
+
+/// NOTE: The part of a RenderEntity the transform update touches.
+struct UpdateBenchEntity
+{
+    cinder::Trs local_transform = {};
+    glm::mat4x3 transform = {};
+    glm::mat4x3 combined_transform = {};
+    std::optional<UpdateBenchId> parent = {};
+};
+
+/// NOTE: Holds the same state as Scene and runs the same transform update as Scene::set_transforms and
+//        Scene::record_gpu_manifest_update, see scene/entity_transform_update.hpp.
+struct BenchScene
+{
+    UpdateBenchSlotMap entities = {};
+    TransformHierarchy transform_hierarchy = {};
+    bool transform_hierarchy_changed = {};
+    RenderEntitySoA soa = {};
+    std::vector<ModifiedEntityTransform<UpdateBenchId>> modified_entities = {};
+
+    auto create_entity(cinder::Trs const & local_transform, std::optional<UpdateBenchId> parent) -> UpdateBenchId
+    {
+        transform_hierarchy_changed = true;
+        return entities.create_slot({.local_transform = local_transform, .parent = parent});
+    }
+
+    auto set_transforms(std::span<UpdateBenchId const> ids, std::span<cinder::Trs const> transforms) -> bool
+    {
+        return !set_entity_transforms(entities, ids, transforms).has_value();
+    }
+
+    struct UpdateTimes
+    {
+        f64 local_ms = {};
+        f64 propagate_ms = {};
+    };
+    auto update(ThreadPool * thread_pool) -> UpdateTimes
+    {
+        UpdateTimes times = {};
+        if (transform_hierarchy_changed)
+        {
+            rebuild_transform_hierarchy(entities, transform_hierarchy);
+            transform_hierarchy_changed = false;
+        }
+        EntityTransformUpdateInfo<UpdateBenchEntity> const transform_update = {
+            .entities = entities,
+            .hierarchy = transform_hierarchy,
+            .soa = soa,
+            .thread_pool = thread_pool,
+        };
+        auto const local_start = std::chrono::steady_clock::now();
+        build_local_transforms(transform_update);
+        auto const propagate_start = std::chrono::steady_clock::now();
+        times.local_ms = std::chrono::duration_cast<FpMili>(propagate_start - local_start).count();
+        propagate_entity_transforms(transform_update, modified_entities, [](u32, UpdateBenchEntity const &) {});
+        times.propagate_ms = std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - propagate_start).count();
+        entities.clear_dirty();
+        return times;
+    }
+};
+
+static auto random_trs(std::mt19937 & rng) -> cinder::Trs
+{
+    std::uniform_real_distribution<f32> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<f32> scale(0.9f, 1.1f);
+    return {
+        .translation = glm::vec3(unit(rng), unit(rng), unit(rng)),
+        .rotation = glm::normalize(glm::quat(2.0f, unit(rng), unit(rng), unit(rng))),
+        .scale = glm::vec3(scale(rng), scale(rng), scale(rng)),
+    };
+}
+
+/// NOTE: Creates entity_count entities, the parent of every entity is one of the entities created before it or none.
+static auto make_scene(u32 entity_count, u32 root_every, std::mt19937 & rng) -> std::pair<BenchScene, std::vector<UpdateBenchId>>
+{
+    BenchScene scene = {};
+    std::vector<UpdateBenchId> ids = {};
+    ids.reserve(entity_count);
+    for (u32 i = 0; i < entity_count; ++i)
+    {
+        std::optional<UpdateBenchId> parent = {};
+        if (i % root_every != 0) { parent = ids[i - 1 - rng() % std::min(i % root_every, 8u)]; }
+        ids.push_back(scene.create_entity(random_trs(rng), parent));
+    }
+    return {std::move(scene), std::move(ids)};
+}
+
+/// NOTE: Combined transforms recomputed from scratch in creation order, parents are created before their children.
+//        Same operations as the propagation, so the results have to be identical.
+static auto expected_combined_transforms(BenchScene const & scene, std::span<UpdateBenchId const> ids) -> std::vector<glm::mat4x3>
+{
+    std::vector<glm::mat4x3> combined(scene.entities.capacity());
+    for (UpdateBenchId const id : ids)
+    {
+        UpdateBenchEntity const & entity = *scene.entities.slot(id);
+        glm::mat4x3 const local = cinder::affine::from_trs(entity.local_transform);
+        combined[id.index] = !entity.parent.has_value() ? local : cinder::affine::compose(combined[entity.parent->index], local);
+    }
+    return combined;
+}
+
+static auto check_set_transforms() -> std::optional<std::string>
+{
+    std::mt19937 rng{3};
+    auto [scene, ids] = make_scene(4096, 64, rng);
+    scene.update(nullptr);
+
+    /// NOTE: Batches with a stale id or mismatching sizes are rejected as a whole.
+    UpdateBenchId const stale_id = scene.entities.create_slot();
+    scene.entities.destroy_slot(stale_id);
+    scene.entities.clear_dirty();
+    std::vector<UpdateBenchId> batch = {ids[1], ids[2], stale_id};
+    std::vector<cinder::Trs> transforms = {random_trs(rng), random_trs(rng), random_trs(rng)};
+    cinder::Trs const before = scene.entities.slot(ids[1])->local_transform;
+    if (scene.set_transforms(batch, transforms) || scene.set_transforms(std::span{batch}.first(2), transforms))
+    {
+        return "an invalid batch was accepted";
+    }
+    if (scene.entities.dirty_count() != 0 || !(scene.entities.slot(ids[1])->local_transform.translation == before.translation))
+    {
+        return "an invalid batch changed entities";
+    }
+
+    for (u32 frame = 0; frame < 32; ++frame)
+    {
+        std::vector<glm::mat4x3> previous(scene.entities.capacity() + 16);
+        for (UpdateBenchId const id : ids) { previous[id.index] = scene.entities.slot(id)->combined_transform; }
+        /// NOTE: Random entities, some of them set several times in one frame.
+        batch.resize(1 + rng() % 256);
+        transforms.resize(batch.size());
+        for (usize i = 0; i < batch.size(); ++i)
+        {
+            batch[i] = ids[rng() % ids.size()];
+            transforms[i] = random_trs(rng);
+        }
+        if (!scene.set_transforms(batch, transforms)) { return "a valid batch was rejected"; }
+        // New entities are propagated but have no previous transform.
+        std::vector<u32> created_slots = {};
+        for (u32 i = 0; frame % 4 == 0 && i < 1 + rng() % 16; ++i)
+        {
+            ids.push_back(scene.create_entity(random_trs(rng), ids[rng() % ids.size()]));
+            created_slots.push_back(ids.back().index);
+        }
+        scene.update(nullptr);
+
+        std::vector<glm::mat4x3> const expected = expected_combined_transforms(scene, ids);
+        std::vector<bool> moved(scene.entities.capacity(), false);
+        usize moved_count = 0;
+        for (UpdateBenchId const id : ids)
+        {
+            if (!(scene.entities.slot(id)->combined_transform == expected[id.index]))
+            {
+                return fmt::format("frame {}: entity {} has a stale combined transform", frame, id.index);
+            }
+            bool const is_new = std::find(created_slots.begin(), created_slots.end(), id.index) != created_slots.end();
+            if (!is_new && !(previous[id.index] == expected[id.index])) { moved[id.index] = true; moved_count += 1; }
+        }
+        /// NOTE: Every existing entity whose combined transform changed has to be listed with both transforms.
+        //        Entities set to a transform they already had may be listed too.
+        usize listed_moved = 0;
+        for (ModifiedEntityTransform<UpdateBenchId> const & modified : scene.modified_entities)
+        {
+            u32 const slot_index = modified.entity.index;
+            if (std::find(created_slots.begin(), created_slots.end(), slot_index) != created_slots.end())
+            {
+                return fmt::format("frame {}: new entity {} is listed as moved", frame, slot_index);
+            }
+            if (!(glm::mat4x3(modified.prev_transform) == previous[slot_index]) || !(glm::mat4x3(modified.curr_transform) == expected[slot_index]))
+            {
+                return fmt::format("frame {}: entity {} lists wrong transforms", frame, slot_index);
+            }
+            listed_moved += moved[slot_index] ? 1 : 0;
+        }
+        if (listed_moved != moved_count)
+        {
+            return fmt::format("frame {}: {} entities moved, {} of them listed", frame, moved_count, listed_moved);
+        }
+    }
+    return std::nullopt;
+}
+
+static auto bench_thread_counts(u32 max_threads) -> std::vector<u32>
+{
+    std::vector<u32> thread_counts = {};
+    for (u32 thread_count = 1; thread_count < max_threads; thread_count *= 2) { thread_counts.push_back(thread_count); }
+    thread_counts.push_back(max_threads);
+    return thread_counts;
+}
+
+int main()
+{
+    if (std::optional<std::string> const error = check_set_transforms())
+    {
+        fmt::print("{}\n", error.value());
+        return 1;
+    }
+    fmt::print("set_transforms rejects invalid batches, updates match a full recompute and list every moved entity\n");
+
+    static constexpr u32 ENTITY_COUNT = 500'000;
+    static constexpr u32 UPDATES_PER_FRAME = 100'000;
+    static constexpr u32 FRAMES = 8;
+    u32 const max_thread_count = std::max(1u, std::thread::hardware_concurrency());
+    std::mt19937 rng{17};
+    auto [scene, ids] = make_scene(ENTITY_COUNT, 32, rng);
+    scene.update(nullptr);
+    /// NOTE: Frames are generated up front, the bench measures the scene and not the random numbers.
+    std::vector<std::vector<UpdateBenchId>> frame_ids(FRAMES, std::vector<UpdateBenchId>(UPDATES_PER_FRAME));
+    std::vector<std::vector<cinder::Trs>> frame_transforms(FRAMES, std::vector<cinder::Trs>(UPDATES_PER_FRAME));
+    for (u32 frame = 0; frame < FRAMES; ++frame)
+    {
+        for (u32 i = 0; i < UPDATES_PER_FRAME; ++i)
+        {
+            frame_ids[frame][i] = ids[rng() % ids.size()];
+            frame_transforms[frame][i] = random_trs(rng);
+        }
+    }
+
+    fmt::print("{} entities in chains of up to 32, {} random entities set per frame, {} hardware threads\n", ENTITY_COUNT, UPDATES_PER_FRAME, max_thread_count);
+    fmt::print("{:>10} | {:>18} | {:>14} | {:>14} | {:>12} | {:>10}\n", "workers", "set_transforms ms", "local ms", "propagate ms", "moved", "upload MiB");
+    std::vector<u32> worker_counts = bench_thread_counts(max_thread_count);
+    worker_counts.insert(worker_counts.begin(), 0);
+    for (u32 const worker_count : worker_counts)
+    {
+        std::optional<ThreadPool> thread_pool = {};
+        if (worker_count != 0) { thread_pool.emplace(worker_count); }
+        f64 set_ms = 0.0;
+        BenchScene::UpdateTimes times = {};
+        usize moved = 0;
+        usize upload_bytes = 0;
+        for (u32 frame = 0; frame < FRAMES; ++frame)
+        {
+            auto const start = std::chrono::steady_clock::now();
+            if (!scene.set_transforms(frame_ids[frame], frame_transforms[frame])) { return 1; }
+            set_ms += std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - start).count();
+            BenchScene::UpdateTimes const frame_times = scene.update(thread_pool.has_value() ? &thread_pool.value() : nullptr);
+            times.local_ms += frame_times.local_ms;
+            times.propagate_ms += frame_times.propagate_ms;
+            moved += scene.modified_entities.size();
+            upload_bytes += scene.soa.plan_dense_upload().staging_size(RenderEntitySoA::PACKED_ENTITY_SIZE) +
+                            scene.soa.plan_slot_upload().staging_size(RenderEntitySoA::SLOT_ENTRY_SIZE);
+            scene.soa.clear_dirty();
+        }
+        fmt::print("{:>10} | {:>18.3f} | {:>14.3f} | {:>14.3f} | {:>12} | {:>10.3f}\n",
+            worker_count == 0 ? std::string("serial") : std::to_string(worker_count), set_ms / FRAMES,
+            times.local_ms / FRAMES, times.propagate_ms / FRAMES, moved / FRAMES, upload_bytes / (FRAMES * 1024.0 * 1024.0));
+    }
+    return 0;
+}
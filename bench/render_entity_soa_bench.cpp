@@ -0,0 +1,259 @@
+#include "../src/scene/render_entity_soa.hpp"
+#include "../src/slot_map.hpp"
+#include "../src/shader_shared/geometry.inl"
+
+#include <chrono>
+#include <cstring>
+#include <optional>
+#include <random>
+#include <string>
+#include <fmt/format.h>
+
+using namespace cinder::types;
+using FpMili = std::chrono::duration<f64, std::chrono::milliseconds::period>;
+
+/// NOTE: The part of a RenderEntity the packed arrays mirror.
+struct SoaBenchEntity
+{
+    glm::mat4x3 transform = {};
+    u32 parent = RenderEntitySoA::INVALID_INDEX;
+    u32 mesh_group = INVALID_MANIFEST_INDEX;
+};
+using SoaBenchSlotMap = cinder::DenseSlotMap<SoaBenchEntity>;
+
+static auto bench_transform(u32 seed) -> glm::mat4x3
+{
+    glm::mat4x3 transform = glm::identity<glm::mat4x3>();
+    transform[3] = glm::vec3(s_cast<f32>(seed), s_cast<f32>(seed % 7), s_cast<f32>(seed % 13));
+    return transform;
+}
+
+static void write_entity(RenderEntitySoA & soa, SoaBenchSlotMap::Id id, SoaBenchEntity const & entity)
+{
+    u32 const dense_index = soa.prepare_write(id.index);
+    soa.transforms[dense_index] = entity.transform;
+    soa.combined_transforms[dense_index] = entity.transform;
+    soa.parents[dense_index] = entity.parent;
+    soa.mesh_groups[dense_index] = entity.mesh_group;
+}
+
+/// NOTE: Stands in for the gpu buffers, receives the same planned uploads Scene::record_gpu_manifest_update records.
+struct MirrorBuffers
+{
+    std::vector<glm::mat4x3> transforms = {};
+    std::vector<glm::mat4x3> combined_transforms = {};
+    std::vector<u32> parents = {};
+    std::vector<u32> mesh_groups = {};
+    std::vector<u32> dense_to_slot = {};
+    std::vector<u32> slot_to_dense = {};
+    u32 copy_count = {};
+    u32 scatter_count = {};
+    usize uploaded_bytes = {};
+    // Set when a plan reaches past the end of the cpu array, removed tails must not be uploaded.
+    bool out_of_bounds = {};
+};
+
+template <typename T>
+static void upload_planned(MirrorBuffers & mirror, std::vector<T> & dst, std::vector<T> const & src, UploadPlan const & plan)
+{
+    for (UploadPlan::Range const range : plan.copies)
+    {
+        if (range.end > src.size())
+        {
+            mirror.out_of_bounds = true;
+            continue;
+        }
+        if (dst.size() < range.end) { dst.resize(range.end); }
+        std::memcpy(dst.data() + range.begin, src.data() + range.begin, sizeof(T) * (range.end - range.begin));
+        mirror.copy_count += 1;
+    }
+    for (u32 const index : plan.scatter_indices)
+    {
+        if (index >= src.size())
+        {
+            mirror.out_of_bounds = true;
+            continue;
+        }
+        if (dst.size() <= index) { dst.resize(index + 1); }
+        dst[index] = src[index];
+    }
+    mirror.scatter_count += plan.scatter_indices.empty() ? 0 : 1;
+}
+
+static void upload(MirrorBuffers & mirror, RenderEntitySoA & soa, UploadPlanInfo const & plan_info = {})
+{
+    UploadPlan const dense_plan = soa.plan_dense_upload(plan_info);
+    UploadPlan const slot_plan = soa.plan_slot_upload(plan_info);
+    upload_planned(mirror, mirror.transforms, soa.transforms, dense_plan);
+    upload_planned(mirror, mirror.combined_transforms, soa.combined_transforms, dense_plan);
+    upload_planned(mirror, mirror.parents, soa.parents, dense_plan);
+    upload_planned(mirror, mirror.mesh_groups, soa.mesh_groups, dense_plan);
+    upload_planned(mirror, mirror.dense_to_slot, soa.dense_to_slot, dense_plan);
+    upload_planned(mirror, mirror.slot_to_dense, soa.slot_to_dense, slot_plan);
+    mirror.uploaded_bytes += dense_plan.staging_size(RenderEntitySoA::PACKED_ENTITY_SIZE) + slot_plan.staging_size(RenderEntitySoA::SLOT_ENTRY_SIZE);
+    soa.clear_dirty();
+}
+
+/// NOTE: Checks the packed arrays and their uploaded mirror against the slot map, returns the first mismatch.
+static auto validate(SoaBenchSlotMap const & map, RenderEntitySoA const & soa, MirrorBuffers const & mirror) -> std::optional<std::string>
+{
+    if (mirror.out_of_bounds)
+    {
+        return fmt::format("an upload reached past the end of the packed arrays");
+    }
+    if (soa.size() != map.size())
+    {
+        return fmt::format("{} packed entities, {} in the slot map", soa.size(), map.size());
+    }
+    for (usize map_dense_index = 0; map_dense_index < map.size(); ++map_dense_index)
+    {
+        SoaBenchSlotMap::Id const id = map.id_by_dense_index(map_dense_index);
+        SoaBenchEntity const & entity = map.values()[map_dense_index];
+        u32 const dense_index = soa.dense_index(id.index);
+        if (dense_index >= soa.size() || soa.dense_to_slot[dense_index] != id.index)
+        {
+            return fmt::format("slot {} is not in the sparse set", id.index);
+        }
+        if (!(soa.transforms[dense_index] == entity.transform) || soa.parents[dense_index] != entity.parent || soa.mesh_groups[dense_index] != entity.mesh_group)
+        {
+            return fmt::format("slot {} holds stale data", id.index);
+        }
+        if (!(mirror.transforms[dense_index] == entity.transform) || mirror.parents[dense_index] != entity.parent ||
+            mirror.mesh_groups[dense_index] != entity.mesh_group || mirror.dense_to_slot[dense_index] != id.index || mirror.slot_to_dense[id.index] != dense_index)
+        {
+            return fmt::format("upload of slot {} is stale", id.index);
+        }
+    }
+    // Together with the sizes matching, every other slot has to be empty.
+    for (u32 slot_index = 0; slot_index < soa.slot_to_dense.size(); ++slot_index)
+    {
+        u32 const dense_index = soa.slot_to_dense[slot_index];
+        bool const mirrored_empty = slot_index >= mirror.slot_to_dense.size() || mirror.slot_to_dense[slot_index] == RenderEntitySoA::INVALID_INDEX;
+        if (dense_index == RenderEntitySoA::INVALID_INDEX ? !mirrored_empty : soa.dense_to_slot[dense_index] != slot_index)
+        {
+            return fmt::format("slot {} is mapped inconsistently", slot_index);
+        }
+    }
+    return std::nullopt;
+}
+
+static auto check_random_sequences() -> bool
+{
+    static constexpr u32 SEQUENCES = 64;
+    static constexpr u32 FRAMES = 64;
+    std::mt19937 rng{7};
+    for (u32 sequence = 0; sequence < SEQUENCES; ++sequence)
+    {
+        SoaBenchSlotMap map = {};
+        RenderEntitySoA soa = {};
+        MirrorBuffers mirror = {};
+        std::vector<SoaBenchSlotMap::Id> ids = {};
+        u32 const ops_per_frame = 1 + sequence * 4;
+        for (u32 frame = 0; frame < FRAMES; ++frame)
+        {
+            for (u32 op = 0; op < ops_per_frame; ++op)
+            {
+                u32 const kind = rng() % 8;
+                if (kind < 4 || ids.empty())
+                {
+                    SoaBenchEntity entity = {.transform = bench_transform(rng())};
+                    if (!ids.empty() && kind % 2 == 0) { entity.parent = ids[rng() % ids.size()].index; }
+                    if (kind == 1) { entity.mesh_group = rng() % 1024; }
+                    SoaBenchSlotMap::Id const id = map.create_slot(SoaBenchEntity{entity});
+                    write_entity(soa, id, entity);
+                    ids.push_back(id);
+                }
+                else if (kind < 6)
+                {
+                    usize const victim = rng() % ids.size();
+                    map.destroy_slot(ids[victim]);
+                    soa.remove(ids[victim].index);
+                    ids[victim] = ids.back();
+                    ids.pop_back();
+                }
+                else
+                {
+                    SoaBenchSlotMap::Id const id = ids[rng() % ids.size()];
+                    map.slot(id)->transform = bench_transform(rng());
+                    write_entity(soa, id, *map.slot(id));
+                }
+            }
+            // Without the scatter pipeline everything is copied, both kinds of plans have to end up the same.
+            upload(mirror, soa, frame % 2 == 0 ? UploadPlanInfo{} : UploadPlanInfo{.min_copy_size = 1});
+            if (std::optional<std::string> const error = validate(map, soa, mirror))
+            {
+                fmt::print("Sequence {} frame {}: {}\n", sequence, frame, error.value());
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    if (!check_random_sequences())
+    {
+        return 1;
+    }
+    fmt::print("Packed arrays and their uploads match the slot map after random create/destroy sequences\n");
+
+    /// NOTE: Upload cost of the previous approaches against the planned uploads.
+    //        Per entity was three copies (transform, combined transform, mesh group) per changed entity.
+    //        The single dirty range was one copy per array of everything between the first and last changed entity.
+    u32 const entity_count = 1'000'000;
+    SoaBenchSlotMap map = {};
+    RenderEntitySoA soa = {};
+    MirrorBuffers mirror = {};
+    std::vector<SoaBenchSlotMap::Id> ids(entity_count);
+    for (u32 i = 0; i < entity_count; ++i)
+    {
+        SoaBenchEntity const entity = {.transform = bench_transform(i), .mesh_group = i % 1024};
+        ids[i] = map.create_slot(SoaBenchEntity{entity});
+        write_entity(soa, ids[i], entity);
+    }
+    upload(mirror, soa);
+
+    fmt::print("{} entities, changes per frame in a clustered block, in a few clusters and scattered randomly\n", entity_count);
+    fmt::print("{:>10} | {:>10} | {:>11} | {:>10} | {:>11} | {:>10} | {:>8} | {:>8} | {:>10} | {:>8}\n",
+        "changed", "layout", "per entity", "MiB", "dirty range", "MiB", "copies", "scatters", "MiB", "plan ms");
+    std::mt19937 rng{42};
+    for (u32 const changed : {1u, 100u, 10'000u, 100'000u})
+    {
+        for (u32 const layout : {0u, 1u, 2u})
+        {
+            /// NOTE: Clusters of 64 entities stand in for moving a few objects made of many nodes.
+            u32 const cluster_size = layout == 0 ? changed : (layout == 1 ? std::min(changed, 64u) : 1u);
+            for (u32 i = 0; i < changed; i += cluster_size)
+            {
+                u32 const first = rng() % (entity_count - cluster_size);
+                for (u32 j = 0; j < std::min(cluster_size, changed - i); ++j)
+                {
+                    SoaBenchSlotMap::Id const id = ids[first + j];
+                    map.slot(id)->transform = bench_transform(rng());
+                    write_entity(soa, id, *map.slot(id));
+                }
+            }
+            UploadPlan const range_plan = soa.plan_dense_upload({.max_gap = entity_count, .min_copy_size = 1});
+            usize const range_bytes = range_plan.staging_size(RenderEntitySoA::PACKED_ENTITY_SIZE);
+            u32 const dirty_count = s_cast<u32>(soa.dirty_dense.dirty_count());
+            usize const per_entity_bytes = (sizeof(glm::mat4x3) * 2 + sizeof(u32)) * dirty_count;
+            mirror.copy_count = 0;
+            mirror.scatter_count = 0;
+            mirror.uploaded_bytes = 0;
+            auto const start = std::chrono::steady_clock::now();
+            upload(mirror, soa);
+            f64 const plan_ms = std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - start).count();
+            fmt::print("{:>10} | {:>10} | {:>11} | {:>10.3f} | {:>11} | {:>10.3f} | {:>8} | {:>8} | {:>10.3f} | {:>8.3f}\n",
+                dirty_count, layout == 0 ? "block" : (layout == 1 ? "clusters" : "scattered"), dirty_count * 3,
+                per_entity_bytes / (1024.0 * 1024.0), range_plan.command_count() * 5, range_bytes / (1024.0 * 1024.0),
+                mirror.copy_count, mirror.scatter_count, mirror.uploaded_bytes / (1024.0 * 1024.0), plan_ms);
+        }
+    }
+    if (std::optional<std::string> const error = validate(map, soa, mirror))
+    {
+        fmt::print("{}\n", error.value());
+        return 1;
+    }
+    return 0;
+}
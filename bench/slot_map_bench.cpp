@@ -0,0 +1,185 @@
+#include "../src/slot_map.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <fmt/format.h>
+
+using namespace cinder::types;
+using FpMili = std::chrono::duration<f64, std::chrono::milliseconds::period>;
+
+/// NOTE: Roughly the hot part of a RenderEntity, a 4x3 transform plus a few indices.
+struct BenchEntity
+{
+    f32 transform[12] = {};
+    u32 mesh_group = {};
+    u32 parent = {};
+    u32 flags = {};
+};
+
+template <typename FnT>
+static auto timed_ms(FnT && fn) -> f64
+{
+    auto const start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct SlotMapBenchResult
+{
+    f64 create_ms = {};
+    f64 destroy_half_ms = {};
+    f64 iterate_ms = {};
+    f64 churn_ns_per_op = {};
+    f64 checksum = {};
+};
+
+template <typename SlotMapT, typename IterateFnT>
+static auto bench_slot_map(u32 entity_count, u32 churn_ops, IterateFnT && iterate) -> SlotMapBenchResult
+{
+    SlotMapBenchResult result = {};
+    SlotMapT map = {};
+    using Id = typename SlotMapT::Id;
+    std::vector<Id> ids(entity_count);
+    result.create_ms = timed_ms([&]
+        {
+            for (u32 i = 0; i < entity_count; ++i)
+            {
+                ids[i] = map.create_slot(BenchEntity{.transform = {s_cast<f32>(i)}, .mesh_group = i});
+            } });
+
+    /// NOTE: Same seed for every map, all of them destroy the same entities.
+    std::mt19937 rng{42};
+    std::shuffle(ids.begin(), ids.end(), rng);
+    result.destroy_half_ms = timed_ms([&]
+        {
+            for (u32 i = 0; i < entity_count / 2; ++i) { map.destroy_slot(ids[i]); } });
+    ids.erase(ids.begin(), ids.begin() + entity_count / 2);
+
+    // Several passes, a single one is too short to time reliably.
+    static constexpr u32 ITERATE_PASSES = 10;
+    result.iterate_ms = timed_ms([&]
+        {
+            for (u32 pass = 0; pass < ITERATE_PASSES; ++pass) { result.checksum += iterate(map); } }) / ITERATE_PASSES;
+
+    /// NOTE: Churn, destroy a random live entity and create a new one in its place.
+    std::uniform_int_distribution<usize> pick{0, ids.size() - 1};
+    f64 const churn_ms = timed_ms([&]
+        {
+            for (u32 op = 0; op < churn_ops; ++op)
+            {
+                usize const victim = pick(rng);
+                map.destroy_slot(ids[victim]);
+                ids[victim] = map.create_slot(BenchEntity{.mesh_group = op});
+            } });
+    result.churn_ns_per_op = churn_ms * 1'000'000.0 / churn_ops;
+    return result;
+}
+
+/// NOTE: Like a RenderEntity, the name makes every move of the entity touch the heap.
+struct NamedBenchEntity
+{
+    BenchEntity entity = {};
+    std::string name = {};
+};
+
+struct GrowthBenchResult
+{
+    f64 total_ms = {};
+    f64 worst_insert_us = {};
+    bool first_pointer_stable = {};
+};
+
+/// NOTE: Inserts entity_count named entities one by one and records the slowest single insert, that is the
+//        reallocation of the whole storage for vector backed maps.
+template <typename InsertFnT, typename FirstFnT>
+static auto bench_growth(u32 entity_count, InsertFnT && insert, FirstFnT && first) -> GrowthBenchResult
+{
+    GrowthBenchResult result = {};
+    auto const start = std::chrono::steady_clock::now();
+    insert(0u);
+    NamedBenchEntity const * first_entity = first();
+    for (u32 i = 1; i < entity_count; ++i)
+    {
+        auto const insert_start = std::chrono::steady_clock::now();
+        insert(i);
+        f64 const insert_us = std::chrono::duration_cast<std::chrono::duration<f64, std::micro>>(std::chrono::steady_clock::now() - insert_start).count();
+        result.worst_insert_us = std::max(result.worst_insert_us, insert_us);
+    }
+    result.total_ms = std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - start).count();
+    result.first_pointer_stable = first_entity == first();
+    return result;
+}
+
+int main()
+{
+    u32 const entity_count = 1'000'000;
+    u32 const churn_ops = 1'000'000;
+
+    SlotMapBenchResult const sparse = bench_slot_map<cinder::SlotMap<BenchEntity>>(entity_count, churn_ops, [](cinder::SlotMap<BenchEntity> & map)
+        {
+            f64 sum = 0.0;
+            for (usize i = 0; i < map.capacity(); ++i)
+            {
+                if (BenchEntity const * entity = map.slot_by_index(i)) { sum += entity->transform[0] + entity->mesh_group; }
+            }
+            return sum; });
+    SlotMapBenchResult const dense = bench_slot_map<cinder::DenseSlotMap<BenchEntity>>(entity_count, churn_ops, [](cinder::DenseSlotMap<BenchEntity> & map)
+        {
+            f64 sum = 0.0;
+            /// NOTE: Page by page, every page is a plain contiguous loop.
+            for (usize page = 0; page < map.values().page_count(); ++page)
+            {
+                for (BenchEntity const & entity : map.values().page(page)) { sum += entity.transform[0] + entity.mesh_group; }
+            }
+            return sum; });
+
+    fmt::print("{} entities, half of them destroyed in random order before iterating, {} churn ops\n", entity_count, churn_ops);
+    fmt::print("{:>14} | {:>10} | {:>12} | {:>12} | {:>14}\n", "map", "create ms", "destroy ms", "iterate ms", "churn ns/op");
+    auto print_row = [](char const * name, SlotMapBenchResult const & result)
+    {
+        fmt::print("{:>14} | {:>10.3f} | {:>12.3f} | {:>12.3f} | {:>14.1f}\n",
+            name, result.create_ms, result.destroy_half_ms, result.iterate_ms, result.churn_ns_per_op);
+    };
+    print_row("SlotMap", sparse);
+    print_row("DenseSlotMap", dense);
+
+    auto named = [](u32 i)
+    { return NamedBenchEntity{.entity = {.mesh_group = i}, .name = fmt::format("entity with a name longer than sso {}", i)}; };
+    std::vector<NamedBenchEntity> vector_storage = {};
+    GrowthBenchResult const vector_growth = bench_growth(entity_count, [&](u32 i)
+        { vector_storage.push_back(named(i)); },
+        [&]
+        { return &vector_storage[0]; });
+    cinder::SlotMap<NamedBenchEntity> sparse_storage = {};
+    GrowthBenchResult const sparse_growth = bench_growth(entity_count, [&](u32 i)
+        { sparse_storage.create_slot(named(i)); },
+        [&]
+        { return sparse_storage.slot_by_index(0); });
+    cinder::DenseSlotMap<NamedBenchEntity> dense_storage = {};
+    GrowthBenchResult const dense_growth = bench_growth(entity_count, [&](u32 i)
+        { dense_storage.create_slot(named(i)); },
+        [&]
+        { return &dense_storage.values()[0]; });
+    fmt::print("\n{} named entities inserted one by one\n", entity_count);
+    fmt::print("{:>14} | {:>10} | {:>18} | {:>16}\n", "storage", "total ms", "worst insert us", "pointers stable");
+    auto print_growth_row = [](char const * name, GrowthBenchResult const & result)
+    {
+        fmt::print("{:>14} | {:>10.3f} | {:>18.1f} | {:>16}\n", name, result.total_ms, result.worst_insert_us, result.first_pointer_stable);
+    };
+    print_growth_row("std::vector", vector_growth);
+    print_growth_row("SlotMap", sparse_growth);
+    print_growth_row("DenseSlotMap", dense_growth);
+    if (sparse.checksum != dense.checksum)
+    {
+        fmt::print("Checksum mismatch: {} vs {}\n", sparse.checksum, dense.checksum);
+        return 1;
+    }
+    if (!sparse_growth.first_pointer_stable || !dense_growth.first_pointer_stable)
+    {
+        fmt::print("Growing a slot map moved its values\n");
+        return 1;
+    }
+    return 0;
+}
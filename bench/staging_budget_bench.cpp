@@ -0,0 +1,145 @@
+#include "../src/scene/staging_budget.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+
+using namespace cinder::types;
+using FpMili = std::chrono::duration<f64, std::chrono::milliseconds::period>;
+
+/// NOTE: Stands in for the upload queue of the AssetProcessor. Finished loads hand over their shares, the main thread
+//        releases them when it records the uploads, like AssetProcessor::record_gpu_load_processing_commands.
+struct PendingUploads
+{
+    std::mutex mutex = {};
+    std::vector<u64> reserved_sizes = {};
+    std::atomic<u32> finished_loads = {};
+};
+
+// Like AssetProcessor::process_texture for KTX2 diffuse textures, an image plus its opacity image.
+static auto texture_load(StagingBudgetWait staging_wait, PendingUploads & pending, u64 image_size, u64 opacity_size) -> cinder::task<void>
+{
+    std::optional<std::array<u64, 2>> const reserved = co_await reserve_staging_memory(staging_wait, std::array<u64, 2>{image_size, opacity_size});
+    {
+        std::lock_guard lock{pending.mutex};
+        pending.reserved_sizes.push_back(reserved.value()[0]);
+        pending.reserved_sizes.push_back(reserved.value()[1]);
+    }
+    pending.finished_loads.fetch_add(1);
+}
+
+// Like AssetProcessor::load_mesh, a single staging buffer.
+static auto mesh_load(StagingBudgetWait staging_wait, PendingUploads & pending, u64 size) -> cinder::task<void>
+{
+    std::optional<u64> const reserved = co_await reserve_staging_memory(staging_wait, size);
+    {
+        std::lock_guard lock{pending.mutex};
+        pending.reserved_sizes.push_back(reserved.value());
+    }
+    pending.finished_loads.fetch_add(1);
+}
+
+struct LoadRunResult
+{
+    bool finished = {};
+    u32 finished_loads = {};
+    f64 ms = {};
+};
+
+/// NOTE: Spawns all loads at once, a budget a few textures big keeps most of them waiting. The loads have to finish
+//        with the main thread only releasing the shares of loads that finished.
+static auto run_loads(ThreadPool & thread_pool, u64 budget_size, u32 texture_count, u32 mesh_count, u64 max_size, u32 seed) -> LoadRunResult
+{
+    cinder::AsyncBudget budget{budget_size};
+    PendingUploads pending = {};
+    StagingBudgetWait const staging_wait = {.budget = &budget, .thread_pool = &thread_pool};
+    std::mt19937 rng{seed};
+    std::vector<std::shared_ptr<Task>> loads = {};
+    for (u32 load_index = 0; load_index < texture_count + mesh_count; ++load_index)
+    {
+        u64 const size = 1 + rng() % max_size;
+        if (load_index % (texture_count + mesh_count) < texture_count)
+        {
+            loads.push_back(cinder::spawn(thread_pool, texture_load(staging_wait, pending, size, 1 + size / 4)));
+        }
+        else
+        {
+            loads.push_back(cinder::spawn(thread_pool, mesh_load(staging_wait, pending, size)));
+        }
+    }
+    u32 const load_count = texture_count + mesh_count;
+    auto const start = std::chrono::steady_clock::now();
+    auto const timeout = std::chrono::seconds{10};
+    while (pending.finished_loads.load() < load_count && std::chrono::steady_clock::now() - start < timeout)
+    {
+        std::vector<u64> released = {};
+        {
+            std::lock_guard lock{pending.mutex};
+            released.swap(pending.reserved_sizes);
+        }
+        for (u64 const reserved_size : released)
+        {
+            release_staging_memory(staging_wait, reserved_size);
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds{100});
+    }
+    LoadRunResult result = {
+        .finished = pending.finished_loads.load() == load_count,
+        .finished_loads = pending.finished_loads.load(),
+        .ms = std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - start).count(),
+    };
+    if (!result.finished)
+    {
+        // The stalled loads are never resumed, forget them before the budget goes away.
+        budget.abandon_waiters();
+        return result;
+    }
+    for (std::shared_ptr<Task> const & load : loads)
+    {
+        thread_pool.block_on(load);
+    }
+    {
+        std::lock_guard lock{pending.mutex};
+        for (u64 const reserved_size : pending.reserved_sizes) { release_staging_memory(staging_wait, reserved_size); }
+    }
+    if (budget.in_use() != 0)
+    {
+        fmt::print("{} bytes of the budget are still in use after every share was released\n", budget.in_use());
+        result.finished = false;
+    }
+    return result;
+}
+
+int main()
+{
+    u32 const thread_count = std::max(2u, std::thread::hardware_concurrency());
+    ThreadPool thread_pool{thread_count};
+    fmt::print("{} workers, budget a few staging buffers big, every load spawned at once\n", thread_count);
+    fmt::print("{:>10} | {:>10} | {:>12} | {:>10} | {:>10}\n", "textures", "meshes", "budget", "finished", "ms");
+    struct LoadRun
+    {
+        u32 texture_count = {};
+        u32 mesh_count = {};
+        u64 budget_size = {};
+        u64 max_size = {};
+    };
+    /// NOTE: The last run asks for more than the whole budget per load, those are granted one at a time.
+    for (LoadRun const run : {LoadRun{256, 0, 4096, 1024}, LoadRun{1024, 256, 4096, 1024}, LoadRun{4096, 0, 1024, 1024}, LoadRun{64, 64, 512, 1024}})
+    {
+        LoadRunResult const result = run_loads(thread_pool, run.budget_size, run.texture_count, run.mesh_count, run.max_size, run.texture_count);
+        fmt::print("{:>10} | {:>10} | {:>12} | {:>10} | {:>10.3f}\n",
+            run.texture_count, run.mesh_count, run.budget_size, result.finished_loads, result.ms);
+        if (!result.finished)
+        {
+            fmt::print("Loads stalled waiting for the staging budget\n");
+            return 1;
+        }
+    }
+    fmt::print("Every load finished with a staging budget far smaller than the loads in flight\n");
+    return 0;
+}
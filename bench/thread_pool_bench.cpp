@@ -0,0 +1,529 @@
+#include "../src/multithreading/thread_pool.hpp"
+
+#include <chrono>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <fmt/format.h>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <string_view>
+#include <thread>
+#include <new>
+
+using namespace cinder::types;
+using FpMili = std::chrono::duration<f64, std::chrono::milliseconds::period>;
+
+/// NOTE: Every heap allocation of the process is counted, the scratch bench compares the counts per chunk.
+static std::atomic_uint64_t g_heap_allocations = {};
+
+void * operator new(std::size_t size)
+{
+    g_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void * memory = std::malloc(size == 0 ? 1 : size)) { return memory; }
+    throw std::bad_alloc{};
+}
+void operator delete(void * memory) noexcept { std::free(memory); }
+void operator delete(void * memory, std::size_t) noexcept { std::free(memory); }
+
+/// NOTE: Counts finished leaf tasks, the main thread waits on it instead of calling block_on per task.
+struct Latch
+{
+    std::atomic_uint64_t remaining = {};
+    void arrive()
+    {
+        if (remaining.fetch_sub(1) == 1) { remaining.notify_all(); }
+    }
+    void wait()
+    {
+        u64 current = remaining.load();
+        while (current != 0)
+        {
+            remaining.wait(current);
+            current = remaining.load();
+        }
+    }
+};
+
+struct EmptyTask : Task
+{
+    Latch * latch = {};
+    EmptyTask(Latch * latch) : latch{latch} { chunk_count = 1; }
+    virtual void callback(u32 chunk_index, u32 thread_index) override { latch->arrive(); }
+};
+
+/// NOTE: Every chunk dispatches its children from a worker thread, those land in the workers local queue
+//        and exercise the owner push/pop and stealing paths.
+struct FanOutTask : Task
+{
+    ThreadPool * pool = {};
+    Latch * latch = {};
+    u32 children_per_chunk = {};
+    FanOutTask(ThreadPool * pool, Latch * latch, u32 chunks, u32 children_per_chunk)
+        : pool{pool}, latch{latch}, children_per_chunk{children_per_chunk}
+    {
+        chunk_count = chunks;
+    }
+    virtual void callback(u32 chunk_index, u32 thread_index) override
+    {
+        for (u32 child = 0; child < children_per_chunk; ++child)
+        {
+            pool->async_dispatch(std::make_shared<EmptyTask>(latch), TaskPriority::LOW);
+        }
+    }
+};
+
+static auto bench_external_dispatch(u32 thread_count, u32 task_count) -> f64
+{
+    ThreadPool pool{thread_count};
+    Latch latch = {};
+    latch.remaining = task_count;
+    auto const start = std::chrono::steady_clock::now();
+    for (u32 i = 0; i < task_count; ++i)
+    {
+        pool.async_dispatch(std::make_shared<EmptyTask>(&latch), i % 2 == 0 ? TaskPriority::LOW : TaskPriority::HIGH);
+    }
+    latch.wait();
+    return std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - start).count();
+}
+
+static auto bench_worker_fan_out(u32 thread_count, u32 task_count) -> f64
+{
+    ThreadPool pool{thread_count};
+    Latch latch = {};
+    u32 const chunks = thread_count * 4;
+    u32 const children_per_chunk = task_count / chunks;
+    latch.remaining = u64(chunks) * children_per_chunk;
+    auto const start = std::chrono::steady_clock::now();
+    pool.async_dispatch(std::make_shared<FanOutTask>(&pool, &latch, chunks, children_per_chunk), TaskPriority::LOW);
+    latch.wait();
+    return std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct DispatchCostResult
+{
+    f64 shared_task_ns = {};
+    f64 pooled_fn_ns = {};
+};
+
+/// NOTE: Cost per dispatched task from the main thread, a heap allocated Task per dispatch vs the pooled
+//        allocation free async_dispatch_fn. Measured end to end until the last task ran.
+static auto bench_dispatch_cost(u32 thread_count, u32 task_count) -> DispatchCostResult
+{
+    ThreadPool pool{thread_count};
+    DispatchCostResult result = {};
+    Latch latch = {};
+    auto timed_ns_per_task = [&](auto && dispatch) -> f64
+    {
+        latch.remaining = task_count;
+        auto const start = std::chrono::steady_clock::now();
+        for (u32 i = 0; i < task_count; ++i) { dispatch(); }
+        latch.wait();
+        auto const duration = std::chrono::duration_cast<std::chrono::duration<f64, std::nano>>(std::chrono::steady_clock::now() - start);
+        return duration.count() / task_count;
+    };
+    result.shared_task_ns = timed_ns_per_task([&]
+        { pool.async_dispatch(std::make_shared<EmptyTask>(&latch), TaskPriority::LOW); });
+    result.pooled_fn_ns = timed_ns_per_task([&]
+        { pool.async_dispatch_fn([&latch]
+              { latch.arrive(); },
+              1, TaskPriority::LOW); });
+    return result;
+}
+
+/// NOTE: The way parallel loops were written before parallel_for, hand split into a fixed amount of chunks.
+struct ChunkedSumTask : Task
+{
+    std::vector<f32> const * values = {};
+    std::vector<f64> partial_sums = {};
+    ChunkedSumTask(std::vector<f32> const * values, u32 chunks)
+        : values{values}, partial_sums(chunks)
+    {
+        chunk_count = chunks;
+    }
+    virtual void callback(u32 chunk_index, u32 thread_index) override
+    {
+        usize const per_chunk = (values->size() + chunk_count - 1) / chunk_count;
+        usize const begin = per_chunk * chunk_index;
+        usize const end = std::min(values->size(), begin + per_chunk);
+        f64 sum = 0.0;
+        for (usize i = begin; i < end; ++i) { sum += std::sqrt(std::abs((*values)[i])); }
+        partial_sums[chunk_index] = sum;
+    }
+};
+
+struct LoopBenchResult
+{
+    f64 chunked_ms = {};
+    f64 parallel_for_ms = {};
+    f64 parallel_reduce_ms = {};
+};
+
+static auto bench_parallel_loops(ThreadPool & pool, std::vector<f32> const & values) -> LoopBenchResult
+{
+    u32 const thread_count = pool.thread_count();
+    LoopBenchResult result = {};
+    auto timed = [](auto && fn) -> f64
+    {
+        auto const start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - start).count();
+    };
+    std::vector<f32> outputs(values.size());
+    result.chunked_ms = timed([&]
+        { pool.blocking_dispatch(std::make_shared<ChunkedSumTask>(&values, thread_count * 4), TaskPriority::HIGH); });
+    result.parallel_for_ms = timed([&]
+        { pool.parallel_for({0, s_cast<u32>(values.size())}, [&](u32 i)
+              { outputs[i] = std::sqrt(std::abs(values[i])); }, 256); });
+    result.parallel_reduce_ms = timed([&]
+        { pool.parallel_reduce({0, s_cast<u32>(values.size())}, 0.0, [&](f64 & sum, u32 i)
+              { sum += std::sqrt(std::abs(values[i])); }, std::plus<f64>{}, 256); });
+    return result;
+}
+
+using SteadyTime = std::chrono::steady_clock::time_point;
+
+static auto elapsed_us(SteadyTime from, SteadyTime to) -> f64
+{
+    return std::chrono::duration_cast<std::chrono::duration<f64, std::micro>>(to - from).count();
+}
+
+struct LatencyResult
+{
+    f64 mean_us = {};
+    f64 p50_us = {};
+    f64 p99_us = {};
+    f64 max_us = {};
+};
+
+static auto summarize_latencies(std::vector<f64> & samples_us) -> LatencyResult
+{
+    if (samples_us.empty()) { return {}; }
+    std::sort(samples_us.begin(), samples_us.end());
+    f64 sum = 0.0;
+    for (f64 const sample : samples_us) { sum += sample; }
+    auto percentile = [&](f64 p) { return samples_us[std::min(samples_us.size() - 1, s_cast<usize>(p * samples_us.size()))]; };
+    return LatencyResult{
+        .mean_us = sum / samples_us.size(),
+        .p50_us = percentile(0.5),
+        .p99_us = percentile(0.99),
+        .max_us = samples_us.back(),
+    };
+}
+
+static auto to_json(LatencyResult const & result) -> nlohmann::json
+{
+    return {{"mean_us", result.mean_us}, {"p50_us", result.p50_us}, {"p99_us", result.p99_us}, {"max_us", result.max_us}};
+}
+
+/// NOTE: Time from dispatching a single empty task on the main thread until it starts running on a worker.
+//        Only one task is in flight at a time, the workers are idle in between so this includes waking one up.
+static auto bench_dispatch_latency(u32 thread_count, u32 sample_count) -> LatencyResult
+{
+    ThreadPool pool{thread_count};
+    std::vector<f64> samples_us(sample_count);
+    std::atomic_bool ran = {};
+    for (u32 i = 0; i < sample_count; ++i)
+    {
+        ran = false;
+        SteadyTime const dispatched = std::chrono::steady_clock::now();
+        pool.async_dispatch_fn([&, dispatched, i]
+            {
+                samples_us[i] = elapsed_us(dispatched, std::chrono::steady_clock::now());
+                ran = true;
+                ran.notify_one(); },
+            1, TaskPriority::HIGH);
+        ran.wait(false);
+    }
+    return summarize_latencies(samples_us);
+}
+
+/// NOTE: Several threads outside of the pool dispatch empty tasks at once, all of them go through the injection queue.
+static auto bench_producer_throughput(u32 thread_count, u32 producer_count, u32 tasks_per_producer) -> f64
+{
+    ThreadPool pool{thread_count};
+    Latch latch = {};
+    latch.remaining = u64(producer_count) * tasks_per_producer;
+    std::atomic_bool go = {};
+    std::vector<std::thread> producers = {};
+    for (u32 producer = 0; producer < producer_count; ++producer)
+    {
+        producers.emplace_back([&]
+            {
+                go.wait(false);
+                for (u32 i = 0; i < tasks_per_producer; ++i)
+                {
+                    pool.async_dispatch_fn([&latch]
+                        { latch.arrive(); });
+                } });
+    }
+    auto const start = std::chrono::steady_clock::now();
+    go = true;
+    go.notify_all();
+    latch.wait();
+    f64 const ms = std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - start).count();
+    for (std::thread & producer : producers) { producer.join(); }
+    return (u64(producer_count) * tasks_per_producer) / (ms * 1000.0);
+}
+
+struct EmptyChunksTask : Task
+{
+    EmptyChunksTask(u32 chunks) { chunk_count = chunks; }
+    virtual void callback(u32 chunk_index, u32 thread_index) override {}
+};
+
+/// NOTE: Cost of a blocking_dispatch of empty chunks, the fork/join overhead a parallel loop pays on top of its work.
+static auto bench_fork_join(ThreadPool & pool, u32 chunk_count, u32 iterations) -> f64
+{
+    auto const start = std::chrono::steady_clock::now();
+    for (u32 i = 0; i < iterations; ++i)
+    {
+        EmptyChunksTask task{chunk_count};
+        pool.blocking_dispatch(task, TaskPriority::HIGH);
+    }
+    return elapsed_us(start, std::chrono::steady_clock::now()) / iterations;
+}
+
+struct MixedPriorityResult
+{
+    LatencyResult high = {};
+    LatencyResult low = {};
+    f64 mtasks_per_s = {};
+};
+
+/// NOTE: A burst of LOW tasks with every HIGH_EVERY-th task HIGH, each task spins for a few microseconds so a backlog
+//        builds up. HIGH tasks should start long before the LOW ones dispatched at the same time.
+static auto bench_mixed_priorities(u32 thread_count, u32 task_count) -> MixedPriorityResult
+{
+    static constexpr u32 HIGH_EVERY = 8;
+    static constexpr auto TASK_WORK = std::chrono::microseconds(2);
+    ThreadPool pool{thread_count};
+    Latch latch = {};
+    latch.remaining = task_count;
+    std::vector<f64> start_latencies_us(task_count);
+    auto const start = std::chrono::steady_clock::now();
+    for (u32 i = 0; i < task_count; ++i)
+    {
+        SteadyTime const dispatched = std::chrono::steady_clock::now();
+        pool.async_dispatch_fn([&, dispatched, i]
+            {
+                SteadyTime const started = std::chrono::steady_clock::now();
+                start_latencies_us[i] = elapsed_us(dispatched, started);
+                while (std::chrono::steady_clock::now() - started < TASK_WORK) {}
+                latch.arrive(); },
+            1, i % HIGH_EVERY == 0 ? TaskPriority::HIGH : TaskPriority::LOW);
+    }
+    latch.wait();
+    f64 const ms = std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - start).count();
+    std::vector<f64> high_us = {};
+    std::vector<f64> low_us = {};
+    for (u32 i = 0; i < task_count; ++i)
+    {
+        (i % HIGH_EVERY == 0 ? high_us : low_us).push_back(start_latencies_us[i]);
+    }
+    return MixedPriorityResult{
+        .high = summarize_latencies(high_us),
+        .low = summarize_latencies(low_us),
+        .mtasks_per_s = task_count / (ms * 1000.0),
+    };
+}
+
+struct ScratchBenchResult
+{
+    f64 heap_ms = {};
+    f64 scratch_ms = {};
+    f64 heap_allocations_per_chunk = {};
+    f64 scratch_allocations_per_chunk = {};
+};
+
+/// NOTE: Every chunk builds a few temporary arrays and sums them, once with std::vector and once from the
+//        scratch arena of the worker running the chunk.
+static auto bench_scratch_temporaries(ThreadPool & pool, u32 chunk_count, u32 elements_per_chunk) -> ScratchBenchResult
+{
+    ScratchBenchResult result = {};
+    std::vector<f64> sums(chunk_count);
+    auto fill_and_sum = [&](u32 chunk_index, std::span<f32> a, std::span<f32> b, std::span<u32> indices)
+    {
+        for (u32 i = 0; i < elements_per_chunk; ++i)
+        {
+            a[i] = s_cast<f32>(i + chunk_index);
+            b[i] = std::sqrt(a[i]);
+            indices[i] = (i * 7u) % elements_per_chunk;
+        }
+        f64 sum = 0.0;
+        for (u32 i = 0; i < elements_per_chunk; ++i) { sum += a[indices[i]] * b[i]; }
+        sums[chunk_index] = sum;
+    };
+    auto timed = [&](auto && fn, f64 & allocations_per_chunk) -> f64
+    {
+        u64 const allocations_before = g_heap_allocations.load();
+        auto const start = std::chrono::steady_clock::now();
+        pool.parallel_for({0, chunk_count}, fn, 1);
+        f64 const ms = std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - start).count();
+        allocations_per_chunk = s_cast<f64>(g_heap_allocations.load() - allocations_before) / chunk_count;
+        return ms;
+    };
+    result.heap_ms = timed([&](u32 chunk_index)
+        {
+            std::vector<f32> a(elements_per_chunk);
+            std::vector<f32> b(elements_per_chunk);
+            std::vector<u32> indices(elements_per_chunk);
+            fill_and_sum(chunk_index, a, b, indices); },
+        result.heap_allocations_per_chunk);
+    result.scratch_ms = timed([&](u32 chunk_index)
+        {
+            ScratchArena & scratch = ThreadPool::current_scratch_arena();
+            ScratchArena::Scope const scope{scratch};
+            fill_and_sum(chunk_index, scratch.allocate_array<f32>(elements_per_chunk), scratch.allocate_array<f32>(elements_per_chunk), scratch.allocate_array<u32>(elements_per_chunk)); },
+        result.scratch_allocations_per_chunk);
+    return result;
+}
+
+/// NOTE: 1, 2, 4, ... and always max_threads last.
+static auto bench_thread_counts(u32 max_threads) -> std::vector<u32>
+{
+    std::vector<u32> thread_counts = {};
+    for (u32 thread_count = 1; thread_count < max_threads; thread_count *= 2) { thread_counts.push_back(thread_count); }
+    thread_counts.push_back(max_threads);
+    return thread_counts;
+}
+
+/// NOTE: Usage: cinder_threadpool_bench [--json <path>]
+//        The tables always go to stdout, with --json all results are also written to path as one json object
+//        so runs on the build machines can be compared against each other.
+int main(int argc, char const * argv[])
+{
+    std::optional<std::string> json_path = {};
+    for (i32 arg = 1; arg < argc; ++arg)
+    {
+        if (std::string_view{argv[arg]} == "--json" && arg + 1 < argc) { json_path = argv[++arg]; }
+    }
+    u32 const max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<u32> const thread_counts = bench_thread_counts(max_threads);
+    CpuTopology const topology = CpuTopology::detect();
+    nlohmann::json report = {};
+    report["machine"] = {{"hardware_concurrency", max_threads}, {"topology", topology.to_string()}};
+
+    u32 const task_count = 200'000;
+    fmt::print("{:>8} | {:>22} | {:>22}\n", "threads", "external Mtasks/s", "worker fan-out Mtasks/s");
+    for (u32 const thread_count : thread_counts)
+    {
+        f64 const external_ms = bench_external_dispatch(thread_count, task_count);
+        f64 const fan_out_ms = bench_worker_fan_out(thread_count, task_count);
+        f64 const external_mtasks = task_count / (external_ms * 1000.0);
+        f64 const fan_out_mtasks = task_count / (fan_out_ms * 1000.0);
+        fmt::print("{:>8} | {:>22.3f} | {:>22.3f}\n", thread_count, external_mtasks, fan_out_mtasks);
+        report["throughput"].push_back({{"threads", thread_count}, {"external_mtasks_per_s", external_mtasks}, {"worker_fan_out_mtasks_per_s", fan_out_mtasks}});
+    }
+
+    fmt::print("\n{:>8} | {:>18} | {:>18}\n", "threads", "shared Task ns", "async_dispatch_fn ns");
+    for (u32 const thread_count : thread_counts)
+    {
+        DispatchCostResult const result = bench_dispatch_cost(thread_count, task_count);
+        fmt::print("{:>8} | {:>18.1f} | {:>18.1f}\n", thread_count, result.shared_task_ns, result.pooled_fn_ns);
+        report["dispatch_cost"].push_back({{"threads", thread_count}, {"shared_task_ns", result.shared_task_ns}, {"pooled_fn_ns", result.pooled_fn_ns}});
+    }
+
+    fmt::print("\n{:>8} | {:>10} | {:>10} | {:>10} | {:>10}\n", "threads", "mean us", "p50 us", "p99 us", "max us");
+    for (u32 const thread_count : thread_counts)
+    {
+        LatencyResult const result = bench_dispatch_latency(thread_count, 20'000);
+        fmt::print("{:>8} | {:>10.2f} | {:>10.2f} | {:>10.2f} | {:>10.2f}\n", thread_count, result.mean_us, result.p50_us, result.p99_us, result.max_us);
+        nlohmann::json entry = to_json(result);
+        entry["threads"] = thread_count;
+        report["dispatch_latency"].push_back(entry);
+    }
+
+    fmt::print("\n{:>8} | {:>10} | {:>14}\n", "threads", "producers", "Mtasks/s");
+    for (u32 const thread_count : thread_counts)
+    {
+        for (u32 const producer_count : bench_thread_counts(max_threads))
+        {
+            f64 const mtasks = bench_producer_throughput(thread_count, producer_count, task_count / producer_count);
+            fmt::print("{:>8} | {:>10} | {:>14.3f}\n", thread_count, producer_count, mtasks);
+            report["producer_throughput"].push_back({{"threads", thread_count}, {"producers", producer_count}, {"mtasks_per_s", mtasks}});
+        }
+    }
+
+    fmt::print("\n{:>8} | {:>12} | {:>16}\n", "threads", "chunk_count", "us per dispatch");
+    for (u32 const thread_count : thread_counts)
+    {
+        ThreadPool pool{thread_count};
+        for (u32 const chunk_count : {1u, 4u, 16u, 64u, 256u, 1024u})
+        {
+            f64 const us = bench_fork_join(pool, chunk_count, 2'000);
+            fmt::print("{:>8} | {:>12} | {:>16.2f}\n", thread_count, chunk_count, us);
+            report["fork_join"].push_back({{"threads", thread_count}, {"chunk_count", chunk_count}, {"us_per_dispatch", us}});
+        }
+    }
+
+    fmt::print("\n{:>8} | {:>12} | {:>12} | {:>12} | {:>12} | {:>10}\n", "threads", "HIGH p50 us", "HIGH p99 us", "LOW p50 us", "LOW p99 us", "Mtasks/s");
+    for (u32 const thread_count : thread_counts)
+    {
+        MixedPriorityResult const result = bench_mixed_priorities(thread_count, 50'000);
+        fmt::print("{:>8} | {:>12.1f} | {:>12.1f} | {:>12.1f} | {:>12.1f} | {:>10.3f}\n",
+            thread_count, result.high.p50_us, result.high.p99_us, result.low.p50_us, result.low.p99_us, result.mtasks_per_s);
+        report["mixed_priorities"].push_back({{"threads", thread_count}, {"high", to_json(result.high)}, {"low", to_json(result.low)}, {"mtasks_per_s", result.mtasks_per_s}});
+    }
+
+    std::vector<f32> values(1u << 24u);
+    for (usize i = 0; i < values.size(); ++i) { values[i] = s_cast<f32>(i % 1024) - 512.0f; }
+    fmt::print("\n{:>8} | {:>14} | {:>14} | {:>16}\n", "threads", "chunked ms", "parallel_for ms", "parallel_reduce ms");
+    for (u32 const thread_count : thread_counts)
+    {
+        ThreadPool pool{thread_count};
+        LoopBenchResult const result = bench_parallel_loops(pool, values);
+        fmt::print("{:>8} | {:>14.3f} | {:>14.3f} | {:>16.3f}\n",
+            thread_count, result.chunked_ms, result.parallel_for_ms, result.parallel_reduce_ms);
+        report["parallel_loops"].push_back({{"threads", thread_count}, {"chunked_ms", result.chunked_ms}, {"parallel_for_ms", result.parallel_for_ms}, {"parallel_reduce_ms", result.parallel_reduce_ms}});
+    }
+
+    fmt::print("\n{:>8} | {:>12} | {:>12} | {:>18} | {:>18}\n", "threads", "vector ms", "scratch ms", "vector allocs/chunk", "scratch allocs/chunk");
+    for (u32 const thread_count : thread_counts)
+    {
+        ThreadPool pool{thread_count};
+        // The first run grows the arenas, only the second one shows the steady state.
+        bench_scratch_temporaries(pool, 4096, 4096);
+        ScratchBenchResult const result = bench_scratch_temporaries(pool, 4096, 4096);
+        fmt::print("{:>8} | {:>12.3f} | {:>12.3f} | {:>18.3f} | {:>18.3f}\n",
+            thread_count, result.heap_ms, result.scratch_ms, result.heap_allocations_per_chunk, result.scratch_allocations_per_chunk);
+        report["scratch_temporaries"].push_back({{"threads", thread_count}, {"vector_ms", result.heap_ms}, {"scratch_ms", result.scratch_ms}, {"vector_allocations_per_chunk", result.heap_allocations_per_chunk}, {"scratch_allocations_per_chunk", result.scratch_allocations_per_chunk}});
+    }
+
+    /// NOTE: The fixed worker count Application used to hardcode against the topology derived sizing.
+    fmt::print("\n{}\n", topology.to_string());
+    fmt::print("{:>18} | {:>8} | {:>14} | {:>14} | {:>16}\n", "pool", "threads", "chunked ms", "parallel_for ms", "parallel_reduce ms");
+    auto bench_sizing = [&](char const * name, ThreadPool & pool)
+    {
+        LoopBenchResult const result = bench_parallel_loops(pool, values);
+        fmt::print("{:>18} | {:>8} | {:>14.3f} | {:>14.3f} | {:>16.3f}\n",
+            name, pool.thread_count(), result.chunked_ms, result.parallel_for_ms, result.parallel_reduce_ms);
+        report["pool_sizing"].push_back({{"pool", name}, {"threads", pool.thread_count()}, {"chunked_ms", result.chunked_ms}, {"parallel_for_ms", result.parallel_for_ms}, {"parallel_reduce_ms", result.parallel_reduce_ms}});
+    };
+    {
+        ThreadPool pool{7};
+        bench_sizing("fixed 7", pool);
+    }
+    {
+        ThreadPool pool{ThreadPoolInfo{.topology = topology}};
+        bench_sizing("topology", pool);
+    }
+    {
+        ThreadPool pool{ThreadPoolInfo{.pin_workers = true, .topology = topology}};
+        bench_sizing("topology pinned", pool);
+    }
+
+    if (json_path.has_value())
+    {
+        std::ofstream file{json_path.value()};
+        if (!file)
+        {
+            fmt::print(stderr, "Could not open {} for writing\n", json_path.value());
+            return 1;
+        }
+        file << report.dump(4) << '\n';
+    }
+    return 0;
+}
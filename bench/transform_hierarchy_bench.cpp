@@ -0,0 +1,316 @@
+#include "../src/scene/transform_hierarchy.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <span>
+#include <utility>
+#include <thread>
+#include <fmt/format.h>
+
+using namespace cinder::types;
+using FpMili = std::chrono::duration<f64, std::chrono::milliseconds::period>;
+
+static constexpr u32 INVALID = TransformHierarchy::INVALID_INDEX;
+
+static auto affine_to_mat4(glm::mat4x3 const & transform) -> glm::mat4
+{
+    return glm::mat4(
+        glm::vec4(transform[0], 0.0f),
+        glm::vec4(transform[1], 0.0f),
+        glm::vec4(transform[2], 0.0f),
+        glm::vec4(transform[3], 1.0f));
+}
+
+/// NOTE: Entities by slot index, slot indices are shuffled so they say nothing about the hierarchy order.
+struct BenchHierarchy
+{
+    std::vector<glm::mat4x3> transforms = {};
+    std::vector<glm::mat4x3> combined_transforms = {};
+    std::vector<u32> parents = {};
+};
+
+/// NOTE: Close to a rigid transform, long chains of them stay well conditioned.
+static auto random_transform(std::mt19937 & rng) -> glm::mat4x3
+{
+    std::uniform_real_distribution<f32> small{-0.05f, 0.05f};
+    std::uniform_real_distribution<f32> offset{-1.0f, 1.0f};
+    glm::mat4x3 transform = glm::identity<glm::mat4x3>();
+    for (u32 column = 0; column < 3; ++column)
+    {
+        for (u32 row = 0; row < 3; ++row) { transform[column][row] += small(rng); }
+    }
+    transform[3] = glm::vec3(offset(rng), offset(rng), offset(rng));
+    return transform;
+}
+
+// parent_of(i) gives the parent of the i-th created entity in creation order, INVALID for roots. Parents are created first.
+template <typename ParentFnT>
+static auto make_hierarchy(u32 entity_count, std::mt19937 & rng, ParentFnT && parent_of) -> BenchHierarchy
+{
+    std::vector<u32> slots(entity_count);
+    std::iota(slots.begin(), slots.end(), 0u);
+    std::shuffle(slots.begin(), slots.end(), rng);
+    BenchHierarchy hierarchy = {};
+    hierarchy.transforms.resize(entity_count);
+    hierarchy.combined_transforms.resize(entity_count);
+    hierarchy.parents.resize(entity_count);
+    for (u32 i = 0; i < entity_count; ++i)
+    {
+        u32 const parent = parent_of(i);
+        hierarchy.parents[slots[i]] = parent == INVALID ? INVALID : slots[parent];
+        hierarchy.transforms[slots[i]] = random_transform(rng);
+    }
+    return hierarchy;
+}
+
+static auto make_transform_hierarchy(BenchHierarchy const & hierarchy) -> TransformHierarchy
+{
+    std::vector<TransformHierarchy::Node> nodes(hierarchy.parents.size());
+    for (u32 slot_index = 0; slot_index < nodes.size(); ++slot_index)
+    {
+        nodes[slot_index] = {.slot_index = slot_index, .parent_slot_index = hierarchy.parents[slot_index]};
+    }
+    TransformHierarchy transform_hierarchy = {};
+    transform_hierarchy.rebuild(nodes);
+    return transform_hierarchy;
+}
+
+/// NOTE: What Scene::record_gpu_manifest_update did before, every entity walks its whole parent chain.
+static auto naive_combined_transform(BenchHierarchy const & hierarchy, u32 slot_index) -> glm::mat4x3
+{
+    glm::mat4 combined_transform4 = affine_to_mat4(hierarchy.transforms[slot_index]);
+    for (u32 parent = hierarchy.parents[slot_index]; parent != INVALID; parent = hierarchy.parents[parent])
+    {
+        combined_transform4 = affine_to_mat4(hierarchy.transforms[parent]) * combined_transform4;
+    }
+    return combined_transform4;
+}
+
+static void propagate(TransformHierarchy & transform_hierarchy, BenchHierarchy & hierarchy)
+{
+    transform_hierarchy.propagate([&](u32 slot_index, u32 parent_slot_index)
+        {
+            glm::mat4 combined_transform4 = affine_to_mat4(hierarchy.transforms[slot_index]);
+            if (parent_slot_index != INVALID)
+            {
+                combined_transform4 = affine_to_mat4(hierarchy.combined_transforms[parent_slot_index]) * combined_transform4;
+            }
+            hierarchy.combined_transforms[slot_index] = combined_transform4; });
+}
+
+static auto max_error(BenchHierarchy const & hierarchy) -> f32
+{
+    f32 error = 0.0f;
+    for (u32 slot_index = 0; slot_index < hierarchy.parents.size(); ++slot_index)
+    {
+        glm::mat4x3 const expected = naive_combined_transform(hierarchy, slot_index);
+        for (u32 column = 0; column < 4; ++column)
+        {
+            for (u32 row = 0; row < 3; ++row)
+            {
+                f32 const magnitude = std::max(1.0f, std::abs(expected[column][row]));
+                error = std::max(error, std::abs(expected[column][row] - hierarchy.combined_transforms[slot_index][column][row]) / magnitude);
+            }
+        }
+    }
+    return error;
+}
+
+/// NOTE: Random hierarchies, random entities are moved every frame and only they are marked dirty.
+//        Their children have to follow, stale children show up as a mismatch against the naive walk.
+static auto check_against_naive_walk() -> bool
+{
+    static constexpr f32 TOLERANCE = 1e-4f;
+    std::mt19937 rng{3};
+    for (u32 sequence = 0; sequence < 16; ++sequence)
+    {
+        u32 const entity_count = 1000 + sequence * 500;
+        // Later sequences get deeper, the parent is picked among the most recent entities.
+        u32 const window = std::max(1u, entity_count >> (sequence % 8 + 1));
+        BenchHierarchy hierarchy = make_hierarchy(entity_count, rng, [&](u32 i)
+            { return (i == 0 || rng() % 64 == 0) ? INVALID : i - 1 - rng() % std::min(i, window); });
+        TransformHierarchy transform_hierarchy = make_transform_hierarchy(hierarchy);
+        for (u32 slot_index = 0; slot_index < entity_count; ++slot_index) { transform_hierarchy.mark_dirty(slot_index); }
+        propagate(transform_hierarchy, hierarchy);
+        for (u32 frame = 0; frame < 16; ++frame)
+        {
+            u32 const moved = 1 + rng() % (entity_count / 20);
+            for (u32 i = 0; i < moved; ++i)
+            {
+                u32 const slot_index = rng() % entity_count;
+                hierarchy.transforms[slot_index] = random_transform(rng);
+                transform_hierarchy.mark_dirty(slot_index);
+            }
+            propagate(transform_hierarchy, hierarchy);
+            f32 const error = max_error(hierarchy);
+            if (!(error <= TOLERANCE))
+            {
+                fmt::print("Sequence {} frame {}: combined transforms differ from the naive walk by {}\n", sequence, frame, error);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+struct PropagationBenchResult
+{
+    f64 naive_ms = {};
+    f64 incremental_ms = {};
+    u32 updated = {};
+};
+
+// Moves the given entities and updates every combined transform that depends on them, with both approaches.
+static auto bench_propagation(BenchHierarchy & hierarchy, std::span<u32 const> moved) -> PropagationBenchResult
+{
+    PropagationBenchResult result = {};
+    TransformHierarchy transform_hierarchy = make_transform_hierarchy(hierarchy);
+
+    /// NOTE: The naive walk needs the affected entities too, it walks the chain for every moved entity and all their descendants.
+    for (u32 const slot_index : moved) { transform_hierarchy.mark_dirty(slot_index); }
+    std::vector<u32> affected = {};
+    for (TransformHierarchy::Range const range : transform_hierarchy.take_dirty_ranges())
+    {
+        for (u32 position = range.begin; position < range.end; ++position) { affected.push_back(transform_hierarchy.slot_at(position)); }
+    }
+    result.updated = s_cast<u32>(affected.size());
+    auto const naive_start = std::chrono::steady_clock::now();
+    for (u32 const slot_index : affected)
+    {
+        hierarchy.combined_transforms[slot_index] = naive_combined_transform(hierarchy, slot_index);
+    }
+    result.naive_ms = std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - naive_start).count();
+
+    auto const incremental_start = std::chrono::steady_clock::now();
+    for (u32 const slot_index : moved) { transform_hierarchy.mark_dirty(slot_index); }
+    propagate(transform_hierarchy, hierarchy);
+    result.incremental_ms = std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - incremental_start).count();
+    return result;
+}
+
+/// NOTE: Every entity of the hierarchy moves each frame, propagated with the given pool or serially without one.
+//        Returns the average ms per frame.
+static auto bench_parallel_propagation(BenchHierarchy & hierarchy, TransformHierarchy & transform_hierarchy, ThreadPool * thread_pool) -> f64
+{
+    static constexpr u32 FRAMES = 8;
+    auto update_entity = [&](u32 slot_index, u32 parent_slot_index)
+    {
+        glm::mat4 combined_transform4 = affine_to_mat4(hierarchy.transforms[slot_index]);
+        if (parent_slot_index != INVALID)
+        {
+            combined_transform4 = affine_to_mat4(hierarchy.combined_transforms[parent_slot_index]) * combined_transform4;
+        }
+        hierarchy.combined_transforms[slot_index] = combined_transform4;
+    };
+    auto const start = std::chrono::steady_clock::now();
+    for (u32 frame = 0; frame < FRAMES; ++frame)
+    {
+        for (u32 slot_index = 0; slot_index < hierarchy.parents.size(); ++slot_index) { transform_hierarchy.mark_dirty(slot_index); }
+        if (thread_pool != nullptr)
+        {
+            TransformHierarchy::PropagationWork const work = transform_hierarchy.take_dirty_work(thread_pool->thread_count() * 4);
+            transform_hierarchy.propagate(work, *thread_pool, update_entity);
+        }
+        else
+        {
+            transform_hierarchy.for_each_entity(transform_hierarchy.take_dirty_work(1), update_entity);
+        }
+    }
+    return std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - start).count() / FRAMES;
+}
+
+static auto bench_thread_counts(u32 max_threads) -> std::vector<u32>
+{
+    std::vector<u32> thread_counts = {};
+    for (u32 thread_count = 1; thread_count < max_threads; thread_count *= 2) { thread_counts.push_back(thread_count); }
+    thread_counts.push_back(max_threads);
+    return thread_counts;
+}
+
+static auto bench_parallel_scaling() -> bool
+{
+    u32 const entity_count = 400'000;
+    u32 const max_thread_count = std::max(1u, std::thread::hardware_concurrency());
+    std::mt19937 rng{5};
+    struct Shape
+    {
+        char const * name;
+        u32 fan_out;
+        u32 depth;
+    };
+    fmt::print("\n{} moving entities, every one of them dirty each frame, {} hardware threads\n", entity_count, max_thread_count);
+    fmt::print("{:>28} | {:>10} | {:>10} | {:>8}\n", "hierarchy", "workers", "ms/frame", "speedup");
+    /// NOTE: A city, one root with blocks of buildings with parts, and a single root with many deep chains below it.
+    for (Shape const shape : {Shape{"city (fan out 20, depth 4)", 20, 4}, Shape{"root with chains of 256", 0, 256}})
+    {
+        BenchHierarchy hierarchy = make_hierarchy(entity_count, rng, [&](u32 i)
+            {
+                if (i == 0) { return INVALID; }
+                // Breadth first numbering, the parent of i is (i - 1) / fan_out.
+                if (shape.fan_out != 0) { return (i - 1) / shape.fan_out; }
+                return (i - 1) % shape.depth == 0 ? 0u : i - 1; });
+        TransformHierarchy transform_hierarchy = make_transform_hierarchy(hierarchy);
+        f64 const serial_ms = bench_parallel_propagation(hierarchy, transform_hierarchy, nullptr);
+        std::vector<glm::mat4x3> const serial_result = hierarchy.combined_transforms;
+        fmt::print("{:>28} | {:>10} | {:>10.3f} | {:>8.2f}\n", shape.name, "serial", serial_ms, 1.0);
+        for (u32 const thread_count : bench_thread_counts(max_thread_count))
+        {
+            ThreadPool thread_pool{thread_count};
+            std::fill(hierarchy.combined_transforms.begin(), hierarchy.combined_transforms.end(), glm::mat4x3(0.0f));
+            f64 const parallel_ms = bench_parallel_propagation(hierarchy, transform_hierarchy, &thread_pool);
+            fmt::print("{:>28} | {:>10} | {:>10.3f} | {:>8.2f}\n", shape.name, thread_count, parallel_ms, serial_ms / parallel_ms);
+            /// NOTE: Every entity is computed with the same operations in both, the results have to be identical.
+            if (!std::equal(serial_result.begin(), serial_result.end(), hierarchy.combined_transforms.begin()))
+            {
+                fmt::print("Parallel propagation with {} workers differs from the serial one\n", thread_count);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    if (!check_against_naive_walk())
+    {
+        return 1;
+    }
+    fmt::print("Incremental propagation matches the naive parent walk on random hierarchies\n");
+
+    u32 const entity_count = 100'000;
+    std::mt19937 rng{11};
+    struct Shape
+    {
+        char const * name;
+        u32 depth;
+    };
+    fmt::print("{} entities, slot indices shuffled\n", entity_count);
+    fmt::print("{:>22} | {:>14} | {:>10} | {:>10} | {:>16}\n", "hierarchy", "moved", "updated", "naive ms", "incremental ms");
+    for (Shape const shape : {Shape{"wide (depth 2)", 2}, Shape{"chains of depth 32", 32}, Shape{"chains of depth 512", 512}})
+    {
+        /// NOTE: Chains of shape.depth entities. Depth 2 is one parent with a large fan out of children.
+        u32 const chain_length = shape.depth;
+        BenchHierarchy hierarchy = make_hierarchy(entity_count, rng, [&](u32 i)
+            {
+                if (shape.depth == 2) { return i == 0 ? INVALID : 0u; }
+                return i % chain_length == 0 ? INVALID : i - 1; });
+        std::vector<u32> all_slots(entity_count);
+        std::iota(all_slots.begin(), all_slots.end(), 0u);
+        std::vector<u32> some_slots(entity_count / 100);
+        for (u32 & slot_index : some_slots) { slot_index = rng() % entity_count; }
+        for (auto const & [moved_name, moved] : {std::pair{"all", std::span<u32 const>{all_slots}}, std::pair{"1% random", std::span<u32 const>{some_slots}}})
+        {
+            PropagationBenchResult const result = bench_propagation(hierarchy, moved);
+            fmt::print("{:>22} | {:>14} | {:>10} | {:>10.3f} | {:>16.3f}\n", shape.name, moved_name, result.updated, result.naive_ms, result.incremental_ms);
+        }
+    }
+    if (!bench_parallel_scaling())
+    {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,203 @@
+#include "../src/scene/upload_plan.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <random>
+#include <string>
+#include <fmt/format.h>
+
+using namespace cinder::types;
+using FpMili = std::chrono::duration<f64, std::chrono::milliseconds::period>;
+
+static auto random_dirty_indices(std::mt19937 & rng, u32 element_count, u32 dirty_count, u32 cluster_size) -> std::vector<u32>
+{
+    std::vector<u32> indices = {};
+    while (indices.size() < dirty_count)
+    {
+        u32 const first = rng() % element_count;
+        for (u32 i = first; i < std::min(element_count, first + cluster_size); ++i)
+        {
+            indices.push_back(i);
+        }
+    }
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+    return indices;
+}
+
+/// NOTE: Checks a plan against the dirty indices it was built from, returns the first violation.
+static auto validate(std::span<u32 const> dirty_indices, UploadPlan const & plan, UploadPlanInfo const & info, u32 element_count) -> std::optional<std::string>
+{
+    std::vector<u32> times_uploaded(element_count, 0);
+    for (usize i = 0; i < plan.copies.size(); ++i)
+    {
+        UploadPlan::Range const range = plan.copies[i];
+        if (range.begin >= range.end || range.end > element_count)
+        {
+            return fmt::format("copy {} [{}, {}) is empty or out of bounds", i, range.begin, range.end);
+        }
+        if (i > 0 && plan.copies[i - 1].end > range.begin)
+        {
+            return fmt::format("copy {} [{}, {}) overlaps or is out of order", i, range.begin, range.end);
+        }
+        if (range.end - range.begin < info.min_copy_size)
+        {
+            return fmt::format("copy {} [{}, {}) is shorter than min_copy_size {}", i, range.begin, range.end, info.min_copy_size);
+        }
+        for (u32 index = range.begin; index < range.end; ++index)
+        {
+            times_uploaded[index] += 1;
+        }
+    }
+    for (usize i = 0; i < plan.scatter_indices.size(); ++i)
+    {
+        if (plan.scatter_indices[i] >= element_count || (i > 0 && plan.scatter_indices[i - 1] >= plan.scatter_indices[i]))
+        {
+            return fmt::format("scatter index {} is out of bounds or out of order", i);
+        }
+        times_uploaded[plan.scatter_indices[i]] += 1;
+    }
+    std::vector<bool> dirty(element_count, false);
+    for (u32 const index : dirty_indices) { dirty[index] = true; }
+    for (u32 index = 0; index < element_count; ++index)
+    {
+        if (dirty[index] && times_uploaded[index] != 1)
+        {
+            return fmt::format("dirty element {} is uploaded {} times", index, times_uploaded[index]);
+        }
+        if (times_uploaded[index] > 1)
+        {
+            return fmt::format("clean element {} is uploaded {} times", index, times_uploaded[index]);
+        }
+    }
+    /// NOTE: Copies only carry clean elements in gaps of at most max_gap, their ends are dirty.
+    for (UploadPlan::Range const range : plan.copies)
+    {
+        if (!dirty[range.begin] || !dirty[range.end - 1])
+        {
+            return fmt::format("copy [{}, {}) starts or ends on a clean element", range.begin, range.end);
+        }
+        u32 gap = 0;
+        for (u32 index = range.begin; index < range.end; ++index)
+        {
+            gap = dirty[index] ? 0 : gap + 1;
+            if (gap > info.max_gap)
+            {
+                return fmt::format("copy [{}, {}) spans a gap longer than max_gap {}", range.begin, range.end, info.max_gap);
+            }
+        }
+    }
+    /// NOTE: Runs are maximal, a copy closer than max_gap to any other upload would have been merged with it.
+    //        Scattered indices of the same run may be closer to each other.
+    std::vector<UploadPlan::Range> uploads = plan.copies;
+    for (u32 const index : plan.scatter_indices) { uploads.push_back({index, index + 1}); }
+    std::sort(uploads.begin(), uploads.end(), [](UploadPlan::Range a, UploadPlan::Range b)
+        { return a.begin < b.begin; });
+    auto is_copy = [&](UploadPlan::Range range)
+    { return range.end - range.begin > 1 || !std::binary_search(plan.scatter_indices.begin(), plan.scatter_indices.end(), range.begin); };
+    for (usize i = 1; i < uploads.size(); ++i)
+    {
+        if ((is_copy(uploads[i - 1]) || is_copy(uploads[i])) && uploads[i].begin - uploads[i - 1].end <= info.max_gap)
+        {
+            return fmt::format("uploads ending at {} and starting at {} were not merged", uploads[i - 1].end, uploads[i].begin);
+        }
+    }
+    return std::nullopt;
+}
+
+/// NOTE: Applies the plan to a mirror of the gpu buffer, it has to end up equal to the source.
+static auto check_mirror(std::mt19937 & rng, u32 element_count, std::span<u32 const> dirty_indices, UploadPlan const & plan) -> bool
+{
+    std::vector<u32> src(element_count);
+    std::vector<u32> mirror(element_count);
+    for (u32 index = 0; index < element_count; ++index)
+    {
+        src[index] = rng();
+        mirror[index] = src[index];
+    }
+    for (u32 const index : dirty_indices)
+    {
+        src[index] = ~mirror[index];
+    }
+    for (UploadPlan::Range const range : plan.copies)
+    {
+        std::copy(src.begin() + range.begin, src.begin() + range.end, mirror.begin() + range.begin);
+    }
+    for (u32 const index : plan.scatter_indices)
+    {
+        mirror[index] = src[index];
+    }
+    return mirror == src;
+}
+
+static auto check_random_plans() -> bool
+{
+    std::mt19937 rng{11};
+    std::vector<UploadPlanInfo> const infos = {{}, {.max_gap = 0, .min_copy_size = 1}, {.max_gap = 0, .min_copy_size = 2}, {.max_gap = 16, .min_copy_size = 32}};
+    for (u32 iteration = 0; iteration < 2048; ++iteration)
+    {
+        u32 const element_count = 1 + rng() % 4096;
+        u32 const dirty_count = rng() % (element_count + 1);
+        u32 const cluster_size = 1 + rng() % 48;
+        std::vector<u32> const dirty_indices = random_dirty_indices(rng, element_count, dirty_count, cluster_size);
+        UploadPlanInfo const & info = infos[iteration % infos.size()];
+        UploadPlan const plan = plan_uploads(dirty_indices, info);
+        if (std::optional<std::string> const error = validate(dirty_indices, plan, info, element_count))
+        {
+            fmt::print("Plan {} ({} elements, {} dirty, max_gap {}, min_copy_size {}): {}\n",
+                iteration, element_count, dirty_indices.size(), info.max_gap, info.min_copy_size, error.value());
+            return false;
+        }
+        if (!check_mirror(rng, element_count, dirty_indices, plan))
+        {
+            fmt::print("Plan {} does not reproduce the source\n", iteration);
+            return false;
+        }
+        if (info.min_copy_size == 1 && !plan.scatter_indices.empty())
+        {
+            fmt::print("Plan {} scatters without a scatter pipeline\n", iteration);
+            return false;
+        }
+    }
+    if (!plan_uploads({}).empty() || plan_uploads({}).command_count() != 0)
+    {
+        fmt::print("Empty plan records commands\n");
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    if (!check_random_plans())
+    {
+        return 1;
+    }
+    fmt::print("Plans cover every dirty element once and reproduce the source after random dirty patterns\n");
+
+    /// NOTE: Commands per array and staged bytes per frame, a copy per dirty element against the coalesced plans.
+    //        Elements are 108 bytes, the packed entity arrays together.
+    static constexpr usize ELEMENT_SIZE = 108;
+    u32 const element_count = 1'000'000;
+    std::mt19937 rng{42};
+    fmt::print("{} elements, {} bytes each\n", element_count, ELEMENT_SIZE);
+    fmt::print("{:>10} | {:>10} | {:>11} | {:>14} | {:>13} | {:>17} | {:>16} | {:>10}\n",
+        "dirty", "cluster", "per element", "copy only cmds", "copy only MiB", "copy+scatter cmds", "copy+scatter MiB", "plan ms");
+    for (u32 const dirty_count : {100u, 10'000u, 100'000u})
+    {
+        for (u32 const cluster_size : {1u, 8u, 64u})
+        {
+            std::vector<u32> const dirty_indices = random_dirty_indices(rng, element_count, dirty_count, cluster_size);
+            UploadPlan const copy_plan = plan_uploads(dirty_indices, {.min_copy_size = 1});
+            auto const start = std::chrono::steady_clock::now();
+            UploadPlan const plan = plan_uploads(dirty_indices);
+            f64 const plan_ms = std::chrono::duration_cast<FpMili>(std::chrono::steady_clock::now() - start).count();
+            fmt::print("{:>10} | {:>10} | {:>11} | {:>14} | {:>13.3f} | {:>17} | {:>16.3f} | {:>10.3f}\n",
+                dirty_indices.size(), cluster_size, dirty_indices.size(), copy_plan.command_count(),
+                copy_plan.staging_size(ELEMENT_SIZE) / (1024.0 * 1024.0), plan.command_count(),
+                plan.staging_size(ELEMENT_SIZE) / (1024.0 * 1024.0), plan_ms);
+        }
+    }
+    return 0;
+}
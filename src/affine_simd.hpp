@@ -0,0 +1,328 @@
+#pragma once
+
+#include "cinder.hpp"
+#include <glm/gtc/quaternion.hpp>
+#include <span>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CINDER_AFFINE_SSE 1
+#include <immintrin.h>
+#endif
+#if defined(CINDER_AFFINE_SSE) && defined(__AVX2__)
+#define CINDER_AFFINE_AVX2 1
+#endif
+
+namespace cinder
+{
+    using namespace types;
+    struct Aabb
+    {
+        glm::vec3 min = {};
+        glm::vec3 max = {};
+    };
+    // Affine transform as translation, rotation and scale, applied scale first. Compact storage for a glm::mat4x3.
+    struct Trs
+    {
+        glm::vec3 translation = {};
+        glm::quat rotation = glm::identity<glm::quat>();
+        glm::vec3 scale = glm::vec3(1.0f);
+    };
+
+    /**
+     * DESCRIPTION:
+     * SIMD kernels for 4x3 affine transforms, glm::mat4x3 with an implicit (0,0,0,1) last row.
+     * NOTES:
+     * - Inside the kernels a matrix is three row registers, the row major 3x4 layout of acceleration structure instances.
+     *   glm::mat4x3 is column major, loads and stores transpose it with shuffles
+     * - SSE is the baseline on x86-64. With AVX2 (CINDER_ENABLE_AVX2) the batch kernels hold two matrices per register,
+     *   all shuffles stay within 128 bit lanes so the kernels are the same code for both widths
+     * - compose sums in the same order as glm::mat4 multiplication, results are bit identical to widening to mat4
+     * - Other targets fall back to scalar glm code with the same interface
+     * - Trs is the compact form entities store their local transform in, from_trs builds its matrix
+     * - Batch spans must have the same size, out may be one of the inputs
+     * THREADSAFETY:
+     * * all functions are pure
+     */
+    namespace affine
+    {
+        static_assert(sizeof(glm::mat4x3) == sizeof(f32) * 12, "Kernels assume tightly packed glm matrices");
+        static_assert(sizeof(Aabb) == sizeof(f32) * 6, "Kernels assume tightly packed glm vectors");
+        static_assert(sizeof(Trs) <= 40, "Trs is meant to be smaller than the matrix it describes");
+
+#if defined(CINDER_AFFINE_SSE)
+        namespace detail
+        {
+            // Result = (a[I0], a[I1], b[I2], b[I3]) in every 128 bit lane.
+            template <int I0, int I1, int I2, int I3>
+            inline auto shuffle(__m128 a, __m128 b) -> __m128 { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(I3, I2, I1, I0)); }
+            inline auto add(__m128 a, __m128 b) -> __m128 { return _mm_add_ps(a, b); }
+            inline auto sub(__m128 a, __m128 b) -> __m128 { return _mm_sub_ps(a, b); }
+            inline auto mul(__m128 a, __m128 b) -> __m128 { return _mm_mul_ps(a, b); }
+            inline auto div(__m128 a, __m128 b) -> __m128 { return _mm_div_ps(a, b); }
+            inline auto bit_and(__m128 a, __m128 b) -> __m128 { return _mm_and_ps(a, b); }
+            inline auto bit_and_not(__m128 a, __m128 b) -> __m128 { return _mm_andnot_ps(a, b); }
+            inline auto broadcast(__m128, f32 v) -> __m128 { return _mm_set1_ps(v); }
+            inline auto w_mask(__m128) -> __m128 { return _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0)); }
+            inline auto load(__m128, f32 const * p, usize) -> __m128 { return _mm_loadu_ps(p); }
+            inline void store(__m128 v, f32 * p, usize) { _mm_storeu_ps(p, v); }
+#if defined(CINDER_AFFINE_AVX2)
+            template <int I0, int I1, int I2, int I3>
+            inline auto shuffle(__m256 a, __m256 b) -> __m256 { return _mm256_shuffle_ps(a, b, _MM_SHUFFLE(I3, I2, I1, I0)); }
+            inline auto add(__m256 a, __m256 b) -> __m256 { return _mm256_add_ps(a, b); }
+            inline auto sub(__m256 a, __m256 b) -> __m256 { return _mm256_sub_ps(a, b); }
+            inline auto mul(__m256 a, __m256 b) -> __m256 { return _mm256_mul_ps(a, b); }
+            inline auto div(__m256 a, __m256 b) -> __m256 { return _mm256_div_ps(a, b); }
+            inline auto bit_and(__m256 a, __m256 b) -> __m256 { return _mm256_and_ps(a, b); }
+            inline auto bit_and_not(__m256 a, __m256 b) -> __m256 { return _mm256_andnot_ps(a, b); }
+            inline auto broadcast(__m256, f32 v) -> __m256 { return _mm256_set1_ps(v); }
+            inline auto w_mask(__m256) -> __m256 { return _mm256_castsi256_ps(_mm256_set_epi32(-1, 0, 0, 0, -1, 0, 0, 0)); }
+            // The upper lane is loaded from / stored to p + stride, stride in floats.
+            inline auto load(__m256, f32 const * p, usize stride) -> __m256 { return _mm256_loadu2_m128(p + stride, p); }
+            inline void store(__m256 v, f32 * p, usize stride) { _mm256_storeu2_m128(p + stride, p, v); }
+#endif
+            template <int I, typename V>
+            inline auto splat(V v) -> V { return shuffle<I, I, I, I>(v, v); }
+            template <typename V>
+            inline auto horizontal_sum(V v) -> V
+            {
+                V const pairs = add(v, shuffle<1, 0, 3, 2>(v, v));
+                return add(pairs, shuffle<2, 3, 0, 1>(pairs, pairs));
+            }
+            template <typename V>
+            inline auto cross(V u, V v) -> V
+            {
+                return sub(mul(shuffle<1, 2, 0, 3>(u, u), shuffle<2, 0, 1, 3>(v, v)), mul(shuffle<2, 0, 1, 3>(u, u), shuffle<1, 2, 0, 3>(v, v)));
+            }
+            template <typename V>
+            inline auto abs(V v) -> V { return bit_and_not(broadcast(v, -0.0f), v); }
+
+            template <typename V>
+            struct Rows
+            {
+                V r0, r1, r2;
+            };
+
+            /// NOTE: The twelve floats of a glm::mat4x3 are the columns c0 c1 c2 c3, three floats each.
+            //        Row i is (c0[i], c1[i], c2[i], c3[i]). stride is the distance to the matrix in the upper lane, in floats.
+            template <typename V>
+            inline auto load_rows(f32 const * p, usize stride) -> Rows<V>
+            {
+                V const m0 = load(V{}, p, stride);
+                V const m1 = load(V{}, p + 4, stride);
+                V const m2 = load(V{}, p + 8, stride);
+                return {
+                    shuffle<0, 2, 0, 2>(shuffle<0, 0, 3, 3>(m0, m0), shuffle<2, 2, 1, 1>(m1, m2)),
+                    shuffle<0, 2, 0, 2>(shuffle<1, 1, 0, 0>(m0, m1), shuffle<3, 3, 2, 2>(m1, m2)),
+                    shuffle<0, 2, 0, 2>(shuffle<2, 2, 1, 1>(m0, m1), shuffle<0, 0, 3, 3>(m2, m2)),
+                };
+            }
+            template <typename V>
+            inline void store_rows(Rows<V> const & r, f32 * p, usize stride)
+            {
+                store(shuffle<0, 2, 0, 2>(shuffle<0, 0, 0, 0>(r.r0, r.r1), shuffle<0, 0, 1, 1>(r.r2, r.r0)), p, stride);
+                store(shuffle<0, 2, 0, 2>(shuffle<1, 1, 1, 1>(r.r1, r.r2), shuffle<2, 2, 2, 2>(r.r0, r.r1)), p + 4, stride);
+                store(shuffle<0, 2, 0, 2>(shuffle<2, 2, 3, 3>(r.r2, r.r0), shuffle<3, 3, 3, 3>(r.r1, r.r2)), p + 8, stride);
+            }
+            // Columns c0 c1 c2 c3 (w lanes ignored) to the twelve floats of a glm::mat4x3.
+            template <typename V>
+            inline void store_columns(V c0, V c1, V c2, V c3, f32 * p, usize stride)
+            {
+                store(shuffle<0, 1, 0, 2>(c0, shuffle<2, 2, 0, 0>(c0, c1)), p, stride);
+                store(shuffle<1, 2, 0, 1>(c1, c2), p + 4, stride);
+                store(shuffle<0, 2, 1, 2>(shuffle<2, 2, 0, 0>(c2, c3), c3), p + 8, stride);
+            }
+
+            // Row i of lhs * rhs is lhs[i][0] * rhs.r0 + lhs[i][1] * rhs.r1 + lhs[i][2] * rhs.r2 + (0, 0, 0, lhs[i][3]).
+            template <typename V>
+            inline auto compose_row(V lhs_row, Rows<V> const & rhs) -> V
+            {
+                V const sum = add(add(mul(splat<0>(lhs_row), rhs.r0), mul(splat<1>(lhs_row), rhs.r1)), mul(splat<2>(lhs_row), rhs.r2));
+                return add(sum, bit_and(lhs_row, w_mask(lhs_row)));
+            }
+            template <typename V>
+            inline void compose(f32 const * lhs, f32 const * rhs, f32 * out, usize stride)
+            {
+                Rows<V> const l = load_rows<V>(lhs, stride);
+                Rows<V> const r = load_rows<V>(rhs, stride);
+                store_rows<V>({compose_row(l.r0, r), compose_row(l.r1, r), compose_row(l.r2, r)}, out, stride);
+            }
+            /// NOTE: For rows a b c the columns of the inverse 3x3 are cross(b, c), cross(c, a), cross(a, b) over the determinant.
+            //        The w lanes hold the translation, they cancel out in the cross products and the determinant.
+            template <typename V>
+            inline void inverse(f32 const * in, f32 * out, usize stride)
+            {
+                Rows<V> const m = load_rows<V>(in, stride);
+                V const x0 = cross(m.r1, m.r2);
+                V const inv_det = div(broadcast(x0, 1.0f), horizontal_sum(mul(m.r0, x0)));
+                V const c0 = mul(x0, inv_det);
+                V const c1 = mul(cross(m.r2, m.r0), inv_det);
+                V const c2 = mul(cross(m.r0, m.r1), inv_det);
+                V const translation = add(add(mul(c0, splat<3>(m.r0)), mul(c1, splat<3>(m.r1))), mul(c2, splat<3>(m.r2)));
+                store_columns(c0, c1, c2, sub(broadcast(c0, 0.0f), translation), out, stride);
+            }
+            /// NOTE: Transforms the center and the extent, extent' = |M| * extent. Tight for the transformed box.
+            template <typename V>
+            inline void transform_aabb(f32 const * transform, f32 const * aabb, f32 * out, usize transform_stride, usize aabb_stride)
+            {
+                V const m0 = load(V{}, transform, transform_stride);
+                V const m1 = load(V{}, transform + 4, transform_stride);
+                V const m2 = load(V{}, transform + 8, transform_stride);
+                V const c0 = m0;
+                V const c1 = shuffle<0, 2, 1, 1>(shuffle<3, 3, 0, 0>(m0, m1), m1);
+                V const c2 = shuffle<2, 3, 0, 0>(m1, m2);
+                V const c3 = shuffle<1, 2, 3, 3>(m2, m2);
+                V const min = load(V{}, aabb, aabb_stride);
+                V const upper = load(V{}, aabb + 2, aabb_stride);
+                V const max = shuffle<1, 2, 3, 3>(upper, upper);
+                V const half = broadcast(min, 0.5f);
+                V const center = mul(add(min, max), half);
+                V const extent = mul(sub(max, min), half);
+                V const new_center = add(add(add(mul(c0, splat<0>(center)), mul(c1, splat<1>(center))), mul(c2, splat<2>(center))), c3);
+                V const new_extent = add(add(mul(abs(c0), splat<0>(extent)), mul(abs(c1), splat<1>(extent))), mul(abs(c2), splat<2>(extent)));
+                V const new_min = sub(new_center, new_extent);
+                V const new_max = add(new_center, new_extent);
+                V const lower_corner = shuffle<2, 2, 0, 0>(new_min, new_max);
+                // The two stores overlap in out[2] and out[3], both write the same values.
+                store(shuffle<0, 1, 0, 2>(new_min, lower_corner), out, aabb_stride);
+                store(shuffle<0, 2, 1, 2>(lower_corner, new_max), out + 2, aabb_stride);
+            }
+            template <typename V>
+            inline void store_row_major_3x4(f32 const * in, f32 * out, usize in_stride, usize out_stride)
+            {
+                Rows<V> const rows = load_rows<V>(in, in_stride);
+                store(rows.r0, out, out_stride);
+                store(rows.r1, out + 4, out_stride);
+                store(rows.r2, out + 8, out_stride);
+            }
+
+            // Calls fn(V{}, index) for pairs of elements with AVX2 and for the remaining single elements with SSE.
+            template <typename FnT>
+            inline void for_each_batch(usize count, FnT && fn)
+            {
+                usize index = 0;
+#if defined(CINDER_AFFINE_AVX2)
+                for (; index + 2 <= count; index += 2) { fn(__m256{}, index); }
+#endif
+                for (; index < count; ++index) { fn(__m128{}, index); }
+            }
+        }
+#else
+        namespace detail
+        {
+            inline auto to_mat4(glm::mat4x3 const & transform) -> glm::mat4
+            {
+                return glm::mat4(
+                    glm::vec4(transform[0], 0.0f),
+                    glm::vec4(transform[1], 0.0f),
+                    glm::vec4(transform[2], 0.0f),
+                    glm::vec4(transform[3], 1.0f));
+            }
+        }
+#endif
+
+        inline auto f32_ptr(glm::mat4x3 const & m) -> f32 const * { return r_cast<f32 const *>(&m); }
+        inline auto f32_ptr(glm::mat4x3 & m) -> f32 * { return r_cast<f32 *>(&m); }
+
+        // lhs * rhs, rhs is applied first.
+        inline auto compose(glm::mat4x3 const & lhs, glm::mat4x3 const & rhs) -> glm::mat4x3
+        {
+            glm::mat4x3 out;
+#if defined(CINDER_AFFINE_SSE)
+            detail::compose<__m128>(f32_ptr(lhs), f32_ptr(rhs), f32_ptr(out), 0);
+#else
+            out = glm::mat4x3(detail::to_mat4(lhs) * detail::to_mat4(rhs));
+#endif
+            return out;
+        }
+        inline void compose(std::span<glm::mat4x3 const> lhs, std::span<glm::mat4x3 const> rhs, std::span<glm::mat4x3> out)
+        {
+            DBG_ASSERT_TRUE_M(lhs.size() == rhs.size() && lhs.size() == out.size(), "[ERROR][affine::compose()] Batch sizes differ");
+#if defined(CINDER_AFFINE_SSE)
+            detail::for_each_batch(out.size(), [&]<typename V>(V, usize i)
+                { detail::compose<V>(f32_ptr(lhs[i]), f32_ptr(rhs[i]), f32_ptr(out[i]), 12); });
+#else
+            for (usize i = 0; i < out.size(); ++i) { out[i] = compose(lhs[i], rhs[i]); }
+#endif
+        }
+        inline auto inverse(glm::mat4x3 const & transform) -> glm::mat4x3
+        {
+            glm::mat4x3 out;
+#if defined(CINDER_AFFINE_SSE)
+            detail::inverse<__m128>(f32_ptr(transform), f32_ptr(out), 0);
+#else
+            out = glm::mat4x3(glm::inverse(detail::to_mat4(transform)));
+#endif
+            return out;
+        }
+        inline void inverse(std::span<glm::mat4x3 const> transforms, std::span<glm::mat4x3> out)
+        {
+            DBG_ASSERT_TRUE_M(transforms.size() == out.size(), "[ERROR][affine::inverse()] Batch sizes differ");
+#if defined(CINDER_AFFINE_SSE)
+            detail::for_each_batch(out.size(), [&]<typename V>(V, usize i)
+                { detail::inverse<V>(f32_ptr(transforms[i]), f32_ptr(out[i]), 12); });
+#else
+            for (usize i = 0; i < out.size(); ++i) { out[i] = inverse(transforms[i]); }
+#endif
+        }
+        inline auto transform_aabb(glm::mat4x3 const & transform, Aabb const & aabb) -> Aabb
+        {
+            Aabb out;
+#if defined(CINDER_AFFINE_SSE)
+            detail::transform_aabb<__m128>(f32_ptr(transform), r_cast<f32 const *>(&aabb), r_cast<f32 *>(&out), 0, 0);
+#else
+            glm::vec3 const center = (aabb.min + aabb.max) * 0.5f;
+            glm::vec3 const extent = (aabb.max - aabb.min) * 0.5f;
+            glm::vec3 const new_center = transform[0] * center.x + transform[1] * center.y + transform[2] * center.z + transform[3];
+            glm::vec3 const new_extent = glm::abs(transform[0]) * extent.x + glm::abs(transform[1]) * extent.y + glm::abs(transform[2]) * extent.z;
+            out = {new_center - new_extent, new_center + new_extent};
+#endif
+            return out;
+        }
+        inline void transform_aabbs(std::span<glm::mat4x3 const> transforms, std::span<Aabb const> aabbs, std::span<Aabb> out)
+        {
+            DBG_ASSERT_TRUE_M(transforms.size() == aabbs.size() && aabbs.size() == out.size(), "[ERROR][affine::transform_aabbs()] Batch sizes differ");
+#if defined(CINDER_AFFINE_SSE)
+            detail::for_each_batch(out.size(), [&]<typename V>(V, usize i)
+                { detail::transform_aabb<V>(f32_ptr(transforms[i]), r_cast<f32 const *>(&aabbs[i]), r_cast<f32 *>(&out[i]), 12, 6); });
+#else
+            for (usize i = 0; i < out.size(); ++i) { out[i] = transform_aabb(transforms[i], aabbs[i]); }
+#endif
+        }
+        // Writes the twelve floats of the row major 3x4 matrix, the layout of daxa_BlasInstanceData::transform.
+        inline void store_row_major_3x4(glm::mat4x3 const & transform, f32 * out)
+        {
+#if defined(CINDER_AFFINE_SSE)
+            detail::store_row_major_3x4<__m128>(f32_ptr(transform), out, 0, 0);
+#else
+            for (u32 row = 0; row < 3; ++row)
+            {
+                for (u32 column = 0; column < 4; ++column) { out[row * 4 + column] = transform[column][row]; }
+            }
+#endif
+        }
+        // Same as above for a batch, output i starts at out + i * out_stride floats.
+        inline void store_row_major_3x4(std::span<glm::mat4x3 const> transforms, f32 * out, usize out_stride)
+        {
+#if defined(CINDER_AFFINE_SSE)
+            detail::for_each_batch(transforms.size(), [&]<typename V>(V, usize i)
+                { detail::store_row_major_3x4<V>(f32_ptr(transforms[i]), out + i * out_stride, 12, out_stride); });
+#else
+            for (usize i = 0; i < transforms.size(); ++i) { store_row_major_3x4(transforms[i], out + i * out_stride); }
+#endif
+        }
+
+        // Matrix of translation * rotation * scale. The rotation has to be a unit quaternion.
+        inline auto from_trs(Trs const & trs) -> glm::mat4x3
+        {
+            glm::quat const & q = trs.rotation;
+            f32 const xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+            f32 const xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+            f32 const wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+            return glm::mat4x3(
+                glm::vec3(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy)) * trs.scale.x,
+                glm::vec3(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx)) * trs.scale.y,
+                glm::vec3(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy)) * trs.scale.z,
+                trs.translation);
+        }
+    }
+}
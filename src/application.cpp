@@ -1,8 +1,14 @@
 #include "application.hpp"
 
+#include "rendering/tasks/scatter_upload.inl"
+
 Application::Application()
 {
-    threadpool = std::make_unique<ThreadPool>(7);
+    // One worker per physical core, the core left over is for this thread which records and submits the frames.
+    threadpool = std::make_unique<ThreadPool>(ThreadPoolInfo{.reserved_cores = 1, .pin_workers = true});
+    DEBUG_MESSAGE(fmt::format("[Info][Application::Application()] {}, {} workers, {} io threads",
+        threadpool->topology().to_string(), threadpool->thread_count(), threadpool->io_thread_count()));
+    main_thread_executor = std::make_unique<MainThreadExecutor>();
     window = std::make_unique<Window>(1920, 1080, "Cinder");
     gpu_context = std::make_unique<GPUContext>(*window);
     scene = std::make_unique<Scene>(gpu_context->device);
@@ -23,7 +29,8 @@ Application::Application()
         .root_path = DEFAULT_HARDCODED_PATH,
         .asset_name = DEFAULT_HARDCODED_FILE,
         .thread_pool = threadpool,
-        .asset_processor = asset_processor
+        .asset_processor = asset_processor,
+        .main_thread_executor = main_thread_executor.get(),
     });
 
     if(Scene::LoadManifestErrorCode const * err = std::get_if<Scene::LoadManifestErrorCode>(&result)) {
@@ -37,6 +44,42 @@ Application::Application()
     last_time_point = std::chrono::steady_clock::now();
 }
 
+static void log_thread_pool_stats(ThreadPoolStats const & stats)
+{
+    MESSAGE("[Info][Application] ThreadPool stats since the last report:");
+    auto log_thread = [](std::string_view name, ThreadPoolThreadStats const & thread)
+    {
+        f64 const total_ms = thread.busy_ms + thread.idle_ms;
+        MESSAGE(fmt::format("    {:>10} | busy {:>9.2f}ms ({:>5.1f}%) | idle {:>9.2f}ms | chunks {:>8} | stolen {:>7} | lock wait {:>7.3f}ms",
+            name, thread.busy_ms, total_ms > 0.0 ? thread.busy_ms / total_ms * 100.0 : 0.0, thread.idle_ms,
+            thread.executed_chunks, thread.stolen_chunks, thread.lock_wait_ms));
+    };
+    for (u32 worker_index = 0; worker_index < stats.workers.size(); ++worker_index)
+    {
+        log_thread(fmt::format("worker {}", worker_index), stats.workers[worker_index]);
+    }
+    log_thread("external", stats.external_threads);
+    log_thread("io", stats.io_threads);
+    MESSAGE(fmt::format("    {:>10} | queued {:>6}", "io", stats.queued_io_chunks));
+    for (u32 priority_index = 0; priority_index < TASK_PRIORITY_COUNT; ++priority_index)
+    {
+        TaskPriorityStats const & priority = stats.priorities[priority_index];
+        MESSAGE(fmt::format("    priority {} | queued {:>6} (peak {:>6}) | started {:>8} | aged {:>6} | wait avg {:>7.3f}ms max {:>8.3f}ms",
+            priority_index, priority.queued_chunks, priority.peak_queued_chunks, priority.started_chunks,
+            priority.aged_chunks, priority.average_wait_ms, priority.max_wait_ms));
+    }
+}
+
+static void log_upload_stats(Scene::ManifestUploadStats const & stats, u32 frame_count, u32 peak_commands_per_frame)
+{
+    u32 const command_count = stats.copy_commands + stats.scatter_dispatches;
+    MESSAGE(fmt::format("[Info][Application] Manifest uploads since the last report: {} frames with uploads | "
+                        "{} copies + {} scatter dispatches | {:.1f} commands per frame (peak {}) | {:.2f} MiB staged",
+        frame_count, stats.copy_commands, stats.scatter_dispatches,
+        frame_count > 0 ? s_cast<f64>(command_count) / frame_count : 0.0, peak_commands_per_frame,
+        s_cast<f64>(stats.staging_size) / (1024.0 * 1024.0)));
+}
+
 using FpMili = std::chrono::duration<f32, std::chrono::milliseconds::period>;
 auto Application::run() -> i32
 {
@@ -62,6 +105,17 @@ auto Application::run() -> i32
             update();
             gpu_context->device.collect_garbage();
         }
+
+        threadpool->sample_queue_depths();
+        if(window->key_just_pressed(GLFW_KEY_F9))
+        {
+            log_thread_pool_stats(threadpool->stats());
+            threadpool->reset_stats();
+            log_upload_stats(upload_stats_since_report, upload_frames_since_report, peak_upload_commands_per_frame);
+            upload_stats_since_report = {};
+            upload_frames_since_report = 0;
+            peak_upload_commands_per_frame = 0;
+        }
     }
 
     return 0;
@@ -69,12 +123,26 @@ auto Application::run() -> i32
 
 void Application::update()
 {
+    /// NOTE: Records the uploads of finished loads among others, has to run before the upload commands are collected.
+    main_thread_executor->drain(main_thread_frame_budget);
     auto asset_data_upload_info = asset_processor->record_gpu_load_processing_commands();
     auto manifest_update_commands = scene->record_gpu_manifest_update({
         .uploaded_meshes = asset_data_upload_info.uploaded_meshes,
-        .uploaded_textures = asset_data_upload_info.uploaded_textures
+        .uploaded_textures = asset_data_upload_info.uploaded_textures,
+        .thread_pool = threadpool.get(),
+        .scatter_upload_pipeline = gpu_context->compute_pipelines.at(scatter_upload_pipeline_compile_info().name).get(),
     });
-    auto build_blas_commands = scene->create_and_record_build_as();
+    Scene::ManifestUploadStats const & upload_stats = scene->_last_upload_stats;
+    u32 const upload_commands = upload_stats.copy_commands + upload_stats.scatter_dispatches;
+    if (upload_commands > 0)
+    {
+        upload_stats_since_report.copy_commands += upload_stats.copy_commands;
+        upload_stats_since_report.scatter_dispatches += upload_stats.scatter_dispatches;
+        upload_stats_since_report.staging_size += upload_stats.staging_size;
+        upload_frames_since_report += 1;
+        peak_upload_commands_per_frame = std::max(peak_upload_commands_per_frame, upload_commands);
+    }
+    auto build_blas_commands = scene->create_and_record_build_as(*threadpool);
 
     auto cmd_lists = std::array{
         std::move(asset_data_upload_info.upload_commands),
@@ -98,17 +166,30 @@ void Application::update()
 
 Application::~Application()
 {
-    threadpool.reset();
-    auto asset_data_upload_info = asset_processor->record_gpu_load_processing_commands();
-    auto manifest_update_commands = scene->record_gpu_manifest_update({
-        .uploaded_meshes = asset_data_upload_info.uploaded_meshes,
-        .uploaded_textures = asset_data_upload_info.uploaded_textures,
-    });
-    auto cmd_lists = std::array{
-        std::move(asset_data_upload_info.upload_commands),
-        std::move(manifest_update_commands)
+    // Nothing is going to be drawn anymore, stop the loads that are still reading or decoding.
+    scene->cancel_pending_loads();
+    /// NOTE: Flush the finished loads while the pool is still alive, the manifest update runs on all workers with
+    //        this thread helping. Whatever finishes while the workers are joined is flushed serially afterwards.
+    auto flush_uploads = [&](ThreadPool * thread_pool)
+    {
+        main_thread_executor->drain_all();
+        auto asset_data_upload_info = asset_processor->record_gpu_load_processing_commands();
+        auto manifest_update_commands = scene->record_gpu_manifest_update({
+            .uploaded_meshes = asset_data_upload_info.uploaded_meshes,
+            .uploaded_textures = asset_data_upload_info.uploaded_textures,
+            .thread_pool = thread_pool,
+            .scatter_upload_pipeline = gpu_context->compute_pipelines.at(scatter_upload_pipeline_compile_info().name).get(),
+        });
+        auto cmd_lists = std::array{
+            std::move(asset_data_upload_info.upload_commands),
+            std::move(manifest_update_commands)
+        };
+        gpu_context->device.submit_commands({.command_lists = cmd_lists});
     };
-    gpu_context->device.submit_commands({.command_lists = cmd_lists});
+    flush_uploads(threadpool.get());
+    threadpool.reset();
+    asset_processor->abandon_suspended_loads();
+    flush_uploads(nullptr);
     gpu_context->device.wait_idle();
     gpu_context->device.collect_garbage();
-}
\ No newline at end of file
+}
@@ -13,6 +13,7 @@ using namespace cinder::types;
 #include "scene/scene.hpp"
 #include "scene/asset_processor.hpp"
 #include "multithreading/thread_pool.hpp"
+#include "multithreading/main_thread_executor.hpp"
 #include "rendering/renderer.hpp"
 
 struct Application
@@ -30,11 +31,19 @@ private:
     std::unique_ptr<Scene> scene = {};
     std::unique_ptr<AssetProcessor> asset_processor = {};
     std::unique_ptr<ThreadPool> threadpool = {};
+    // Follow ups of the workers that have to run on this thread, drained once a frame.
+    std::unique_ptr<MainThreadExecutor> main_thread_executor = {};
     std::unique_ptr<Renderer> renderer = {};
 
     CameraController camera_controller = {};
 
     bool keep_running = true;
     f32 delta_time = 0.016666f;
+    // Time the main thread executor may take each frame, the rest of its queue waits for the next frame.
+    std::chrono::microseconds main_thread_frame_budget = std::chrono::microseconds{2000};
     std::chrono::time_point<std::chrono::steady_clock> last_time_point = {};
+    // Manifest upload commands since the last F9 report.
+    Scene::ManifestUploadStats upload_stats_since_report = {};
+    u32 upload_frames_since_report = {};
+    u32 peak_upload_commands_per_frame = {};
 };
\ No newline at end of file
@@ -0,0 +1,254 @@
+#pragma once
+
+#include "cinder.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+namespace cinder
+{
+    using namespace types;
+    /**
+     * DESCRIPTION:
+     * SlotMap flavour that can be used from many threads at once (e.g. loader tasks spawning entities).
+     * NOTES:
+     * - Slots live in fixed size pages that are never moved, growing never invalidates pointers and never blocks readers
+     * - Lookups (slot, is_id_valid) are wait free, a page table load plus one atomic load of the slot state
+     * - Free slot indices are kept in per thread shards, a thread takes from its own shard first, then tries to take
+     *   from the other shards without waiting and only then bumps the index of a never used slot
+     * - Deferred reuse: destroy_slot only invalidates the Id, the value stays alive and the slot is not reused.
+     *   Slots destroyed before the previous reclaim_destroyed_slots call are destroyed and become reusable in the
+     *   next one. Call it once per frame, a reader may then keep a pointer from slot() until the end of the next frame
+     *   even if the slot was destroyed in the meantime, it never sees a recycled slot
+     * - Writing the same value from several threads at once needs synchronization by the user
+     * THREADSAFETY:
+     * * internally synchronized, reclaim_destroyed_slots must not run concurrently with itself
+     */
+    template <typename T>
+    struct ConcurrentSlotMap
+    {
+        public:
+            struct Id
+            {
+                u32 index = {};
+                u32 version = {};
+            };
+            static inline constexpr Id EMPTY_ID = { 0, 0 };
+            static inline constexpr u32 PAGE_SIZE_LOG2 = 14;
+            static inline constexpr u32 PAGE_SIZE = 1u << PAGE_SIZE_LOG2;
+            static inline constexpr u32 MAX_PAGES = 4096;
+            static inline constexpr u32 SHARD_COUNT = 16;
+
+        private:
+            /// NOTE: state = version << 1 | alive. A slot is created at version 1, destroying it bumps the version.
+            struct Slot
+            {
+                std::atomic_uint32_t state = {};
+                alignas(T) std::byte storage[sizeof(T)];
+                auto value() -> T * { return std::launder(r_cast<T *>(storage)); }
+            };
+            static inline constexpr u32 ALIVE_BIT = 1u;
+            static inline constexpr u32 MAX_VERSION = std::numeric_limits<u32>::max() >> 1u;
+            // Marks entries of the destroyed lists whose slot ran out of versions, they are never reused.
+            static inline constexpr u32 VERSION_EXHAUSTED_BIT = 1u << 31u;
+
+            struct alignas(64) Shard
+            {
+                std::mutex mutex = {};
+                std::vector<u32> free = {};
+                // Destroyed since the last reclaim, values still alive.
+                std::vector<u32> destroyed = {};
+                // Destroyed before the last reclaim, readers may still look at them until the next one.
+                std::vector<u32> retiring = {};
+            };
+
+            std::array<std::atomic<Slot *>, MAX_PAGES>
+                _pages = {};
+            std::atomic_uint32_t
+                _next_index = {};
+            std::atomic_int64_t
+                _size = {};
+            // Indices on all free lists, lets create_slot skip the shards when there is nothing to reuse.
+            std::atomic_uint32_t
+                _free_count = {};
+            std::array<Shard, SHARD_COUNT>
+                _shards = {};
+
+            static auto thread_shard() -> u32
+            {
+                static std::atomic_uint32_t next_shard = {};
+                thread_local u32 const shard = next_shard.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT;
+                return shard;
+            }
+
+            auto slot_at(u32 index) const -> Slot *
+            {
+                Slot * page = _pages[index >> PAGE_SIZE_LOG2].load(std::memory_order_acquire);
+                return page != nullptr ? &page[index & (PAGE_SIZE - 1)] : nullptr;
+            }
+
+            auto ensure_page(u32 page_index) -> Slot *
+            {
+                Slot * page = _pages[page_index].load(std::memory_order_acquire);
+                if (page != nullptr) { return page; }
+                /// NOTE: Several threads may race to create the same page, the first one wins and the others free theirs.
+                Slot * new_page = new Slot[PAGE_SIZE];
+                for (u32 i = 0; i < PAGE_SIZE; ++i) { new_page[i].state.store(1u << 1u, std::memory_order_relaxed); }
+                if (_pages[page_index].compare_exchange_strong(page, new_page, std::memory_order_acq_rel, std::memory_order_acquire))
+                {
+                    return new_page;
+                }
+                delete[] new_page;
+                return page;
+            }
+
+            auto pop_free_index(u32 & index) -> bool
+            {
+                if (_free_count.load(std::memory_order_relaxed) == 0) { return false; }
+                u32 const own_shard = thread_shard();
+                {
+                    std::lock_guard lock{_shards[own_shard].mutex};
+                    if (!_shards[own_shard].free.empty())
+                    {
+                        index = _shards[own_shard].free.back();
+                        _shards[own_shard].free.pop_back();
+                        _free_count.fetch_sub(1, std::memory_order_relaxed);
+                        return true;
+                    }
+                }
+                for (u32 offset = 1; offset < SHARD_COUNT; ++offset)
+                {
+                    Shard & shard = _shards[(own_shard + offset) % SHARD_COUNT];
+                    std::unique_lock lock{shard.mutex, std::try_to_lock};
+                    if (lock.owns_lock() && !shard.free.empty())
+                    {
+                        index = shard.free.back();
+                        shard.free.pop_back();
+                        _free_count.fetch_sub(1, std::memory_order_relaxed);
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+        public:
+            ConcurrentSlotMap() = default;
+            ConcurrentSlotMap(ConcurrentSlotMap const &) = delete;
+            ConcurrentSlotMap & operator=(ConcurrentSlotMap const &) = delete;
+            ~ConcurrentSlotMap()
+            {
+                /// NOTE: Values of destroyed but not yet reclaimed slots are still alive.
+                for (Shard & shard : _shards)
+                {
+                    for (u32 const entry : shard.destroyed) { std::destroy_at(slot_at(entry & ~VERSION_EXHAUSTED_BIT)->value()); }
+                    for (u32 const entry : shard.retiring) { std::destroy_at(slot_at(entry & ~VERSION_EXHAUSTED_BIT)->value()); }
+                }
+                u32 const used_slots = _next_index.load();
+                for (u32 page_index = 0; page_index < MAX_PAGES; ++page_index)
+                {
+                    Slot * page = _pages[page_index].load();
+                    if (page == nullptr) { continue; }
+                    for (u32 i = 0; i < PAGE_SIZE && (page_index << PAGE_SIZE_LOG2) + i < used_slots; ++i)
+                    {
+                        if ((page[i].state.load() & ALIVE_BIT) != 0) { std::destroy_at(page[i].value()); }
+                    }
+                    delete[] page;
+                }
+            }
+
+            auto create_slot(T&& v = {}) -> Id
+            {
+                u32 index = {};
+                if (!pop_free_index(index))
+                {
+                    index = _next_index.fetch_add(1, std::memory_order_relaxed);
+                    DBG_ASSERT_TRUE_M(index < MAX_PAGES * PAGE_SIZE, "[ConcurrentSlotMap::create_slot()] Out of slots");
+                    ensure_page(index >> PAGE_SIZE_LOG2);
+                }
+                Slot & slot = *slot_at(index);
+                u32 const version = slot.state.load(std::memory_order_relaxed) >> 1u;
+                std::construct_at(slot.value(), std::move(v));
+                /// NOTE: Publishes the value, a reader that sees the new state also sees the constructed value.
+                slot.state.store((version << 1u) | ALIVE_BIT, std::memory_order_release);
+                _size.fetch_add(1, std::memory_order_relaxed);
+                return Id{index, version};
+            }
+            auto destroy_slot(Id id) -> bool
+            {
+                Slot * slot = id.index < MAX_PAGES * PAGE_SIZE ? slot_at(id.index) : nullptr;
+                if (slot == nullptr) { return false; }
+                u32 expected = (id.version << 1u) | ALIVE_BIT;
+                u32 const next_version = id.version + 1;
+                /// NOTE: Only one of several threads destroying the same id wins.
+                if (!slot->state.compare_exchange_strong(expected, next_version << 1u, std::memory_order_acq_rel))
+                {
+                    return false;
+                }
+                _size.fetch_sub(1, std::memory_order_relaxed);
+                Shard & shard = _shards[thread_shard()];
+                std::lock_guard lock{shard.mutex};
+                // A slot that ran out of versions is never reused, but its value still has to go once no one reads it.
+                shard.destroyed.push_back(next_version < MAX_VERSION ? id.index : id.index | VERSION_EXHAUSTED_BIT);
+                return true;
+            }
+            auto slot(Id id) -> T *
+            {
+                if (this->is_id_valid(id))
+                {
+                    return slot_at(id.index)->value();
+                }
+                return nullptr;
+            }
+            auto slot(Id id) const -> T const *
+            {
+                if (this->is_id_valid(id))
+                {
+                    return slot_at(id.index)->value();
+                }
+                return nullptr;
+            }
+            auto is_id_valid(Id id) const -> bool
+            {
+                if (id.index >= MAX_PAGES * PAGE_SIZE) { return false; }
+                Slot const * slot = slot_at(id.index);
+                return slot != nullptr && slot->state.load(std::memory_order_acquire) == ((id.version << 1u) | ALIVE_BIT);
+            }
+            /**
+             * NOTES:
+             * - Slots destroyed before the previous call are destroyed and put on the free lists
+             * - Slots destroyed since the previous call are kept around until the next one
+             */
+            void reclaim_destroyed_slots()
+            {
+                for (Shard & shard : _shards)
+                {
+                    std::lock_guard lock{shard.mutex};
+                    for (u32 const entry : shard.retiring)
+                    {
+                        u32 const index = entry & ~VERSION_EXHAUSTED_BIT;
+                        std::destroy_at(slot_at(index)->value());
+                        if ((entry & VERSION_EXHAUSTED_BIT) == 0)
+                        {
+                            shard.free.push_back(index);
+                            _free_count.fetch_add(1, std::memory_order_relaxed);
+                        }
+                    }
+                    shard.retiring.clear();
+                    std::swap(shard.retiring, shard.destroyed);
+                }
+            }
+            // Approximate while other threads create or destroy.
+            auto size() const -> usize
+            {
+                return s_cast<usize>(std::max(i64(0), _size.load(std::memory_order_relaxed)));
+            }
+            auto capacity() const -> usize
+            {
+                return _next_index.load(std::memory_order_relaxed);
+            }
+    };
+}
@@ -0,0 +1,132 @@
+#include "coroutine.hpp"
+
+namespace cinder
+{
+    ResumeCoroutineTask::ResumeCoroutineTask(std::coroutine_handle<> handle)
+        : handle{handle}
+    {
+        chunk_count = 1;
+    }
+
+    void ResumeCoroutineTask::callback(u32 chunk_index, u32 thread_index)
+    {
+        handle.resume();
+    }
+
+    void ResumeOnAwaiter::await_suspend(std::coroutine_handle<> handle)
+    {
+        /// NOTE: The coroutine may already run on another thread once the dispatch returns, the awaiter lives in its
+        //        frame so it must not be touched afterwards.
+        thread_pool->async_dispatch_fn([handle]
+            { handle.resume(); },
+            1, priority);
+    }
+
+    auto resume_on(ThreadPool & thread_pool, TaskPriority priority) -> ResumeOnAwaiter
+    {
+        return ResumeOnAwaiter{.thread_pool = &thread_pool, .priority = priority};
+    }
+
+    void ResumeOnIoAwaiter::await_suspend(std::coroutine_handle<> handle)
+    {
+        thread_pool->async_dispatch_io_fn([handle]
+            { handle.resume(); });
+    }
+
+    auto resume_on_io(ThreadPool & thread_pool) -> ResumeOnIoAwaiter
+    {
+        return ResumeOnIoAwaiter{.thread_pool = &thread_pool};
+    }
+
+    void WaitForTaskAwaiter::await_suspend(std::coroutine_handle<> handle)
+    {
+        auto const dependencies = std::array<std::shared_ptr<Task>, 1>{std::move(task)};
+        thread_pool->async_dispatch_after(std::make_shared<ResumeCoroutineTask>(handle), dependencies, priority);
+    }
+
+    auto wait_for(ThreadPool & thread_pool, std::shared_ptr<Task> task, TaskPriority priority) -> WaitForTaskAwaiter
+    {
+        return WaitForTaskAwaiter{.thread_pool = &thread_pool, .task = std::move(task), .priority = priority};
+    }
+
+    AsyncBudget::AsyncBudget(u64 capacity)
+        : capacity{capacity}
+    {
+    }
+
+    auto AsyncBudget::fits(u64 amount) const -> bool
+    {
+        return used == 0 || used + amount <= capacity;
+    }
+
+    auto AsyncBudget::AcquireAwaiter::await_suspend(std::coroutine_handle<> handle) -> bool
+    {
+        std::lock_guard lock{budget->mutex};
+        // Waiters are served in order, don't overtake them even if the amount would fit.
+        if (budget->waiters.empty() && budget->fits(amount))
+        {
+            budget->used += amount;
+            return false;
+        }
+        budget->waiters.push_back({handle, thread_pool, amount, priority});
+        return true;
+    }
+
+    auto AsyncBudget::acquire(ThreadPool & thread_pool, u64 amount, TaskPriority priority) -> AcquireAwaiter
+    {
+        return AcquireAwaiter{.budget = this, .thread_pool = &thread_pool, .amount = amount, .priority = priority};
+    }
+
+    void AsyncBudget::release(u64 amount)
+    {
+        std::vector<Waiter> ready = {};
+        {
+            std::lock_guard lock{mutex};
+            DBG_ASSERT_TRUE_M(amount <= used, "[AsyncBudget::release()] Released more than was acquired");
+            used -= amount;
+            while (!waiters.empty() && fits(waiters.front().amount))
+            {
+                used += waiters.front().amount;
+                ready.push_back(waiters.front());
+                waiters.pop_front();
+            }
+        }
+        for (Waiter const & waiter : ready)
+        {
+            waiter.thread_pool->async_dispatch_fn([handle = waiter.handle]
+                { handle.resume(); },
+                1, waiter.priority);
+        }
+    }
+
+    auto AsyncBudget::in_use() -> u64
+    {
+        std::lock_guard lock{mutex};
+        return used;
+    }
+
+    void AsyncBudget::abandon_waiters()
+    {
+        std::lock_guard lock{mutex};
+        waiters.clear();
+    }
+
+    auto spawn(ThreadPool & thread_pool, task<void> coroutine, TaskPriority priority) -> std::shared_ptr<Task>
+    {
+        struct CompletionTask : Task
+        {
+            CompletionTask() { chunk_count = 1; }
+            virtual void callback(u32 chunk_index, u32 thread_index) override {}
+        };
+        auto completion = std::make_shared<CompletionTask>();
+        auto run = [](ThreadPool & thread_pool, task<void> coroutine, std::shared_ptr<Task> completion, TaskPriority priority) -> detail::DetachedCoroutine
+        {
+            co_await resume_on(thread_pool, priority);
+            co_await std::move(coroutine);
+            // Finishing the completion task releases everything waiting on the spawned coroutine.
+            thread_pool.async_dispatch(completion, priority);
+        };
+        run(thread_pool, std::move(coroutine), completion, priority);
+        return completion;
+    }
+} // namespace cinder
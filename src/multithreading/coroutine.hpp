@@ -0,0 +1,273 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <semaphore>
+#include <type_traits>
+#include <utility>
+
+#include "thread_pool.hpp"
+
+/**
+ * DESCRIPTION:
+ * Coroutines scheduled on the ThreadPool.
+ * A cinder::task<T> is lazy, it only starts running once it is co_awaited or spawned.
+ * Awaiting a task resumes the awaiting coroutine on the thread that finished the task (symmetric transfer).
+ * Instead of blocking a worker, coroutines suspend on the awaitables below and get rescheduled as a Task once they can continue.
+ * NOTES:
+ * - A coroutine can resume on a different thread after each co_await, don't keep thread local state across suspension points
+ * - Coroutines suspended when the ThreadPool is destroyed are never resumed, their frames are leaked
+ */
+namespace cinder
+{
+    template <typename T = void>
+    struct task;
+
+    namespace detail
+    {
+        struct TaskPromiseBase
+        {
+            std::coroutine_handle<> continuation = {};
+            std::exception_ptr exception = {};
+
+            struct FinalAwaiter
+            {
+                auto await_ready() noexcept -> bool { return false; }
+                template <typename PromiseT>
+                auto await_suspend(std::coroutine_handle<PromiseT> handle) noexcept -> std::coroutine_handle<>
+                {
+                    auto const continuation = handle.promise().continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+                void await_resume() noexcept {}
+            };
+            auto initial_suspend() noexcept -> std::suspend_always { return {}; }
+            auto final_suspend() noexcept -> FinalAwaiter { return {}; }
+            void unhandled_exception() { exception = std::current_exception(); }
+        };
+
+        template <typename T>
+        struct TaskPromise : TaskPromiseBase
+        {
+            std::optional<T> value = {};
+            auto get_return_object() -> task<T>;
+            template <typename ValueT>
+            void return_value(ValueT && new_value) { value.emplace(std::forward<ValueT>(new_value)); }
+            auto result() -> T
+            {
+                if (exception) { std::rethrow_exception(exception); }
+                return std::move(value.value());
+            }
+        };
+
+        template <>
+        struct TaskPromise<void> : TaskPromiseBase
+        {
+            auto get_return_object() -> task<void>;
+            void return_void() {}
+            void result()
+            {
+                if (exception) { std::rethrow_exception(exception); }
+            }
+        };
+
+        // Fire and forget coroutine, starts immediately and frees its own frame when done.
+        struct DetachedCoroutine
+        {
+            struct promise_type
+            {
+                auto get_return_object() -> DetachedCoroutine { return {}; }
+                auto initial_suspend() noexcept -> std::suspend_never { return {}; }
+                auto final_suspend() noexcept -> std::suspend_never { return {}; }
+                void return_void() {}
+                void unhandled_exception() { std::terminate(); }
+            };
+        };
+    } // namespace detail
+
+    template <typename T>
+    struct task
+    {
+        using promise_type = detail::TaskPromise<T>;
+        using handle_type = std::coroutine_handle<promise_type>;
+
+        task() = default;
+        explicit task(handle_type handle) : handle{handle} {}
+        task(task && other) noexcept : handle{std::exchange(other.handle, {})} {}
+        auto operator=(task && other) noexcept -> task &
+        {
+            if (this != &other)
+            {
+                if (handle) { handle.destroy(); }
+                handle = std::exchange(other.handle, {});
+            }
+            return *this;
+        }
+        task(task const &) = delete;
+        auto operator=(task const &) -> task & = delete;
+        ~task()
+        {
+            if (handle) { handle.destroy(); }
+        }
+
+        struct Awaiter
+        {
+            handle_type handle = {};
+            auto await_ready() noexcept -> bool { return !handle || handle.done(); }
+            auto await_suspend(std::coroutine_handle<> awaiting) noexcept -> std::coroutine_handle<>
+            {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+            auto await_resume() -> T { return handle.promise().result(); }
+        };
+        auto operator co_await() && noexcept -> Awaiter { return Awaiter{handle}; }
+
+      private:
+        handle_type handle = {};
+    };
+
+    namespace detail
+    {
+        template <typename T>
+        auto TaskPromise<T>::get_return_object() -> task<T>
+        {
+            return task<T>{std::coroutine_handle<TaskPromise<T>>::from_promise(*this)};
+        }
+
+        inline auto TaskPromise<void>::get_return_object() -> task<void>
+        {
+            return task<void>{std::coroutine_handle<TaskPromise<void>>::from_promise(*this)};
+        }
+    } // namespace detail
+
+    // Resumes a suspended coroutine when its chunk is picked up by a worker.
+    // Only needed where a shared Task is required (continuations), plain resumes use the allocation free async_dispatch_fn.
+    struct ResumeCoroutineTask : Task
+    {
+        std::coroutine_handle<> handle = {};
+        ResumeCoroutineTask(std::coroutine_handle<> handle);
+        virtual void callback(u32 chunk_index, u32 thread_index) override;
+    };
+
+    // Suspends the coroutine and continues it on a worker of the pool.
+    struct ResumeOnAwaiter
+    {
+        ThreadPool * thread_pool = {};
+        TaskPriority priority = {};
+        auto await_ready() noexcept -> bool { return false; }
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() noexcept {}
+    };
+    auto resume_on(ThreadPool & thread_pool, TaskPriority priority = TaskPriority::LOW) -> ResumeOnAwaiter;
+
+    // Suspends the coroutine and continues it on the io lane of the pool, for blocking file io.
+    // Hop back with resume_on before doing cpu heavy work, the io lane only has a few threads.
+    struct ResumeOnIoAwaiter
+    {
+        ThreadPool * thread_pool = {};
+        auto await_ready() noexcept -> bool { return false; }
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() noexcept {}
+    };
+    auto resume_on_io(ThreadPool & thread_pool) -> ResumeOnIoAwaiter;
+
+    // Suspends the coroutine until the task finished, the coroutine is then scheduled as a continuation of the task.
+    struct WaitForTaskAwaiter
+    {
+        ThreadPool * thread_pool = {};
+        std::shared_ptr<Task> task = {};
+        TaskPriority priority = {};
+        auto await_ready() noexcept -> bool { return task->finished; }
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() noexcept {}
+    };
+    auto wait_for(ThreadPool & thread_pool, std::shared_ptr<Task> task, TaskPriority priority = TaskPriority::LOW) -> WaitForTaskAwaiter;
+
+    /**
+     * NOTES:
+     * - Counted budget coroutines can wait on, used to limit the amount of staging memory in flight
+     * - acquire suspends the coroutine until the amount fits into the budget, release resumes waiters in FIFO order
+     * - A request bigger than the whole budget is granted once nothing else is acquired
+     * - A single acquire per user can not dead lock. Holding an acquired amount while waiting for a second acquire
+     *   can, once every user holds its first amount. Acquire everything needed at once
+     * THREADSAFETY:
+     * * internally synchronized
+     */
+    struct AsyncBudget
+    {
+        AsyncBudget(u64 capacity);
+        AsyncBudget(AsyncBudget const &) = delete;
+        AsyncBudget & operator=(AsyncBudget const &) = delete;
+
+        struct AcquireAwaiter
+        {
+            AsyncBudget * budget = {};
+            ThreadPool * thread_pool = {};
+            u64 amount = {};
+            TaskPriority priority = {};
+            auto await_ready() noexcept -> bool { return false; }
+            // Returns false (don't suspend) when the amount could be acquired right away.
+            auto await_suspend(std::coroutine_handle<> handle) -> bool;
+            void await_resume() noexcept {}
+        };
+        auto acquire(ThreadPool & thread_pool, u64 amount, TaskPriority priority = TaskPriority::LOW) -> AcquireAwaiter;
+        void release(u64 amount);
+        auto in_use() -> u64;
+        // Forgets the suspended waiters without resuming them. Used once the ThreadPool they would resume on is gone.
+        void abandon_waiters();
+
+      private:
+        struct Waiter
+        {
+            std::coroutine_handle<> handle = {};
+            ThreadPool * thread_pool = {};
+            u64 amount = {};
+            TaskPriority priority = {};
+        };
+        auto fits(u64 amount) const -> bool;
+
+        std::mutex mutex = {};
+        u64 capacity = {};
+        u64 used = {};
+        std::deque<Waiter> waiters = {};
+    };
+
+    // Starts the coroutine on a worker of the pool without waiting for it.
+    // The returned task finishes once the coroutine returned, it can be waited on with block_on or used as a dependency.
+    auto spawn(ThreadPool & thread_pool, task<void> coroutine, TaskPriority priority = TaskPriority::LOW) -> std::shared_ptr<Task>;
+
+    // Runs the task to completion, blocking the calling thread. Only meant for code that is not a coroutine itself.
+    template <typename T>
+    auto sync_wait(task<T> coroutine) -> T
+    {
+        std::binary_semaphore done{0};
+        std::exception_ptr exception = {};
+        if constexpr (std::is_void_v<T>)
+        {
+            auto run = [](task<T> coroutine, std::binary_semaphore & done, std::exception_ptr & exception) -> detail::DetachedCoroutine
+            {
+                try { co_await std::move(coroutine); }
+                catch (...) { exception = std::current_exception(); }
+                done.release();
+            };
+            run(std::move(coroutine), done, exception);
+            done.acquire();
+            if (exception) { std::rethrow_exception(exception); }
+        }
+        else
+        {
+            std::optional<T> result = {};
+            auto run = [](task<T> coroutine, std::optional<T> & result, std::binary_semaphore & done, std::exception_ptr & exception) -> detail::DetachedCoroutine
+            {
+                try { result.emplace(co_await std::move(coroutine)); }
+                catch (...) { exception = std::current_exception(); }
+                done.release();
+            };
+            run(std::move(coroutine), result, done, exception);
+            done.acquire();
+            if (exception) { std::rethrow_exception(exception); }
+            return std::move(result.value());
+        }
+    }
+} // namespace cinder
@@ -0,0 +1,246 @@
+#include "cpu_topology.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <optional>
+#include <string>
+#include <thread>
+#include <tuple>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif // NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#include <pthread.h>
+#include <filesystem>
+#include <fstream>
+#endif // defined(_WIN32)
+
+namespace
+{
+    // Topology as reported by the os, the keys only need to be unique, they are made dense afterwards.
+    struct RawCpu
+    {
+        u32 os_index = {};
+        u16 processor_group = {};
+        u64 core_key = {};
+        u64 cache_domain_key = {};
+        u32 numa_node = {};
+    };
+
+#if defined(_WIN32)
+    // Processors the process may run on per processor group, including the restrictions of its job object.
+    auto query_allowed_affinity() -> std::optional<std::map<u16, KAFFINITY>>
+    {
+        HANDLE const process = GetCurrentProcess();
+        USHORT group_count = 0;
+        GetProcessGroupAffinity(process, &group_count, nullptr);
+        if (group_count == 0) { return std::nullopt; }
+        std::vector<USHORT> groups(group_count);
+        if (!GetProcessGroupAffinity(process, &group_count, groups.data())) { return std::nullopt; }
+        std::map<u16, KAFFINITY> allowed = {};
+        /// NOTE: The affinity mask is only reported for processes in a single group. Processes spanning several groups
+        //        may run on every active processor of them.
+        DWORD_PTR process_mask = 0;
+        DWORD_PTR system_mask = 0;
+        if (group_count == 1 && GetProcessAffinityMask(process, &process_mask, &system_mask) && process_mask != 0)
+        {
+            allowed[groups[0]] = KAFFINITY(process_mask);
+            return allowed;
+        }
+        for (USHORT group_index = 0; group_index < group_count; ++group_index)
+        {
+            DWORD const processor_count = GetActiveProcessorCount(groups[group_index]);
+            allowed[groups[group_index]] = processor_count >= sizeof(KAFFINITY) * 8 ? ~KAFFINITY(0) : (KAFFINITY(1) << processor_count) - 1;
+        }
+        return allowed;
+    }
+
+    auto query_raw_cpus() -> std::vector<RawCpu>
+    {
+        std::optional<std::map<u16, KAFFINITY>> const allowed = query_allowed_affinity();
+        if (!allowed.has_value()) { return {}; }
+        DWORD buffer_size = 0;
+        GetLogicalProcessorInformationEx(RelationAll, nullptr, &buffer_size);
+        if (buffer_size == 0) { return {}; }
+        std::vector<std::byte> buffer(buffer_size);
+        auto * const first_info = r_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *>(buffer.data());
+        if (!GetLogicalProcessorInformationEx(RelationAll, first_info, &buffer_size)) { return {}; }
+
+        std::map<u64, RawCpu> cpus = {};
+        auto for_each_cpu = [&](GROUP_AFFINITY const & affinity, auto && fn)
+        {
+            for (u32 bit = 0; bit < sizeof(KAFFINITY) * 8; ++bit)
+            {
+                if ((affinity.Mask & (KAFFINITY(1) << bit)) == 0) { continue; }
+                RawCpu & cpu = cpus[(u64(affinity.Group) << 32ull) | bit];
+                cpu.os_index = bit;
+                cpu.processor_group = affinity.Group;
+                fn(cpu);
+            }
+        };
+        u64 core_key = 0;
+        u64 cache_domain_key = 0;
+        for (DWORD offset = 0; offset < buffer_size;)
+        {
+            auto const & info = *r_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX const *>(buffer.data() + offset);
+            if (info.Relationship == RelationProcessorCore)
+            {
+                for (WORD group = 0; group < info.Processor.GroupCount; ++group)
+                {
+                    for_each_cpu(info.Processor.GroupMask[group], [&](RawCpu & cpu)
+                        { cpu.core_key = core_key; });
+                }
+                core_key += 1;
+            }
+            else if (info.Relationship == RelationCache && info.Cache.Level == 3)
+            {
+                for_each_cpu(info.Cache.GroupMask, [&](RawCpu & cpu)
+                    { cpu.cache_domain_key = cache_domain_key; });
+                cache_domain_key += 1;
+            }
+            else if (info.Relationship == RelationNumaNode)
+            {
+                for_each_cpu(info.NumaNode.GroupMask, [&](RawCpu & cpu)
+                    { cpu.numa_node = info.NumaNode.NodeNumber; });
+            }
+            offset += info.Size;
+        }
+        std::vector<RawCpu> raw_cpus = {};
+        for (auto const & [key, cpu] : cpus)
+        {
+            auto const group_affinity = allowed->find(cpu.processor_group);
+            if (group_affinity == allowed->end() || (group_affinity->second & (KAFFINITY(1) << cpu.os_index)) == 0) { continue; }
+            raw_cpus.push_back(cpu);
+        }
+        return raw_cpus;
+    }
+#elif defined(__linux__)
+    auto read_u64(std::filesystem::path const & path) -> std::optional<u64>
+    {
+        std::ifstream file{path};
+        u64 value = {};
+        if (!(file >> value)) { return std::nullopt; }
+        return value;
+    }
+
+    auto query_raw_cpus() -> std::vector<RawCpu>
+    {
+        cpu_set_t allowed = {};
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) { return {}; }
+        std::filesystem::path const cpu_root = "/sys/devices/system/cpu";
+        std::vector<RawCpu> raw_cpus = {};
+        for (u32 os_index = 0; os_index < CPU_SETSIZE; ++os_index)
+        {
+            if (!CPU_ISSET(os_index, &allowed)) { continue; }
+            std::filesystem::path const cpu_path = cpu_root / fmt::format("cpu{}", os_index);
+            std::error_code error = {};
+            if (!std::filesystem::exists(cpu_path / "topology", error)) { return {}; }
+            RawCpu cpu = {.os_index = os_index};
+            u64 const package = read_u64(cpu_path / "topology/physical_package_id").value_or(0);
+            u64 const core = read_u64(cpu_path / "topology/core_id").value_or(os_index);
+            cpu.core_key = (package << 32ull) | core;
+            // The last level cache domain is keyed by the first cpu sharing it, cpus without an L3 share by package.
+            cpu.cache_domain_key = ~0ull - package;
+            for (auto const & entry : std::filesystem::directory_iterator(cpu_path / "cache", error))
+            {
+                if (read_u64(entry.path() / "level").value_or(0) != 3) { continue; }
+                if (auto first_sharing_cpu = read_u64(entry.path() / "shared_cpu_list"))
+                {
+                    cpu.cache_domain_key = first_sharing_cpu.value();
+                }
+            }
+            for (auto const & entry : std::filesystem::directory_iterator(cpu_path, error))
+            {
+                std::string const name = entry.path().filename().string();
+                if (name.starts_with("node") && name.size() > 4 && std::isdigit(s_cast<unsigned char>(name[4])))
+                {
+                    cpu.numa_node = s_cast<u32>(std::stoul(name.substr(4)));
+                }
+            }
+            raw_cpus.push_back(cpu);
+        }
+        return raw_cpus;
+    }
+#else
+    auto query_raw_cpus() -> std::vector<RawCpu> { return {}; }
+#endif // defined(_WIN32)
+} // namespace
+
+auto CpuTopology::detect() -> CpuTopology
+{
+    std::vector<RawCpu> raw_cpus = query_raw_cpus();
+    if (raw_cpus.empty())
+    {
+        u32 const logical_cpu_count = std::max(1u, std::thread::hardware_concurrency());
+        for (u32 cpu_index = 0; cpu_index < logical_cpu_count; ++cpu_index)
+        {
+            raw_cpus.push_back({.os_index = cpu_index, .core_key = cpu_index});
+        }
+    }
+    std::sort(raw_cpus.begin(), raw_cpus.end(), [](RawCpu const & lhs, RawCpu const & rhs)
+        {
+            return std::tie(lhs.numa_node, lhs.cache_domain_key, lhs.core_key, lhs.processor_group, lhs.os_index) <
+                   std::tie(rhs.numa_node, rhs.cache_domain_key, rhs.core_key, rhs.processor_group, rhs.os_index);
+        });
+
+    CpuTopology topology = {};
+    std::map<u32, u32> numa_node_indices = {};
+    std::map<std::pair<u32, u64>, u32> cache_domain_indices = {};
+    std::map<std::tuple<u32, u64, u64>, u32> core_indices = {};
+    for (RawCpu const & raw_cpu : raw_cpus)
+    {
+        u32 const numa_node_index = numa_node_indices.try_emplace(raw_cpu.numa_node, s_cast<u32>(numa_node_indices.size())).first->second;
+        u32 const cache_domain_index = cache_domain_indices.try_emplace(
+            {raw_cpu.numa_node, raw_cpu.cache_domain_key}, s_cast<u32>(cache_domain_indices.size())).first->second;
+        auto const [core_it, new_core] = core_indices.try_emplace(
+            {raw_cpu.numa_node, raw_cpu.cache_domain_key, raw_cpu.core_key}, s_cast<u32>(topology.cores.size()));
+        if (new_core)
+        {
+            topology.cores.push_back({.cache_domain_index = cache_domain_index, .numa_node_index = numa_node_index});
+        }
+        topology.cores.at(core_it->second).logical_cpus.push_back(s_cast<u32>(topology.logical_cpus.size()));
+        topology.logical_cpus.push_back({
+            .os_index = raw_cpu.os_index,
+            .processor_group = raw_cpu.processor_group,
+            .core_index = core_it->second,
+            .cache_domain_index = cache_domain_index,
+            .numa_node_index = numa_node_index,
+        });
+    }
+    topology.cache_domain_count = s_cast<u32>(cache_domain_indices.size());
+    topology.numa_node_count = s_cast<u32>(numa_node_indices.size());
+    return topology;
+}
+
+auto CpuTopology::has_smt() const -> bool
+{
+    return logical_cpus.size() > cores.size();
+}
+
+auto CpuTopology::to_string() const -> std::string
+{
+    return fmt::format("{} logical cpus, {} physical cores, {} cache domains, {} numa nodes",
+        logical_cpus.size(), cores.size(), cache_domain_count, numa_node_count);
+}
+
+auto pin_current_thread(LogicalCpu const & cpu) -> bool
+{
+#if defined(_WIN32)
+    GROUP_AFFINITY affinity = {};
+    affinity.Mask = KAFFINITY(1) << cpu.os_index;
+    affinity.Group = cpu.processor_group;
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+#elif defined(__linux__)
+    cpu_set_t cpu_set = {};
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu.os_index, &cpu_set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+#else
+    return false;
+#endif // defined(_WIN32)
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <optional>
+#include <string>
+
+#include "../cinder.hpp"
+using namespace cinder::types;
+
+struct LogicalCpu
+{
+    // Index the os uses for affinity masks. On windows this is the index inside of the processor group.
+    u32 os_index = {};
+    u16 processor_group = {};
+    // Dense indices into the core, cache domain and numa node lists of the topology.
+    u32 core_index = {};
+    u32 cache_domain_index = {};
+    u32 numa_node_index = {};
+};
+
+struct PhysicalCore
+{
+    // Indices into CpuTopology::logical_cpus, more than one when the core runs SMT siblings.
+    std::vector<u32> logical_cpus = {};
+    u32 cache_domain_index = {};
+    u32 numa_node_index = {};
+};
+
+/**
+ * DESCRIPTION:
+ * Logical processors of the machine grouped into physical cores, last level cache domains (L3 / CCX) and numa nodes.
+ * Only the processors the process is allowed to run on are listed.
+ * NOTES:
+ * - Falls back to one core per logical processor in a single cache domain when the platform query fails
+ * - Cores are sorted by numa node and cache domain, neighbouring cores share the cache where possible
+ */
+struct CpuTopology
+{
+    std::vector<LogicalCpu> logical_cpus = {};
+    std::vector<PhysicalCore> cores = {};
+    u32 cache_domain_count = {};
+    u32 numa_node_count = {};
+
+    static auto detect() -> CpuTopology;
+    auto has_smt() const -> bool;
+    auto to_string() const -> std::string;
+};
+
+// Restricts the calling thread to a single logical processor, returns false when the os refused.
+auto pin_current_thread(LogicalCpu const & cpu) -> bool;
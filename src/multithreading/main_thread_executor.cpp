@@ -0,0 +1,44 @@
+#include "main_thread_executor.hpp"
+
+void MainThreadExecutor::post(std::function<void()> task)
+{
+    std::lock_guard lock{mutex};
+    tasks.push_back(std::move(task));
+}
+
+auto MainThreadExecutor::pop_task() -> std::optional<std::function<void()>>
+{
+    std::lock_guard lock{mutex};
+    if (tasks.empty()) { return std::nullopt; }
+    std::function<void()> task = std::move(tasks.front());
+    tasks.pop_front();
+    return task;
+}
+
+auto MainThreadExecutor::drain(std::chrono::nanoseconds budget) -> MainThreadDrainResult
+{
+    MainThreadDrainResult result = {};
+    auto const start = std::chrono::steady_clock::now();
+    do
+    {
+        std::optional<std::function<void()>> task = pop_task();
+        if (!task.has_value()) { break; }
+        // The lock is not held while running, tasks are free to post follow ups of their own.
+        (*task)();
+        result.executed_tasks += 1;
+        result.elapsed = std::chrono::steady_clock::now() - start;
+    } while (result.elapsed < budget);
+    result.remaining_tasks = pending_tasks();
+    return result;
+}
+
+auto MainThreadExecutor::drain_all() -> MainThreadDrainResult
+{
+    return drain(std::chrono::nanoseconds::max());
+}
+
+auto MainThreadExecutor::pending_tasks() -> usize
+{
+    std::lock_guard lock{mutex};
+    return tasks.size();
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+
+#include "../cinder.hpp"
+using namespace cinder::types;
+
+struct MainThreadDrainResult
+{
+    // Tasks run by this drain and tasks still queued once it stopped.
+    u32 executed_tasks = {};
+    usize remaining_tasks = {};
+    std::chrono::nanoseconds elapsed = {};
+};
+
+/**
+ * DESCRIPTION:
+ * Queue of follow ups that have to run on the thread owning the gpu device (command recording, submission, resource creation).
+ * Workers post to it, the owning thread drains it once a frame up to a time budget. Whatever does not fit into the
+ * budget waits for the next frame, so a burst of finished work is spread over several frames instead of spiking one.
+ * NOTES:
+ * - Tasks run in the order they were posted, the budget is only checked between tasks, a task is never interrupted
+ * - Every drain runs at least one task, the queue always makes progress no matter how small the budget is
+ * - Tasks posted while draining run in the same drain if the budget allows it
+ * THREADSAFETY:
+ * * post and pending_tasks are internally synchronized, drain and drain_all must only be called by the owning thread
+ */
+struct MainThreadExecutor
+{
+    MainThreadExecutor() = default;
+    MainThreadExecutor(MainThreadExecutor const &) = delete;
+    MainThreadExecutor & operator=(MainThreadExecutor const &) = delete;
+
+    void post(std::function<void()> task);
+    auto drain(std::chrono::nanoseconds budget) -> MainThreadDrainResult;
+    // Runs every queued task, including the ones posted while draining. Used when shutting down.
+    auto drain_all() -> MainThreadDrainResult;
+    auto pending_tasks() -> usize;
+
+  private:
+    auto pop_task() -> std::optional<std::function<void()>>;
+
+    std::mutex mutex = {};
+    std::deque<std::function<void()>> tasks = {};
+};
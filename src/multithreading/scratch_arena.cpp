@@ -0,0 +1,92 @@
+#include "scratch_arena.hpp"
+
+#include <algorithm>
+
+ScratchArena::ScratchArena(usize first_block_size)
+    : first_block_size{std::max(first_block_size, usize(64))}
+{
+}
+
+void ScratchArena::add_block(usize min_size)
+{
+    usize const previous_size = blocks.empty() ? first_block_size / 2 : blocks.back().size;
+    usize const size = std::max(min_size, previous_size * 2);
+    blocks.push_back({std::make_unique_for_overwrite<std::byte[]>(size), size});
+    heap_allocation_count += 1;
+}
+
+auto ScratchArena::allocate(usize size, usize alignment) -> std::byte *
+{
+    DBG_ASSERT_TRUE_M(alignment != 0 && (alignment & (alignment - 1)) == 0, "[ScratchArena::allocate()] Alignment must be a power of two");
+    // Blocks after the current one are left over from before the last rewind, they are reused before adding new ones.
+    while (true)
+    {
+        if (current_block < blocks.size())
+        {
+            Block & block = blocks[current_block];
+            usize const address = r_cast<usize>(block.memory.get()) + offset;
+            usize const aligned_offset = offset + ((alignment - address % alignment) % alignment);
+            if (aligned_offset + size <= block.size)
+            {
+                offset = aligned_offset + size;
+                return block.memory.get() + aligned_offset;
+            }
+            if (current_block + 1 < blocks.size())
+            {
+                current_block += 1;
+                offset = 0;
+                continue;
+            }
+        }
+        // Enough slack for the alignment, new blocks are only aligned to max_align_t.
+        add_block(size + alignment);
+        current_block = s_cast<u32>(blocks.size() - 1);
+        offset = 0;
+    }
+}
+
+auto ScratchArena::mark() const -> Marker
+{
+    return {current_block, offset};
+}
+
+void ScratchArena::rewind(Marker marker)
+{
+    current_block = marker.block_index;
+    offset = marker.offset;
+    /// NOTE: Rewound to empty with a chain of blocks, merge them so the next run of the same size fits into one block.
+    if (current_block == 0 && offset == 0 && blocks.size() > 1)
+    {
+        usize total_size = 0;
+        for (Block const & block : blocks) { total_size += block.size; }
+        blocks.clear();
+        add_block(total_size);
+    }
+}
+
+void ScratchArena::reset()
+{
+    rewind({});
+}
+
+auto ScratchArena::bytes_in_use() const -> usize
+{
+    usize bytes = offset;
+    for (u32 block_index = 0; block_index < current_block && block_index < blocks.size(); ++block_index)
+    {
+        bytes += blocks[block_index].size;
+    }
+    return bytes;
+}
+
+auto ScratchArena::capacity() const -> usize
+{
+    usize bytes = 0;
+    for (Block const & block : blocks) { bytes += block.size; }
+    return bytes;
+}
+
+auto ScratchArena::heap_allocations() const -> u64
+{
+    return heap_allocation_count;
+}
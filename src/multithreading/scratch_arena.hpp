@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "../cinder.hpp"
+using namespace cinder::types;
+
+/**
+ * DESCRIPTION:
+ * Bump allocator for short lived temporaries of a single thread.
+ * Every worker of the ThreadPool owns one, other threads get a thread local one (see ThreadPool::current_scratch_arena).
+ * The arena is rewound after every chunk the thread runs, temporaries of a chunk never reach the heap.
+ * NOTES:
+ * - Allocations are not freed one by one, memory is reclaimed by rewinding to a marker (Scope) or by reset
+ * - Grows by chaining blocks. Once rewound to empty the chain is replaced by a single block big enough for all of them,
+ *   after the first few chunks a thread runs without touching the heap
+ * - Only for trivially destructible types, nothing is ever destroyed
+ * - Memory must not be kept across a co_await, the coroutine may continue on another thread and the chunk it ran in
+ *   rewinds the arena once it suspends
+ * THREADSAFETY:
+ * * not synchronized, only used by the owning thread
+ */
+struct ScratchArena
+{
+    struct Marker
+    {
+        u32 block_index = {};
+        usize offset = {};
+    };
+    // Rewinds the arena to where it was on construction.
+    struct Scope
+    {
+        Scope(ScratchArena & arena) : arena{arena}, marker{arena.mark()} {}
+        Scope(Scope const &) = delete;
+        Scope & operator=(Scope const &) = delete;
+        ~Scope() { arena.rewind(marker); }
+
+        ScratchArena & arena;
+        Marker marker = {};
+    };
+
+    ScratchArena(usize first_block_size = DEFAULT_BLOCK_SIZE);
+    ScratchArena(ScratchArena const &) = delete;
+    ScratchArena & operator=(ScratchArena const &) = delete;
+
+    auto allocate(usize size, usize alignment) -> std::byte *;
+    // Uninitialized, the elements have to be written before they are read.
+    template <typename T>
+    auto allocate_array(usize count) -> std::span<T>
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "Scratch memory is never destroyed");
+        return {r_cast<T *>(allocate(sizeof(T) * count, alignof(T))), count};
+    }
+    auto mark() const -> Marker;
+    void rewind(Marker marker);
+    void reset();
+
+    auto bytes_in_use() const -> usize;
+    auto capacity() const -> usize;
+    // Blocks taken from the heap since the arena was created.
+    auto heap_allocations() const -> u64;
+
+    static constexpr usize DEFAULT_BLOCK_SIZE = 1ull << 20ull;
+
+  private:
+    struct Block
+    {
+        std::unique_ptr<std::byte[]> memory = {};
+        usize size = {};
+    };
+    void add_block(usize min_size);
+
+    std::vector<Block> blocks = {};
+    usize first_block_size = {};
+    u32 current_block = {};
+    usize offset = {};
+    u64 heap_allocation_count = {};
+};
@@ -1,125 +1,765 @@
 #include "thread_pool.hpp"
 using namespace cinder::types;
 
+// Lets a thread find out whether it is a worker of a given pool and which queue it owns.
+static thread_local void const * tl_owning_pool = nullptr;
+static thread_local u32 tl_worker_index = EXTERNAL_THREAD_INDEX;
+// Io threads own no queue, they act like external threads with their own counters.
+static thread_local bool tl_io_thread = false;
+// Chunks running on this thread, more than one when a chunk waits on other work and helps in the meantime.
+// Only the outermost chunk counts as busy time, waiting inside of a chunk is busy time too.
+static thread_local u32 tl_chunk_depth = 0;
+// Arena of the worker running on this thread, threads that are not workers use their own thread local one.
+static thread_local ScratchArena * tl_scratch_arena = nullptr;
+
+static auto steady_time_ns(std::chrono::steady_clock::time_point time_point) -> u64
+{
+    return s_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(time_point.time_since_epoch()).count());
+}
+
+static auto elapsed_ns(std::chrono::steady_clock::time_point start) -> u64
+{
+    return s_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
 ThreadPool::~ThreadPool()
 {
+    if (!shared_data) { return; }
     {
-        std::unique_lock lock{shared_data->threadpool_mutex};
+        std::unique_lock lock{shared_data->sleep_mutex};
         shared_data->kill = true;
         shared_data->work_available.notify_all();
     }
+    {
+        std::lock_guard lock{shared_data->io_mutex};
+        shared_data->io_work_available.notify_all();
+    }
+    // Io threads push into the injection queue, they have to be gone before the queues are collected below.
+    for (auto & io_thread : io_threads)
+    {
+        io_thread.join();
+    }
     for (auto & worker : worker_threads)
     {
         worker.join();
     }
+    // Queued chunks only point at their task, drop the dispatch references of the tasks that never finished.
+    std::vector<Task *> unfinished_tasks = {};
+    auto collect = [&](WorkerQueue & queue)
+    {
+        for (auto & chunks : queue.chunks)
+        {
+            for (TaskChunk const & chunk : chunks) { unfinished_tasks.push_back(chunk.task); }
+        }
+    };
+    collect(shared_data->injection_queue);
+    for (auto & queue : shared_data->worker_queues) { collect(*queue); }
+    for (TaskChunk const & chunk : shared_data->io_chunks) { unfinished_tasks.push_back(chunk.task); }
+    for (auto & deadline_chunks : shared_data->deadline_chunks)
+    {
+        for (DeadlineChunk const & deadline_chunk : deadline_chunks) { unfinished_tasks.push_back(deadline_chunk.chunk.task); }
+    }
+    std::sort(unfinished_tasks.begin(), unfinished_tasks.end());
+    unfinished_tasks.erase(std::unique(unfinished_tasks.begin(), unfinished_tasks.end()), unfinished_tasks.end());
+    for (Task * task : unfinished_tasks)
+    {
+        if (task->pooled) { s_cast<PooledTask *>(task)->destroy(s_cast<PooledTask *>(task)->capture.data()); }
+        else { task->dispatch_reference.reset(); }
+    }
 }
 
-void ThreadPool::worker(std::shared_ptr<ThreadPool::SharedData> shared_data, u32 thread_index)
+auto ThreadPool::current_thread_index(SharedData const & shared_data) -> u32
 {
-    std::unique_lock lock{shared_data->threadpool_mutex};
-    while (true)
+    return tl_owning_pool == &shared_data ? tl_worker_index : EXTERNAL_THREAD_INDEX;
+}
+
+auto ThreadPool::thread_counters(SharedData & shared_data, u32 thread_index) -> ThreadCounters &
+{
+    if (thread_index != EXTERNAL_THREAD_INDEX) { return *shared_data.worker_counters[thread_index]; }
+    return tl_io_thread && tl_owning_pool == &shared_data ? shared_data.io_counters : shared_data.external_counters;
+}
+
+static void atomic_max(std::atomic_uint64_t & target, u64 value)
+{
+    u64 current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+auto ThreadPool::lock_counted(std::mutex & mutex, ThreadCounters & counters) -> std::unique_lock<std::mutex>
+{
+    // Only contended locks are timed, an uncontended lock costs a single try_lock.
+    std::unique_lock lock{mutex, std::try_to_lock};
+    if (!lock.owns_lock())
+    {
+        auto const start = std::chrono::steady_clock::now();
+        lock.lock();
+        counters.lock_wait_ns.fetch_add(elapsed_ns(start), std::memory_order_relaxed);
+    }
+    return lock;
+}
+
+void ThreadPool::push_chunks(SharedData & shared_data, Task & task, u32 first_chunk, u32 end_chunk, TaskPriority priority)
+{
+    if (first_chunk >= end_chunk) { return; }
+    u32 const priority_index = s_cast<u32>(priority);
+    u32 const thread_index = current_thread_index(shared_data);
+    ThreadCounters & counters = thread_counters(shared_data, thread_index);
+    u64 const now_ns = steady_time_ns(std::chrono::steady_clock::now());
+    PriorityLevel & level = shared_data.levels[priority_index];
+    // Announce the chunks before they are visible so that a popper can never decrement below zero.
+    // A level that was empty starts aging from now, not from the last time it was served.
+    u64 const previously_queued = level.queued_chunks.fetch_add(end_chunk - first_chunk);
+    if (previously_queued == 0) { level.last_served_ns = now_ns; }
+    atomic_max(level.peak_queued_chunks, previously_queued + end_chunk - first_chunk);
+    if (task.deadline.has_value())
+    {
+        u64 const deadline_ns = steady_time_ns(task.deadline.value());
+        level.queued_deadline_chunks += end_chunk - first_chunk;
+        auto lock = lock_counted(shared_data.deadline_mutex, counters);
+        auto & deadline_chunks = shared_data.deadline_chunks[priority_index];
+        for (u32 chunk_index = first_chunk; chunk_index < end_chunk; chunk_index++)
+        {
+            deadline_chunks.push_back({deadline_ns, {&task, chunk_index, now_ns}});
+            std::push_heap(deadline_chunks.begin(), deadline_chunks.end(), [](DeadlineChunk const & lhs, DeadlineChunk const & rhs)
+                { return lhs.deadline_ns > rhs.deadline_ns; });
+        }
+    }
+    else
     {
-        shared_data->work_available.wait(
-            lock, [&]
-            { return !shared_data->high_priority_tasks.empty() || !shared_data->low_priority_tasks.empty() || shared_data->kill; });
-        if (shared_data->kill)
+        WorkerQueue & queue = thread_index != EXTERNAL_THREAD_INDEX ? *shared_data.worker_queues[thread_index] : shared_data.injection_queue;
+        auto lock = lock_counted(queue.mutex, counters);
+        for (u32 chunk_index = first_chunk; chunk_index < end_chunk; chunk_index++)
         {
-            return;
+            queue.chunks[priority_index].push_back({&task, chunk_index, now_ns});
         }
+    }
+    // Only take the sleep lock when someone is actually asleep. Both sides use seq_cst so either the sleeper sees
+    // the queued chunks or we see the sleeper.
+    if (shared_data.sleeping_threads.load() > 0)
+    {
+        std::lock_guard lock{shared_data.sleep_mutex};
+        // A blocked thread may ignore work below its priority and swallow a notify_one meant for a worker.
+        bool const wake_all = end_chunk - first_chunk > 1 || shared_data.blocked_threads.load() > 0;
+        if (wake_all) { shared_data.work_available.notify_all(); }
+        else { shared_data.work_available.notify_one(); }
+    }
+}
 
-        bool const high_priority_work_available = !shared_data->high_priority_tasks.empty();
-        auto & selected_queue = high_priority_work_available ? shared_data->high_priority_tasks : shared_data->low_priority_tasks;
-        TaskChunk current_chunk = std::move(selected_queue.front());
-        selected_queue.pop_front();
-        current_chunk.task->started += 1;
-        lock.unlock();
+auto ThreadPool::has_queued_work(SharedData const & shared_data, TaskPriority min_priority) -> bool
+{
+    for (u32 priority_index = s_cast<u32>(min_priority); priority_index < TASK_PRIORITY_COUNT; ++priority_index)
+    {
+        if (shared_data.levels[priority_index].queued_chunks.load() != 0) { return true; }
+    }
+    return false;
+}
 
-        current_chunk.task->callback(current_chunk.chunk_index, thread_index);
+void ThreadPool::record_chunk_start(SharedData & shared_data, u32 thread_index, u32 priority_index, TaskChunk const & chunk, u64 now_ns)
+{
+    u64 const wait_ns = now_ns > chunk.enqueue_time_ns ? now_ns - chunk.enqueue_time_ns : 0;
+    shared_data.levels[priority_index].last_served_ns.store(now_ns, std::memory_order_relaxed);
+    ThreadCounters & counters = thread_counters(shared_data, thread_index);
+    counters.started_chunks[priority_index].fetch_add(1, std::memory_order_relaxed);
+    counters.total_wait_ns[priority_index].fetch_add(wait_ns, std::memory_order_relaxed);
+    atomic_max(counters.max_wait_ns[priority_index], wait_ns);
+}
 
-        lock.lock();
-        current_chunk.task->not_finished -= 1;
-        // Working on last chunk of a task, notify in case there is a thread waiting for this task to be done
-        if (current_chunk.task->not_finished == 0) { shared_data->work_done.notify_all(); }
+auto ThreadPool::take_chunk(SharedData & shared_data, u32 thread_index, u32 priority_index, u64 now_ns) -> std::optional<TaskChunk>
+{
+    PriorityLevel & level = shared_data.levels[priority_index];
+    if (level.queued_chunks.load() == 0) { return std::nullopt; }
+    ThreadCounters & counters = thread_counters(shared_data, thread_index);
+    auto try_take = [&](WorkerQueue & queue, bool from_back) -> std::optional<TaskChunk>
+    {
+        auto lock = lock_counted(queue.mutex, counters);
+        auto & chunks = queue.chunks[priority_index];
+        if (chunks.empty()) { return std::nullopt; }
+        TaskChunk chunk = from_back ? std::move(chunks.back()) : std::move(chunks.front());
+        if (from_back) { chunks.pop_back(); }
+        else { chunks.pop_front(); }
+        level.queued_chunks -= 1;
+        return chunk;
+    };
+    // 1) Work with a deadline, earliest first.
+    if (level.queued_deadline_chunks.load() != 0)
+    {
+        auto lock = lock_counted(shared_data.deadline_mutex, counters);
+        auto & deadline_chunks = shared_data.deadline_chunks[priority_index];
+        if (!deadline_chunks.empty())
+        {
+            std::pop_heap(deadline_chunks.begin(), deadline_chunks.end(), [](DeadlineChunk const & lhs, DeadlineChunk const & rhs)
+                { return lhs.deadline_ns > rhs.deadline_ns; });
+            TaskChunk const chunk = deadline_chunks.back().chunk;
+            deadline_chunks.pop_back();
+            level.queued_deadline_chunks -= 1;
+            level.queued_chunks -= 1;
+            record_chunk_start(shared_data, thread_index, priority_index, chunk, now_ns);
+            return chunk;
+        }
     }
+    std::optional<TaskChunk> chunk = std::nullopt;
+    // 2) Own queue, newest first.
+    if (thread_index != EXTERNAL_THREAD_INDEX) { chunk = try_take(*shared_data.worker_queues[thread_index], true); }
+    // 3) Work submitted from outside of the pool.
+    if (!chunk.has_value()) { chunk = try_take(shared_data.injection_queue, false); }
+    // 4) Steal the oldest chunk from the other workers, closest cache first.
+    if (thread_index != EXTERNAL_THREAD_INDEX)
+    {
+        for (u32 const victim : shared_data.steal_orders[thread_index])
+        {
+            if (chunk.has_value()) { break; }
+            chunk = try_take(*shared_data.worker_queues[victim], false);
+            if (chunk.has_value()) { counters.stolen_chunks.fetch_add(1, std::memory_order_relaxed); }
+        }
+    }
+    else
+    {
+        for (u32 victim = 0; victim < shared_data.worker_queues.size() && !chunk.has_value(); ++victim)
+        {
+            chunk = try_take(*shared_data.worker_queues[victim], false);
+        }
+    }
+    if (chunk.has_value()) { record_chunk_start(shared_data, thread_index, priority_index, chunk.value(), now_ns); }
+    return chunk;
 }
 
-ThreadPool::ThreadPool(std::optional<u32> thread_count)
+auto ThreadPool::pop_chunk(SharedData & shared_data, u32 thread_index, TaskPriority min_priority) -> std::optional<TaskChunk>
 {
-    u32 const real_thread_count = thread_count.value_or(std::thread::hardware_concurrency());
-    shared_data = std::make_shared<SharedData>();
-    for (u32 thread_index = 0; thread_index < real_thread_count; thread_index++)
+    u64 const now_ns = steady_time_ns(std::chrono::steady_clock::now());
+    u64 const aging_interval_ns = s_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(PRIORITY_AGING_INTERVAL).count());
+    // Aging, the level starving the longest is served first. The highest level can not starve.
+    i32 aged_priority_index = -1;
+    u64 oldest_served_ns = std::numeric_limits<u64>::max();
+    for (i32 priority_index = s_cast<i32>(min_priority); priority_index < s_cast<i32>(TASK_PRIORITY_COUNT) - 1; ++priority_index)
     {
-        worker_threads.push_back({
-            std::thread([=, this]()
-                { ThreadPool::worker(shared_data, thread_index); }),
-        });
+        PriorityLevel const & level = shared_data.levels[priority_index];
+        if (level.queued_chunks.load(std::memory_order_relaxed) == 0) { continue; }
+        u64 const last_served_ns = level.last_served_ns.load(std::memory_order_relaxed);
+        if (last_served_ns + aging_interval_ns < now_ns && last_served_ns < oldest_served_ns)
+        {
+            aged_priority_index = priority_index;
+            oldest_served_ns = last_served_ns;
+        }
+    }
+    if (aged_priority_index != -1)
+    {
+        if (auto chunk = take_chunk(shared_data, thread_index, s_cast<u32>(aged_priority_index), now_ns))
+        {
+            thread_counters(shared_data, thread_index).aged_chunks[aged_priority_index].fetch_add(1, std::memory_order_relaxed);
+            return chunk;
+        }
+    }
+    for (i32 priority_index = TASK_PRIORITY_COUNT - 1; priority_index >= s_cast<i32>(min_priority); --priority_index)
+    {
+        if (auto chunk = take_chunk(shared_data, thread_index, s_cast<u32>(priority_index), now_ns)) { return chunk; }
     }
+    return std::nullopt;
 }
 
-void ThreadPool::blocking_dispatch(std::shared_ptr<Task> task, TaskPriority priority)
+auto ThreadPool::reclaim_chunk(SharedData & shared_data, Task const * task, TaskPriority priority) -> std::optional<TaskChunk>
 {
-    // Don't need mutex here as no thread is working on this task yet
-    task->not_finished = task->chunk_count;
-    auto & selected_queue = priority == TaskPriority::HIGH ? shared_data->high_priority_tasks : shared_data->low_priority_tasks;
+    u32 const priority_index = s_cast<u32>(priority);
+    u32 const thread_index = current_thread_index(shared_data);
+    WorkerQueue & queue = thread_index != EXTERNAL_THREAD_INDEX ? *shared_data.worker_queues[thread_index] : shared_data.injection_queue;
+    auto lock = lock_counted(queue.mutex, thread_counters(shared_data, thread_index));
+    auto & chunks = queue.chunks[priority_index];
+    // Chunks of the dispatched task were pushed last, if the back no longer belongs to it they were all taken.
+    if (chunks.empty() || chunks.back().task != task) { return std::nullopt; }
+    TaskChunk chunk = std::move(chunks.back());
+    chunks.pop_back();
+    shared_data.levels[priority_index].queued_chunks -= 1;
+    record_chunk_start(shared_data, thread_index, priority_index, chunk, steady_time_ns(std::chrono::steady_clock::now()));
+    return chunk;
+}
 
-    // chunk_index 0 will be worked on by this thread
-    std::unique_lock lock{shared_data->threadpool_mutex};
+void ThreadPool::prepare_dispatch(Task & task)
+{
+    task.not_finished = task.chunk_count;
+    task.started = 0;
+    // Continuations registered before the dispatch are kept, they wait for this run of the task.
+    std::lock_guard lock{task.continuation_mutex};
+    task.finished = false;
+}
+
+void ThreadPool::schedule(SharedData & shared_data, Task & task, TaskPriority priority)
+{
+    // Tasks without chunks (joins) have nothing to run, they finish as soon as they are ready.
+    if (task.chunk_count == 0) { finish_task(shared_data, task); }
+    else { push_chunks(shared_data, task, 0, task.chunk_count, priority); }
+}
 
-    for (u32 chunk_index = 1; chunk_index < task->chunk_count; chunk_index++)
+auto ThreadPool::acquire_pooled_task(SharedData & shared_data) -> PooledTask &
+{
+    std::lock_guard lock{shared_data.task_pool_mutex};
+    if (shared_data.free_pooled_tasks.empty())
     {
-        selected_queue.push_back({task, chunk_index});
+        PooledTask & task = shared_data.task_pool.emplace_back();
+        task.pooled = true;
+        return task;
     }
+    PooledTask * task = shared_data.free_pooled_tasks.back();
+    shared_data.free_pooled_tasks.pop_back();
+    return *task;
+}
 
-    shared_data->work_available.notify_all();
-    // Contribute to finishing this task from this thread
-    u32 current_chunk_index = 0;
-    bool worked_on_last_chunk = false;
-    while (current_chunk_index != NO_MORE_CHUNKS_CODE)
+void ThreadPool::release_pooled_task(SharedData & shared_data, PooledTask & task)
+{
+    task.destroy(task.capture.data());
+    std::lock_guard lock{shared_data.task_pool_mutex};
+    shared_data.free_pooled_tasks.push_back(&task);
+}
+
+void ThreadPool::finish_task(SharedData & shared_data, Task & task)
+{
+    /// NOTE: The owner may destroy the task as soon as it is marked finished (see block_on). Everything needed
+    //        afterwards is taken out of the task and it is not touched after the continuation lock is released.
+    if (task.pooled)
     {
-        task->started += 1;
+        // Pooled tasks are only referenced by the pool, nobody can wait on them or depend on them.
+        task.finished = true;
+        release_pooled_task(shared_data, s_cast<PooledTask &>(task));
+        return;
+    }
+    std::shared_ptr<Task> dispatch_reference = std::move(task.dispatch_reference);
+    std::vector<Task::Continuation> continuations = {};
+    {
+        std::lock_guard lock{task.continuation_mutex};
+        task.finished = true;
+        continuations = std::move(task.continuations);
+        task.continuations.clear();
+    }
+    // Continuations are pushed into the queue of the thread finishing the task, their inputs are still hot in its cache.
+    for (Task::Continuation & continuation : continuations)
+    {
+        if (continuation.task->unfinished_dependencies.fetch_sub(1) == 1)
+        {
+            schedule(shared_data, *continuation.task, continuation.priority);
+        }
+    }
+    // Wake threads blocked on a task, they sleep on work_available too. Same pattern as in push_chunks, either the
+    // waiter sees finished or we see the waiter.
+    if (shared_data.blocked_threads.load() > 0)
+    {
+        std::lock_guard lock{shared_data.sleep_mutex};
+        shared_data.work_available.notify_all();
+    }
+}
+
+auto ThreadPool::current_scratch_arena() -> ScratchArena &
+{
+    if (tl_scratch_arena != nullptr) { return *tl_scratch_arena; }
+    static thread_local ScratchArena external_scratch_arena = {};
+    return external_scratch_arena;
+}
+
+auto ThreadPool::scratch_arena(u32 thread_index) -> ScratchArena &
+{
+    return thread_index != EXTERNAL_THREAD_INDEX ? *shared_data->worker_scratch_arenas.at(thread_index) : current_scratch_arena();
+}
+
+void ThreadPool::execute_chunk(SharedData & shared_data, TaskChunk & chunk, u32 thread_index)
+{
+    ThreadCounters & counters = thread_counters(shared_data, thread_index);
+    // Rewinding to the marker instead of resetting keeps the scratch memory of outer chunks this thread is helping from.
+    ScratchArena::Scope const scratch_scope{current_scratch_arena()};
+    auto const start = tl_chunk_depth == 0 ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+    tl_chunk_depth += 1;
+    chunk.task->started += 1;
+    if (!chunk.task->cancellation.is_cancelled()) { chunk.task->callback(chunk.chunk_index, thread_index); }
+    // Working on last chunk of a task
+    if (chunk.task->not_finished.fetch_sub(1) == 1)
+    {
+        finish_task(shared_data, *chunk.task);
+    }
+    tl_chunk_depth -= 1;
+    counters.executed_chunks.fetch_add(1, std::memory_order_relaxed);
+    if (tl_chunk_depth == 0)
+    {
+        counters.busy_ns.fetch_add(elapsed_ns(start), std::memory_order_relaxed);
+    }
+}
+
+void ThreadPool::worker(std::shared_ptr<ThreadPool::SharedData> shared_data, u32 thread_index, std::optional<LogicalCpu> pinned_cpu)
+{
+    if (pinned_cpu.has_value() && !pin_current_thread(pinned_cpu.value()))
+    {
+        DEBUG_MESSAGE(fmt::format("[WARN][ThreadPool::worker()] Failed to pin worker {} to cpu {}", thread_index, pinned_cpu->os_index));
+    }
+    tl_owning_pool = shared_data.get();
+    tl_worker_index = thread_index;
+    tl_scratch_arena = shared_data->worker_scratch_arenas[thread_index].get();
+    while (!shared_data->kill)
+    {
+        if (auto chunk = pop_chunk(*shared_data, thread_index, TaskPriority::LOW))
+        {
+            execute_chunk(*shared_data, chunk.value(), thread_index);
+            continue;
+        }
+
+        auto const idle_start = std::chrono::steady_clock::now();
+        std::unique_lock lock{shared_data->sleep_mutex};
+        shared_data->sleeping_threads += 1;
+        shared_data->work_available.wait(lock, [&]
+            { return has_queued_work(*shared_data, TaskPriority::LOW) || shared_data->kill; });
+        shared_data->sleeping_threads -= 1;
+        shared_data->worker_counters[thread_index]->idle_ns.fetch_add(elapsed_ns(idle_start), std::memory_order_relaxed);
+    }
+}
 
+void ThreadPool::push_io_chunk(SharedData & shared_data, Task & task)
+{
+    {
+        std::lock_guard lock{shared_data.io_mutex};
+        shared_data.io_chunks.push_back({&task, 0, steady_time_ns(std::chrono::steady_clock::now())});
+    }
+    shared_data.io_work_available.notify_one();
+}
+
+void ThreadPool::io_worker(std::shared_ptr<ThreadPool::SharedData> shared_data)
+{
+    /// NOTE: Not a worker, work dispatched from here lands in the injection queue where any worker can take it.
+    tl_owning_pool = shared_data.get();
+    tl_io_thread = true;
+    while (true)
+    {
+        auto const idle_start = std::chrono::steady_clock::now();
+        std::unique_lock lock{shared_data->io_mutex};
+        shared_data->io_work_available.wait(lock, [&]
+            { return !shared_data->io_chunks.empty() || shared_data->kill; });
+        shared_data->io_counters.idle_ns.fetch_add(elapsed_ns(idle_start), std::memory_order_relaxed);
+        if (shared_data->kill) { break; }
+        TaskChunk chunk = shared_data->io_chunks.front();
+        shared_data->io_chunks.pop_front();
         lock.unlock();
-        task->callback(current_chunk_index, EXTERNAL_THREAD_INDEX);
-        lock.lock();
+        execute_chunk(*shared_data, chunk, EXTERNAL_THREAD_INDEX);
+    }
+}
 
-        task->not_finished -= 1;
-        bool more_chunks_in_queue = (task->started != task->chunk_count);
-        if (more_chunks_in_queue)
+// Logical cpus in the order workers are placed on them. First one per free core, then their SMT siblings,
+// the reserved cores only come last for pools bigger than the free part of the machine.
+static auto worker_placement_order(CpuTopology const & topology, u32 reserved_cores) -> std::vector<u32>
+{
+    std::vector<u32> order = {};
+    usize max_smt_width = 0;
+    for (PhysicalCore const & core : topology.cores) { max_smt_width = std::max(max_smt_width, core.logical_cpus.size()); }
+    auto append_cores = [&](usize first_core, usize end_core)
+    {
+        for (usize smt_index = 0; smt_index < max_smt_width; ++smt_index)
         {
-            current_chunk_index = selected_queue.front().chunk_index;
-            selected_queue.pop_front();
+            for (usize core_index = first_core; core_index < end_core; ++core_index)
+            {
+                auto const & logical_cpus = topology.cores[core_index].logical_cpus;
+                if (smt_index < logical_cpus.size()) { order.push_back(logical_cpus[smt_index]); }
+            }
         }
-        else { current_chunk_index = NO_MORE_CHUNKS_CODE; }
+    };
+    append_cores(reserved_cores, topology.cores.size());
+    append_cores(0, reserved_cores);
+    return order;
+}
 
-        worked_on_last_chunk = (task->not_finished == 0);
+ThreadPool::ThreadPool(u32 thread_count)
+    : ThreadPool(ThreadPoolInfo{.thread_count = thread_count, .reserved_cores = 0})
+{
+}
+
+ThreadPool::ThreadPool(ThreadPoolInfo info)
+{
+    cpu_topology = info.topology.has_value() ? std::move(info.topology.value()) : CpuTopology::detect();
+    u32 const core_count = std::max(1u, s_cast<u32>(cpu_topology.cores.size()));
+    u32 const reserved_cores = std::min(info.reserved_cores, core_count - 1);
+    std::vector<u32> const placement_order = worker_placement_order(cpu_topology, reserved_cores);
+    u32 default_thread_count = core_count - reserved_cores;
+    if (info.use_smt)
+    {
+        default_thread_count = 0;
+        for (u32 core_index = reserved_cores; core_index < cpu_topology.cores.size(); ++core_index)
+        {
+            default_thread_count += s_cast<u32>(cpu_topology.cores[core_index].logical_cpus.size());
+        }
     }
+    u32 const real_thread_count = std::max(1u, info.thread_count.value_or(default_thread_count));
 
-    if (!worked_on_last_chunk)
+    shared_data = std::make_shared<SharedData>();
+    for (u32 thread_index = 0; thread_index < real_thread_count; thread_index++)
     {
-        // This thread was not the last one working on this task, therefore we wait here to be notified once
-        // the last worker thread processing this task is done
-        shared_data->work_done.wait(lock, [&]
-            { return task->not_finished == 0; });
+        shared_data->worker_queues.push_back(std::make_unique<WorkerQueue>());
+        shared_data->worker_counters.push_back(std::make_unique<ThreadCounters>());
+        shared_data->worker_scratch_arenas.push_back(std::make_unique<ScratchArena>());
+        bool const pin = info.pin_workers && !placement_order.empty();
+        worker_cpus.push_back(pin ? std::optional{placement_order[thread_index % placement_order.size()]} : std::nullopt);
+    }
+    // Steal from the closest workers first: same cache domain, same numa node, then the rest. Ties are broken by
+    // the distance from the thief so thieves spread out. Without pinning all workers count as equally close.
+    for (u32 thread_index = 0; thread_index < real_thread_count; thread_index++)
+    {
+        auto distance = [&](u32 other_index) -> std::tuple<u32, u32, u32>
+        {
+            u32 const ring_distance = (other_index + real_thread_count - thread_index) % real_thread_count;
+            if (!worker_cpus[thread_index].has_value()) { return {0, 0, ring_distance}; }
+            LogicalCpu const & own_cpu = cpu_topology.logical_cpus[worker_cpus[thread_index].value()];
+            LogicalCpu const & other_cpu = cpu_topology.logical_cpus[worker_cpus[other_index].value()];
+            return {
+                other_cpu.numa_node_index != own_cpu.numa_node_index ? 1u : 0u,
+                other_cpu.cache_domain_index != own_cpu.cache_domain_index ? 1u : 0u,
+                ring_distance,
+            };
+        };
+        std::vector<u32> steal_order = {};
+        for (u32 other_index = 0; other_index < real_thread_count; other_index++)
+        {
+            if (other_index != thread_index) { steal_order.push_back(other_index); }
+        }
+        std::sort(steal_order.begin(), steal_order.end(), [&](u32 lhs, u32 rhs)
+            { return distance(lhs) < distance(rhs); });
+        shared_data->steal_orders.push_back(std::move(steal_order));
+    }
+    for (u32 thread_index = 0; thread_index < real_thread_count; thread_index++)
+    {
+        std::optional<LogicalCpu> pinned_cpu = {};
+        if (worker_cpus[thread_index].has_value()) { pinned_cpu = cpu_topology.logical_cpus[worker_cpus[thread_index].value()]; }
+        worker_threads.push_back({
+            std::thread([shared_data = shared_data, thread_index, pinned_cpu]()
+                { ThreadPool::worker(shared_data, thread_index, pinned_cpu); }),
+        });
+    }
+    // Io threads are left to the os scheduler, they spend most of their time blocked on the disk.
+    for (u32 io_thread_index = 0; io_thread_index < info.io_thread_count; io_thread_index++)
+    {
+        io_threads.push_back(std::thread([shared_data = shared_data]()
+            { ThreadPool::io_worker(shared_data); }));
     }
 }
 
-void ThreadPool::async_dispatch(std::shared_ptr<Task> task, TaskPriority priority)
+auto ThreadPool::thread_count() const -> u32
+{
+    return s_cast<u32>(worker_threads.size());
+}
+
+auto ThreadPool::io_thread_count() const -> u32
+{
+    return s_cast<u32>(io_threads.size());
+}
+
+auto ThreadPool::topology() const -> CpuTopology const &
+{
+    return cpu_topology;
+}
+
+auto ThreadPool::worker_cpu(u32 thread_index) const -> std::optional<u32>
+{
+    return worker_cpus.at(thread_index);
+}
+
+void ThreadPool::push_extra_chunk(Task & task, u32 chunk_index, TaskPriority priority)
+{
+    // The caller is running a chunk of this task, not_finished can not reach zero before this increment.
+    task.not_finished += 1;
+    push_chunks(*shared_data, task, chunk_index, chunk_index + 1, priority);
+}
+
+auto ThreadPool::should_split_range(TaskPriority priority) const -> bool
+{
+    // Lazy binary splitting: only hand out more work when there is none of this priority left to take.
+    return worker_threads.size() > 0 && shared_data->levels[s_cast<u32>(priority)].queued_chunks.load(std::memory_order_relaxed) == 0;
+}
+
+static auto ns_to_ms(u64 nanoseconds) -> f64
+{
+    return s_cast<f64>(nanoseconds) * 1e-6;
+}
+
+auto ThreadPool::stats() const -> ThreadPoolStats
+{
+    ThreadPoolStats stats = {};
+    std::array<u64, TASK_PRIORITY_COUNT> total_wait_ns = {};
+    auto accumulate = [&](ThreadCounters const & counters, ThreadPoolThreadStats & thread_stats)
+    {
+        thread_stats.busy_ms += ns_to_ms(counters.busy_ns.load(std::memory_order_relaxed));
+        thread_stats.idle_ms += ns_to_ms(counters.idle_ns.load(std::memory_order_relaxed));
+        thread_stats.executed_chunks += counters.executed_chunks.load(std::memory_order_relaxed);
+        thread_stats.stolen_chunks += counters.stolen_chunks.load(std::memory_order_relaxed);
+        thread_stats.lock_wait_ms += ns_to_ms(counters.lock_wait_ns.load(std::memory_order_relaxed));
+        for (u32 priority_index = 0; priority_index < TASK_PRIORITY_COUNT; ++priority_index)
+        {
+            TaskPriorityStats & priority_stats = stats.priorities[priority_index];
+            priority_stats.started_chunks += counters.started_chunks[priority_index].load(std::memory_order_relaxed);
+            priority_stats.aged_chunks += counters.aged_chunks[priority_index].load(std::memory_order_relaxed);
+            priority_stats.max_wait_ms = std::max(priority_stats.max_wait_ms, ns_to_ms(counters.max_wait_ns[priority_index].load(std::memory_order_relaxed)));
+            total_wait_ns[priority_index] += counters.total_wait_ns[priority_index].load(std::memory_order_relaxed);
+        }
+    };
+    stats.workers.resize(shared_data->worker_counters.size());
+    for (u32 thread_index = 0; thread_index < shared_data->worker_counters.size(); ++thread_index)
+    {
+        accumulate(*shared_data->worker_counters[thread_index], stats.workers[thread_index]);
+    }
+    accumulate(shared_data->external_counters, stats.external_threads);
+    accumulate(shared_data->io_counters, stats.io_threads);
+    {
+        std::lock_guard lock{shared_data->io_mutex};
+        stats.queued_io_chunks = shared_data->io_chunks.size();
+    }
+    for (u32 priority_index = 0; priority_index < TASK_PRIORITY_COUNT; ++priority_index)
+    {
+        TaskPriorityStats & priority_stats = stats.priorities[priority_index];
+        PriorityLevel const & level = shared_data->levels[priority_index];
+        priority_stats.queued_chunks = level.queued_chunks.load(std::memory_order_relaxed);
+        priority_stats.peak_queued_chunks = level.peak_queued_chunks.load(std::memory_order_relaxed);
+        if (priority_stats.started_chunks != 0)
+        {
+            priority_stats.average_wait_ms = ns_to_ms(total_wait_ns[priority_index]) / s_cast<f64>(priority_stats.started_chunks);
+        }
+    }
+    {
+        std::lock_guard lock{shared_data->queue_depth_history_mutex};
+        stats.queue_depth_history.assign(shared_data->queue_depth_history.begin(), shared_data->queue_depth_history.end());
+    }
+    return stats;
+}
+
+void ThreadPool::reset_stats()
 {
-    task->not_finished = task->chunk_count;
-    auto & selected_queue = priority == TaskPriority::HIGH ? shared_data->high_priority_tasks : shared_data->low_priority_tasks;
+    auto reset = [](ThreadCounters & counters)
     {
-        std::lock_guard lock(shared_data->threadpool_mutex);
-        for (u32 chunk_index = 0; chunk_index < task->chunk_count; chunk_index++)
+        counters.busy_ns = 0;
+        counters.idle_ns = 0;
+        counters.executed_chunks = 0;
+        counters.stolen_chunks = 0;
+        counters.lock_wait_ns = 0;
+        for (u32 priority_index = 0; priority_index < TASK_PRIORITY_COUNT; ++priority_index)
         {
-            selected_queue.push_back({task, chunk_index});
+            counters.started_chunks[priority_index] = 0;
+            counters.aged_chunks[priority_index] = 0;
+            counters.total_wait_ns[priority_index] = 0;
+            counters.max_wait_ns[priority_index] = 0;
         }
+    };
+    for (auto & counters : shared_data->worker_counters) { reset(*counters); }
+    reset(shared_data->external_counters);
+    reset(shared_data->io_counters);
+    for (PriorityLevel & level : shared_data->levels) { level.peak_queued_chunks = level.queued_chunks.load(); }
+    std::lock_guard lock{shared_data->queue_depth_history_mutex};
+    shared_data->queue_depth_history.clear();
+}
+
+void ThreadPool::sample_queue_depths()
+{
+    std::array<u64, TASK_PRIORITY_COUNT> depths = {};
+    for (u32 priority_index = 0; priority_index < TASK_PRIORITY_COUNT; ++priority_index)
+    {
+        depths[priority_index] = shared_data->levels[priority_index].queued_chunks.load(std::memory_order_relaxed);
     }
-    shared_data->work_available.notify_all();
+    std::lock_guard lock{shared_data->queue_depth_history_mutex};
+    if (shared_data->queue_depth_history.size() == QUEUE_DEPTH_HISTORY_LENGTH) { shared_data->queue_depth_history.pop_front(); }
+    shared_data->queue_depth_history.push_back(depths);
+}
+
+void ThreadPool::blocking_dispatch(std::shared_ptr<Task> task, TaskPriority priority)
+{
+    // The caller keeps the task alive for the whole dispatch, no dispatch reference needed.
+    blocking_dispatch(*task, priority);
+}
+
+void ThreadPool::blocking_dispatch(Task & task, TaskPriority priority)
+{
+    prepare_dispatch(task);
+    if (task.chunk_count == 0)
+    {
+        finish_task(*shared_data, task);
+        return;
+    }
+
+    // chunk_index 0 will be worked on by this thread
+    push_chunks(*shared_data, task, 1, task.chunk_count, priority);
+
+    // Contribute to finishing this task from this thread
+    u32 const thread_index = current_thread_index(*shared_data);
+    TaskChunk first_chunk = {&task, 0};
+    execute_chunk(*shared_data, first_chunk, thread_index);
+    while (auto chunk = reclaim_chunk(*shared_data, &task, priority))
+    {
+        execute_chunk(*shared_data, chunk.value(), thread_index);
+    }
+
+    // The remaining chunks were taken by other threads, help with other work of the same or higher priority until
+    // they are done. Lower priority work (e.g. asset loads) could keep this thread away for much longer than the task takes.
+    wait_and_help(task, priority);
+}
+
+void ThreadPool::async_dispatch(std::shared_ptr<Task> task, TaskPriority priority)
+{
+    prepare_dispatch(*task);
+    task->dispatch_reference = task;
+    schedule(*shared_data, *task, priority);
+}
+
+void ThreadPool::async_dispatch_after(std::shared_ptr<Task> task, std::span<std::shared_ptr<Task> const> dependencies, TaskPriority priority)
+{
+    prepare_dispatch(*task);
+    task->dispatch_reference = task;
+    // One extra dependency held by this function, prevents the task from being scheduled by a finishing dependency
+    // while we are still registering the rest.
+    task->unfinished_dependencies = s_cast<u32>(dependencies.size()) + 1;
+    for (std::shared_ptr<Task> const & dependency : dependencies)
+    {
+        std::lock_guard lock{dependency->continuation_mutex};
+        if (dependency->finished) { task->unfinished_dependencies -= 1; }
+        else { dependency->continuations.push_back({task, priority}); }
+    }
+    if (task->unfinished_dependencies.fetch_sub(1) == 1)
+    {
+        schedule(*shared_data, *task, priority);
+    }
+}
+
+auto ThreadPool::when_all(std::span<std::shared_ptr<Task> const> dependencies) -> std::shared_ptr<Task>
+{
+    struct JoinTask : Task
+    {
+        virtual void callback(u32 chunk_index, u32 thread_index) override {}
+    };
+    auto join = std::make_shared<JoinTask>();
+    async_dispatch_after(join, dependencies);
+    return join;
 }
 
 void ThreadPool::block_on(std::shared_ptr<Task> task)
 {
-    std::unique_lock lock{shared_data->threadpool_mutex};
-    shared_data->work_done.wait(lock, [&]
-        { return task->not_finished == 0; });
-}
\ No newline at end of file
+    block_on(*task);
+}
+
+void ThreadPool::block_on(Task & task)
+{
+    wait_and_help(task, TaskPriority::LOW);
+}
+
+void ThreadPool::wait_and_help(Task & task, TaskPriority min_priority)
+{
+    /// NOTE: Instead of going to sleep the waiting thread runs queued work of any task until the awaited one finished.
+    //        This keeps the main thread busy during synchronous phases and makes nested blocking dispatches from workers
+    //        safe, a blocked worker keeps draining the queues so the chunks it waits on can not get stuck behind it.
+    u32 const thread_index = current_thread_index(*shared_data);
+    while (!task.finished.load())
+    {
+        if (auto chunk = pop_chunk(*shared_data, thread_index, min_priority))
+        {
+            execute_chunk(*shared_data, chunk.value(), thread_index);
+            continue;
+        }
+        auto const idle_start = std::chrono::steady_clock::now();
+        std::unique_lock lock{shared_data->sleep_mutex};
+        shared_data->sleeping_threads += 1;
+        shared_data->blocked_threads += 1;
+        shared_data->work_available.wait(lock, [&]
+            { return task.finished.load() || has_queued_work(*shared_data, min_priority); });
+        shared_data->blocked_threads -= 1;
+        shared_data->sleeping_threads -= 1;
+        if (tl_chunk_depth == 0)
+        {
+            thread_counters(*shared_data, thread_index).idle_ns.fetch_add(elapsed_ns(idle_start), std::memory_order_relaxed);
+        }
+    }
+    // finish_task releases the continuation lock as its last access of the task, once we got it the task can be destroyed.
+    std::lock_guard lock{task.continuation_mutex};
+}
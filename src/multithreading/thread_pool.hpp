@@ -4,20 +4,66 @@
 #include <optional>
 #include <atomic>
 #include <deque>
+#include <array>
+#include <vector>
+#include <span>
 #include <condition_variable>
 #include <mutex>
+#include <algorithm>
+#include <type_traits>
+#include <memory>
+#include <new>
+#include <chrono>
 
 #include "../cinder.hpp"
+#include "cpu_topology.hpp"
+#include "scratch_arena.hpp"
 using namespace cinder::types;
 
 static constexpr u32 EXIT_CHUNK_CODE = std::numeric_limits<u32>::max();
 static constexpr u32 NO_MORE_CHUNKS_CODE = std::numeric_limits<u32>::max();
 static constexpr u32 EXTERNAL_THREAD_INDEX = std::numeric_limits<u32>::max();
 
+// Higher levels are always picked first, lower levels that waited for too long are aged (see ThreadPool notes).
 enum struct TaskPriority
 {
     LOW,
-    HIGH
+    NORMAL,
+    HIGH,
+    CRITICAL
+};
+static constexpr u32 TASK_PRIORITY_COUNT = 4;
+
+/**
+ * NOTES:
+ * - Cooperative cancellation, every token copied from a source sees the cancel of that source
+ * - A default constructed token is never cancelled
+ * THREADSAFETY:
+ * * internally synchronized
+ */
+struct CancellationToken
+{
+    auto is_cancelled() const -> bool { return state != nullptr && state->load(std::memory_order_relaxed); }
+
+  private:
+    friend struct CancellationSource;
+    std::shared_ptr<std::atomic_bool const> state = {};
+};
+
+struct CancellationSource
+{
+    CancellationSource() : state{std::make_shared<std::atomic_bool>(false)} {}
+    void cancel() { state->store(true, std::memory_order_relaxed); }
+    auto is_cancelled() const -> bool { return state->load(std::memory_order_relaxed); }
+    auto token() const -> CancellationToken
+    {
+        CancellationToken token = {};
+        token.state = state;
+        return token;
+    }
+
+  private:
+    std::shared_ptr<std::atomic_bool> state = {};
 };
 
 struct Task
@@ -26,43 +72,464 @@ struct Task
     virtual void callback(u32 chunk_index, u32 thread_index) = 0;
 
     u32 chunk_count = {};
-    u32 not_finished = {};
-    u32 started = {};
+    std::atomic_uint32_t not_finished = {};
+    std::atomic_uint32_t started = {};
+
+    /// NOTE: Dependency tracking, managed by the ThreadPool.
+    //        Continuations are tasks that were dispatched with this task as one of their dependencies.
+    //        They are scheduled by the thread that finishes the last chunk of this task.
+    struct Continuation
+    {
+        std::shared_ptr<Task> task = {};
+        TaskPriority priority = {};
+    };
+    std::mutex continuation_mutex = {};
+    std::vector<Continuation> continuations = {};
+    std::atomic_uint32_t unfinished_dependencies = {};
+    // Set once all chunks are done and the continuations were released, reset on every dispatch.
+    std::atomic_bool finished = {};
+
+    /// NOTE: Lifetime while dispatched, managed by the ThreadPool. Queued chunks only hold a raw pointer to the task,
+    //        the dispatch holds a single reference instead that is dropped once the task finished.
+    std::shared_ptr<Task> dispatch_reference = {};
+    // Set for tasks owned by the ThreadPool task pool (async_dispatch_fn), they are recycled once finished.
+    bool pooled = {};
+
+    // Optional, chunks of tasks with a deadline are run before the rest of their priority level, earliest deadline first.
+    // Read when the chunks are queued, set it before dispatching.
+    std::optional<std::chrono::steady_clock::time_point> deadline = {};
+    // Chunks that did not start before the token was cancelled are skipped. The task still finishes normally,
+    // waiters are released and continuations run, they have to check the token themselves.
+    CancellationToken cancellation = {};
+};
+
+struct IndexRange
+{
+    u32 begin = {};
+    u32 end = {};
 };
 
 struct TaskChunk
 {
-    std::shared_ptr<Task> task = {};
+    Task * task = {};
     u32 chunk_index = {};
+    // steady_clock time in nanoseconds at which the chunk was queued, used for the wait time statistics.
+    u64 enqueue_time_ns = {};
 };
 
+struct TaskPriorityStats
+{
+    // Chunks currently sitting in the queues and the most there were at once since the last reset.
+    u64 queued_chunks = {};
+    u64 peak_queued_chunks = {};
+    // Chunks taken out of the queues since the last reset, aged chunks were picked before higher priority work.
+    u64 started_chunks = {};
+    u64 aged_chunks = {};
+    // Time between queueing a chunk and a thread picking it up.
+    f64 average_wait_ms = {};
+    f64 max_wait_ms = {};
+};
+
+struct ThreadPoolThreadStats
+{
+    // Time spent running chunks and time spent asleep waiting for work (or for the awaited task).
+    f64 busy_ms = {};
+    f64 idle_ms = {};
+    u64 executed_chunks = {};
+    // Chunks taken out of the queue of another worker.
+    u64 stolen_chunks = {};
+    // Time spent blocked on contended queue locks.
+    f64 lock_wait_ms = {};
+};
+
+struct ThreadPoolStats
+{
+    std::vector<ThreadPoolThreadStats> workers = {};
+    // Summed up over all threads that are not workers of the pool (main thread).
+    ThreadPoolThreadStats external_threads = {};
+    // Summed up over the io lane threads, plus the io work waiting for a free io thread.
+    ThreadPoolThreadStats io_threads = {};
+    u64 queued_io_chunks = {};
+    std::array<TaskPriorityStats, TASK_PRIORITY_COUNT> priorities = {};
+    // Queue depth per priority, one entry per sample_queue_depths call, oldest first.
+    std::vector<std::array<u64, TASK_PRIORITY_COUNT>> queue_depth_history = {};
+};
+
+struct ThreadPoolInfo
+{
+    // Fixed amount of workers. When not set there is one worker per physical core that is not reserved.
+    std::optional<u32> thread_count = {};
+    // Physical cores left to threads outside of the pool (main/render thread), workers are only placed on them when
+    // there are more workers than free logical cpus. At least one core is always used by the workers.
+    u32 reserved_cores = 1;
+    // Count SMT siblings of the free cores as extra workers when picking the worker count.
+    bool use_smt = false;
+    // Pin every worker to one logical cpu, first one per core then the SMT siblings. Pinned workers steal from workers
+    // in their own cache domain first, then from their numa node, then from the rest.
+    bool pin_workers = false;
+    // Detected when not set.
+    std::optional<CpuTopology> topology = {};
+    // Threads of the io lane, every one does a single blocking read at a time. This is the most reads in flight at
+    // once, keep it low for hdds and network mounts, raise it for nvme drives. Zero runs io work on the workers.
+    u32 io_thread_count = 2;
+};
+
+/**
+ * NOTES:
+ * - Every worker owns a queue, chunks dispatched from a worker thread are pushed into its own queue
+ * - Chunks dispatched from any other thread (main thread) are pushed into the shared injection queue
+ * - The owner pushes and pops at the back of its queue (LIFO, keeps the working set hot in cache),
+ *   other workers steal from the front (FIFO, steals the oldest and usually biggest work)
+ * - Priorities are global, a worker will rather steal higher priority work than run its own lower priority work
+ * - Aging: a level that has queued work but was not served for PRIORITY_AGING_INTERVAL is picked before all higher
+ *   levels, the one waiting the longest first. A steady stream of high priority work can not starve lower levels.
+ * - Chunks of tasks with a deadline are kept in a separate queue per level and run earliest deadline first, before
+ *   the rest of that level. Deadlines do not cross levels, use a higher priority for work that must not wait behind others.
+ * - Threads waiting for a task (block_on, blocking_dispatch) run queued work until it finished, so nested blocking
+ *   dispatches from inside a task can not dead lock. blocking_dispatch only helps with work of its own priority or higher.
+ */
 struct ThreadPool
 {
   public:
-    ThreadPool(std::optional<u32> thread_count = std::nullopt);
+    ThreadPool(ThreadPoolInfo info = {});
+    // Fixed amount of unpinned workers.
+    explicit ThreadPool(u32 thread_count);
     ThreadPool(ThreadPool &&) = default;
     ThreadPool & operator=(ThreadPool &&) = default;
     ThreadPool(ThreadPool const &) = delete;
     ThreadPool & operator=(ThreadPool const &) = delete;
     ~ThreadPool();
     void blocking_dispatch(std::shared_ptr<Task> task, TaskPriority priority = TaskPriority::LOW);
+    // Same as above for tasks owned by the caller (e.g. on the stack), the task only has to outlive the call.
+    void blocking_dispatch(Task & task, TaskPriority priority = TaskPriority::LOW);
     void async_dispatch(std::shared_ptr<Task> task, TaskPriority priority = TaskPriority::LOW);
+    /**
+     * NOTES:
+     * - Dispatches fn(chunk_index, thread_index) (or fn(chunk_index) or fn()) for every chunk without allocating
+     * - The callable is stored inline in a task recycled from the pools task pool, it must fit POOLED_TASK_CAPTURE_SIZE
+     * - Fire and forget, the task can not be waited on or used as a dependency
+     */
+    template <typename FnT>
+    void async_dispatch_fn(FnT && fn, u32 chunk_count = 1, TaskPriority priority = TaskPriority::LOW);
+    static constexpr usize POOLED_TASK_CAPTURE_SIZE = 64;
+    /**
+     * NOTES:
+     * - Same as async_dispatch_fn for blocking io (file reads), runs fn() on a thread of the io lane
+     * - The io lane is a separate group of threads serving its queue in FIFO order, a slow read never stalls the workers
+     *   and there are never more reads in flight than io threads
+     * - Work dispatched from an io thread goes to the shared injection queue, the workers pick it up from there
+     */
+    template <typename FnT>
+    void async_dispatch_io_fn(FnT && fn);
+    // Dispatches the task once all of the dependencies finished. Never blocks, the task is scheduled by the
+    // thread finishing the last dependency. Dependencies can be dispatched before or after this call.
+    void async_dispatch_after(std::shared_ptr<Task> task, std::span<std::shared_ptr<Task> const> dependencies, TaskPriority priority = TaskPriority::LOW);
+    // Returns an empty task that finishes once all of the dependencies finished.
+    // Can be waited on with block_on or used as a dependency itself.
+    auto when_all(std::span<std::shared_ptr<Task> const> dependencies) -> std::shared_ptr<Task>;
     void block_on(std::shared_ptr<Task> task);
+    // The task may be destroyed as soon as this returns.
+    // The waiting thread runs queued work of any priority until the task finished, it does not just sleep.
+    void block_on(Task & task);
+    auto thread_count() const -> u32;
+    auto io_thread_count() const -> u32;
+    auto topology() const -> CpuTopology const &;
+    // Logical cpu (index into topology().logical_cpus) the worker is pinned to.
+    auto worker_cpu(u32 thread_index) const -> std::optional<u32>;
+    /**
+     * NOTES:
+     * - Scratch memory for temporaries of the running chunk, rewound once the chunk returned (see ScratchArena)
+     * - Workers use the arena the pool owns for their thread_index, any other thread (main thread, io lane) gets a
+     *   thread local arena, scratch_arena(EXTERNAL_THREAD_INDEX) returns the one of the calling thread
+     * - current_scratch_arena is for code without a thread_index at hand, e.g. helpers called from coroutines
+     */
+    auto scratch_arena(u32 thread_index) -> ScratchArena &;
+    static auto current_scratch_arena() -> ScratchArena &;
+
+    static constexpr std::chrono::milliseconds PRIORITY_AGING_INTERVAL{10};
+
+    /**
+     * NOTES:
+     * - Scheduler counters, always on. Every thread writes its own counters, they are only summed up when read
+     * - Only contended locks are timed, the hot path pays for a few relaxed increments and two clock reads per chunk
+     * - sample_queue_depths appends the current queue depths to a history of QUEUE_DEPTH_HISTORY_LENGTH entries,
+     *   call it at a fixed rate (e.g. once a frame) to see the queues over time
+     * THREADSAFETY:
+     * * internally synchronized, the counters of running threads keep moving while they are read
+     */
+    auto stats() const -> ThreadPoolStats;
+    void reset_stats();
+    void sample_queue_depths();
+    static constexpr usize QUEUE_DEPTH_HISTORY_LENGTH = 512;
+
+    /**
+     * NOTES:
+     * - Calls fn(index, thread_index) (or fn(index)) for every index in the range and blocks until all calls returned
+     * - The calling thread works on the range too, it does not need to be a worker
+     * - Grain size is picked at runtime with lazy binary splitting. A thread working on a range splits off the upper half
+     *   only while there is no queued work of the same priority that an idle worker could take, otherwise it keeps going
+     *   sequentially. This keeps the number of chunks close to the number of threads that actually participate.
+     * - min_grain is the smallest range that is still split and the amount of iterations between split checks,
+     *   raise it for very cheap loop bodies
+     */
+    template <typename FnT>
+    void parallel_for(IndexRange range, FnT && fn, u32 min_grain = 1, TaskPriority priority = TaskPriority::HIGH);
+    /**
+     * NOTES:
+     * - Same splitting as parallel_for, fn(accumulator, index, thread_index) (or fn(accumulator, index)) folds indices
+     *   into a partial result starting from identity
+     * - Partial results are combined with combine(lhs, rhs) in range order on the calling thread, so combine only
+     *   needs to be associative
+     */
+    template <typename T, typename FnT, typename CombineFnT>
+    auto parallel_reduce(IndexRange range, T identity, FnT && fn, CombineFnT && combine, u32 min_grain = 1, TaskPriority priority = TaskPriority::HIGH) -> T;
 
   private:
+    template <typename T, typename FnT>
+    struct RangeTask;
+    void wait_and_help(Task & task, TaskPriority min_priority);
+    void push_extra_chunk(Task & task, u32 chunk_index, TaskPriority priority);
+    auto should_split_range(TaskPriority priority) const -> bool;
+
+    struct PooledTask : Task
+    {
+        alignas(std::max_align_t) std::array<std::byte, POOLED_TASK_CAPTURE_SIZE> capture = {};
+        void (*invoke)(void * capture, u32 chunk_index, u32 thread_index) = {};
+        void (*destroy)(void * capture) = {};
+        virtual void callback(u32 chunk_index, u32 thread_index) override { invoke(capture.data(), chunk_index, thread_index); }
+    };
+    // Stores the callable in a recycled task and readies it for scheduling.
+    template <typename FnT>
+    auto prepare_pooled_task(FnT && fn, u32 chunk_count) -> PooledTask &;
+
+    struct WorkerQueue
+    {
+        std::mutex mutex = {};
+        std::array<std::deque<TaskChunk>, TASK_PRIORITY_COUNT> chunks = {};
+    };
+    struct DeadlineChunk
+    {
+        u64 deadline_ns = {};
+        TaskChunk chunk = {};
+    };
+    // Counters of one priority level, on their own cache line as every push and pop touches them.
+    struct alignas(64) PriorityLevel
+    {
+        // Number of chunks sitting in any of the queues, lets threads skip empty levels without touching the queue locks.
+        std::atomic_uint64_t queued_chunks = {};
+        // Subset of queued_chunks waiting in the deadline queue.
+        std::atomic_uint64_t queued_deadline_chunks = {};
+        // Last time a chunk of this level was taken out of a queue, drives aging.
+        std::atomic_uint64_t last_served_ns = {};
+        std::atomic_uint64_t peak_queued_chunks = {};
+    };
+    // Statistics written by a single worker (or by all external threads), summed up in stats().
+    struct alignas(64) ThreadCounters
+    {
+        std::atomic_uint64_t busy_ns = {};
+        std::atomic_uint64_t idle_ns = {};
+        std::atomic_uint64_t executed_chunks = {};
+        std::atomic_uint64_t stolen_chunks = {};
+        std::atomic_uint64_t lock_wait_ns = {};
+        std::array<std::atomic_uint64_t, TASK_PRIORITY_COUNT> started_chunks = {};
+        std::array<std::atomic_uint64_t, TASK_PRIORITY_COUNT> aged_chunks = {};
+        std::array<std::atomic_uint64_t, TASK_PRIORITY_COUNT> total_wait_ns = {};
+        std::array<std::atomic_uint64_t, TASK_PRIORITY_COUNT> max_wait_ns = {};
+    };
     struct SharedData
     {
-        // Signaled whenever there is work added to one of the work queues
+        // Signaled whenever there is work added to one of the work queues and some thread is asleep, or when a task
+        // finished while a thread is blocked waiting on one.
         std::condition_variable work_available = {};
-        // Signaled whenever a worker thread detects that it is finishing the last chunk of a task 
-        std::condition_variable work_done = {};
+        std::mutex sleep_mutex = {};
+        // Sleeping workers plus threads sleeping in block_on/blocking_dispatch.
+        std::atomic_uint32_t sleeping_threads = {};
+        // Threads sleeping in block_on/blocking_dispatch, only those care about finished tasks.
+        std::atomic_uint32_t blocked_threads = {};
+
+        WorkerQueue injection_queue = {};
+        std::vector<std::unique_ptr<WorkerQueue>> worker_queues = {};
+        // Per worker, the other workers in the order they are stolen from.
+        std::vector<std::vector<u32>> steal_orders = {};
+        std::array<PriorityLevel, TASK_PRIORITY_COUNT> levels = {};
+        std::vector<std::unique_ptr<ThreadCounters>> worker_counters = {};
+        std::vector<std::unique_ptr<ScratchArena>> worker_scratch_arenas = {};
+        ThreadCounters external_counters = {};
+        ThreadCounters io_counters = {};
+        std::mutex queue_depth_history_mutex = {};
+        std::deque<std::array<u64, TASK_PRIORITY_COUNT>> queue_depth_history = {};
+        // Min heaps on the deadline, chunks of tasks with a deadline are shared by all threads.
+        std::mutex deadline_mutex = {};
+        std::array<std::vector<DeadlineChunk>, TASK_PRIORITY_COUNT> deadline_chunks = {};
+        std::atomic_bool kill = false;
+
+        // Io lane, single chunk tasks served in FIFO order by the io threads.
+        std::mutex io_mutex = {};
+        std::condition_variable io_work_available = {};
+        std::deque<TaskChunk> io_chunks = {};
 
-        std::mutex threadpool_mutex = {};
-        std::deque<TaskChunk> high_priority_tasks = {};
-        std::deque<TaskChunk> low_priority_tasks = {};
-        bool kill = false;
+        // Tasks of async_dispatch_fn. Deque as the tasks must not move, finished ones are put on the free list.
+        std::mutex task_pool_mutex = {};
+        std::deque<PooledTask> task_pool = {};
+        std::vector<PooledTask *> free_pooled_tasks = {};
     };
-    static void worker(std::shared_ptr<ThreadPool::SharedData> shared_data, u32 thread_id);
+    static void worker(std::shared_ptr<ThreadPool::SharedData> shared_data, u32 thread_id, std::optional<LogicalCpu> pinned_cpu);
+    static void io_worker(std::shared_ptr<ThreadPool::SharedData> shared_data);
+    static void push_io_chunk(SharedData & shared_data, Task & task);
+    static void prepare_dispatch(Task & task);
+    static void schedule(SharedData & shared_data, Task & task, TaskPriority priority);
+    static void finish_task(SharedData & shared_data, Task & task);
+    static void push_chunks(SharedData & shared_data, Task & task, u32 first_chunk, u32 end_chunk, TaskPriority priority);
+    static auto acquire_pooled_task(SharedData & shared_data) -> PooledTask &;
+    static void release_pooled_task(SharedData & shared_data, PooledTask & task);
+    static auto has_queued_work(SharedData const & shared_data, TaskPriority min_priority) -> bool;
+    static auto pop_chunk(SharedData & shared_data, u32 thread_index, TaskPriority min_priority) -> std::optional<TaskChunk>;
+    static auto take_chunk(SharedData & shared_data, u32 thread_index, u32 priority_index, u64 now_ns) -> std::optional<TaskChunk>;
+    static void record_chunk_start(SharedData & shared_data, u32 thread_index, u32 priority_index, TaskChunk const & chunk, u64 now_ns);
+    static auto thread_counters(SharedData & shared_data, u32 thread_index) -> ThreadCounters &;
+    static auto lock_counted(std::mutex & mutex, ThreadCounters & counters) -> std::unique_lock<std::mutex>;
+    static auto reclaim_chunk(SharedData & shared_data, Task const * task, TaskPriority priority) -> std::optional<TaskChunk>;
+    static void execute_chunk(SharedData & shared_data, TaskChunk & chunk, u32 thread_index);
+    static auto current_thread_index(SharedData const & shared_data) -> u32;
     std::shared_ptr<SharedData> shared_data = {};
     std::vector<std::thread> worker_threads = {};
+    std::vector<std::thread> io_threads = {};
+    CpuTopology cpu_topology = {};
+    std::vector<std::optional<u32>> worker_cpus = {};
+};
+
+template <typename T, typename FnT>
+struct ThreadPool::RangeTask : Task
+{
+    struct Piece
+    {
+        IndexRange range = {};
+        T partial = {};
+    };
+
+    ThreadPool * pool = {};
+    FnT * fn = {};
+    T identity = {};
+    u32 min_grain = {};
+    TaskPriority priority = {};
+    // Deque as references to pieces stay valid while other threads append new ones.
+    std::mutex pieces_mutex = {};
+    std::deque<Piece> pieces = {};
+
+    RangeTask(ThreadPool * pool, FnT * fn, T identity, IndexRange range, u32 min_grain, TaskPriority priority)
+        : pool{pool}, fn{fn}, identity{identity}, min_grain{std::max(min_grain, 1u)}, priority{priority}
+    {
+        chunk_count = 1;
+        pieces.push_back({range, identity});
+    }
+
+    virtual void callback(u32 chunk_index, u32 thread_index) override
+    {
+        Piece * piece = {};
+        {
+            std::lock_guard lock{pieces_mutex};
+            piece = &pieces[chunk_index];
+        }
+        IndexRange range = piece->range;
+        T accumulator = identity;
+        for (u32 index = range.begin; index < range.end;)
+        {
+            while (range.end - index > min_grain && pool->should_split_range(priority))
+            {
+                u32 const middle = index + (range.end - index) / 2;
+                u32 split_chunk_index = {};
+                {
+                    std::lock_guard lock{pieces_mutex};
+                    split_chunk_index = s_cast<u32>(pieces.size());
+                    pieces.push_back({{middle, range.end}, identity});
+                }
+                range.end = middle;
+                pool->push_extra_chunk(*this, split_chunk_index, priority);
+            }
+            u32 const block_end = std::min(range.end, index + min_grain);
+            for (; index < block_end; ++index)
+            {
+                if constexpr (std::is_invocable_v<FnT &, T &, u32, u32>) { (*fn)(accumulator, index, thread_index); }
+                else { (*fn)(accumulator, index); }
+            }
+        }
+        // Only the thread running this chunk touches the piece, the caller reads it after the task finished.
+        piece->range = range;
+        piece->partial = std::move(accumulator);
+    }
 };
+
+template <typename T, typename FnT, typename CombineFnT>
+auto ThreadPool::parallel_reduce(IndexRange range, T identity, FnT && fn, CombineFnT && combine, u32 min_grain, TaskPriority priority) -> T
+{
+    if (range.begin >= range.end) { return identity; }
+    using FnType = std::remove_reference_t<FnT>;
+    // Blocking, the task can live on the stack.
+    RangeTask<T, FnType> task{this, &fn, identity, range, min_grain, priority};
+    blocking_dispatch(task, priority);
+
+    std::vector<typename RangeTask<T, FnType>::Piece *> ordered_pieces = {};
+    ordered_pieces.reserve(task.pieces.size());
+    for (auto & piece : task.pieces) { ordered_pieces.push_back(&piece); }
+    std::sort(ordered_pieces.begin(), ordered_pieces.end(), [](auto const * lhs, auto const * rhs)
+        { return lhs->range.begin < rhs->range.begin; });
+    T result = std::move(ordered_pieces[0]->partial);
+    for (usize piece_index = 1; piece_index < ordered_pieces.size(); ++piece_index)
+    {
+        result = combine(std::move(result), std::move(ordered_pieces[piece_index]->partial));
+    }
+    return result;
+}
+
+template <typename FnT>
+void ThreadPool::parallel_for(IndexRange range, FnT && fn, u32 min_grain, TaskPriority priority)
+{
+    struct Empty
+    {
+    };
+    auto body = [&fn](Empty &, u32 index, u32 thread_index)
+    {
+        if constexpr (std::is_invocable_v<FnT &, u32, u32>) { fn(index, thread_index); }
+        else { fn(index); }
+    };
+    parallel_reduce(range, Empty{}, body, [](Empty lhs, Empty) { return lhs; }, min_grain, priority);
+}
+
+template <typename FnT>
+auto ThreadPool::prepare_pooled_task(FnT && fn, u32 chunk_count) -> PooledTask &
+{
+    using FnType = std::decay_t<FnT>;
+    static_assert(sizeof(FnType) <= POOLED_TASK_CAPTURE_SIZE, "Callable too big for a pooled task, capture less or dispatch a Task");
+    static_assert(alignof(FnType) <= alignof(std::max_align_t), "Over aligned callables are not supported");
+    PooledTask & task = acquire_pooled_task(*shared_data);
+    new (task.capture.data()) FnType(std::forward<FnT>(fn));
+    task.invoke = [](void * capture, u32 chunk_index, u32 thread_index)
+    {
+        FnType & fn = *r_cast<FnType *>(capture);
+        if constexpr (std::is_invocable_v<FnType &, u32, u32>) { fn(chunk_index, thread_index); }
+        else if constexpr (std::is_invocable_v<FnType &, u32>) { fn(chunk_index); }
+        else { fn(); }
+    };
+    task.destroy = [](void * capture)
+    { r_cast<FnType *>(capture)->~FnType(); };
+    task.chunk_count = chunk_count;
+    // No continuations to keep, skips the continuation lock of prepare_dispatch.
+    task.not_finished = chunk_count;
+    task.started = 0;
+    task.finished = false;
+    return task;
+}
+
+template <typename FnT>
+void ThreadPool::async_dispatch_fn(FnT && fn, u32 chunk_count, TaskPriority priority)
+{
+    schedule(*shared_data, prepare_pooled_task(std::forward<FnT>(fn), chunk_count), priority);
+}
+
+template <typename FnT>
+void ThreadPool::async_dispatch_io_fn(FnT && fn)
+{
+    PooledTask & task = prepare_pooled_task(std::forward<FnT>(fn), 1);
+    if (io_threads.empty()) { schedule(*shared_data, task, TaskPriority::LOW); }
+    else { push_io_chunk(*shared_data, task); }
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "cinder.hpp"
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <span>
+#include <utility>
+#include <vector>
+namespace cinder
+{
+    using namespace types;
+    /**
+     * DESCRIPTION:
+     * Growable array made of fixed size pages. Pages are allocated when the last one is full and are never moved.
+     * NOTES:
+     * - Growing is O(1) and never copies or moves an element, pointers to elements stay valid until the element is popped
+     * - Indexing is a shift and a mask into the page table, one more indirection than std::vector
+     * - Pages are kept when elements are popped or cleared and reused by the next pushes
+     * THREADSAFETY:
+     * * not synchronized
+     */
+    template <typename T, u32 PAGE_SIZE_LOG2 = 10>
+    struct PagedArray
+    {
+        public:
+            static inline constexpr u32 PAGE_SIZE = 1u << PAGE_SIZE_LOG2;
+
+        private:
+            struct Page
+            {
+                alignas(T) std::byte storage[sizeof(T) * PAGE_SIZE];
+            };
+            std::vector<std::unique_ptr<Page>>
+                _pages = {};
+            usize
+                _size = {};
+
+            auto element(usize index) const -> T *
+            {
+                return std::launder(r_cast<T *>(_pages[index >> PAGE_SIZE_LOG2]->storage)) + (index & (PAGE_SIZE - 1));
+            }
+
+        public:
+            template <typename ValueT, typename ArrayT>
+            struct Iterator
+            {
+                ArrayT * array = {};
+                usize index = {};
+                auto operator*() const -> ValueT & { return (*array)[index]; }
+                auto operator->() const -> ValueT * { return &(*array)[index]; }
+                auto operator++() -> Iterator &
+                {
+                    ++index;
+                    return *this;
+                }
+                auto operator==(Iterator const & other) const -> bool { return index == other.index; }
+            };
+            using iterator = Iterator<T, PagedArray>;
+            using const_iterator = Iterator<T const, PagedArray const>;
+
+            PagedArray() = default;
+            PagedArray(PagedArray const &) = delete;
+            PagedArray & operator=(PagedArray const &) = delete;
+            PagedArray(PagedArray && other)
+                : _pages{std::move(other._pages)}, _size{std::exchange(other._size, 0)}
+            {
+            }
+            PagedArray & operator=(PagedArray && other)
+            {
+                if (this != &other)
+                {
+                    clear();
+                    _pages = std::move(other._pages);
+                    _size = std::exchange(other._size, 0);
+                }
+                return *this;
+            }
+            ~PagedArray()
+            {
+                clear();
+            }
+
+            template <typename... ArgsT>
+            auto emplace_back(ArgsT &&... args) -> T &
+            {
+                if (_size == _pages.size() * PAGE_SIZE)
+                {
+                    /// NOTE: Only the page table grows, it holds pointers so the elements stay where they are.
+                    _pages.push_back(std::make_unique_for_overwrite<Page>());
+                }
+                T * slot = std::construct_at(element(_size), std::forward<ArgsT>(args)...);
+                _size += 1;
+                return *slot;
+            }
+            void pop_back()
+            {
+                _size -= 1;
+                std::destroy_at(element(_size));
+            }
+            void clear()
+            {
+                while (_size > 0) { pop_back(); }
+            }
+            auto operator[](usize index) -> T & { return *element(index); }
+            auto operator[](usize index) const -> T const & { return *element(index); }
+            auto back() -> T & { return *element(_size - 1); }
+            auto size() const -> usize { return _size; }
+            auto empty() const -> bool { return _size == 0; }
+            auto capacity() const -> usize { return _pages.size() * PAGE_SIZE; }
+            // Live elements of a page, contiguous in memory. The last used page may be partially filled.
+            auto page_count() const -> usize { return (_size + PAGE_SIZE - 1) / PAGE_SIZE; }
+            auto page(usize page_index) -> std::span<T>
+            {
+                usize const first = page_index * PAGE_SIZE;
+                return {element(first), std::min<usize>(PAGE_SIZE, _size - first)};
+            }
+            auto page(usize page_index) const -> std::span<T const>
+            {
+                usize const first = page_index * PAGE_SIZE;
+                return {element(first), std::min<usize>(PAGE_SIZE, _size - first)};
+            }
+            auto begin() -> iterator { return {this, 0}; }
+            auto end() -> iterator { return {this, _size}; }
+            auto begin() const -> const_iterator { return {this, 0}; }
+            auto end() const -> const_iterator { return {this, _size}; }
+    };
+}
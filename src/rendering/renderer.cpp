@@ -2,6 +2,7 @@
 
 #include "misc.hpp"
 #include "tasks/basic_raytracing.inl"
+#include "tasks/scatter_upload.inl"
 
 Renderer::Renderer(CreateRendererInfo const & info) :
     window{info.window},
@@ -45,6 +46,25 @@ void Renderer::compile_pipelines()
         basic_rt_sbt_info.sbt = sbt;
     }
 
+    std::vector<daxa::ComputePipelineCompileInfo> compute_pipelines {
+        {scatter_upload_pipeline_compile_info()},
+    };
+
+    for (auto const & info : compute_pipelines)
+    {
+        auto compilation_result = gpu_context->pipeline_manager.add_compute_pipeline(info);
+        if (compilation_result.value()->is_valid())
+        {
+            DEBUG_MESSAGE(fmt::format("[Renderer::compile_pipelines()] SUCCESFULLY compiled pipeline {}", info.name));
+        }
+        else
+        {
+            DEBUG_MESSAGE(fmt::format("[Renderer::compile_pipelines()] FAILED to compile pipeline {} with message \n {}", info.name,
+                compilation_result.message()));
+        }
+        gpu_context->compute_pipelines[info.name] = compilation_result.value();
+    }
+
     while(!gpu_context->pipeline_manager.all_pipelines_valid())
     {
         auto const result = gpu_context->pipeline_manager.reload_all();
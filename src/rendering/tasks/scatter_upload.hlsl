@@ -0,0 +1,19 @@
+#include "scatter_upload.inl"
+
+#include <daxa/daxa.inl>
+
+[[vk::push_constant]] ScatterUploadPush push;
+
+[shader("compute")]
+[numthreads(SCATTER_UPLOAD_WORKGROUP_X, 1, 1)]
+void entry_scatter_upload(uint3 thread_idx : SV_DispatchThreadID)
+{
+    const uint total_word_count = push.element_count * push.word_count;
+    // Consecutive threads write consecutive words of an element, the writes of one element stay together.
+    for (uint word_index = thread_idx.x; word_index < total_word_count; word_index += push.dispatch_thread_count)
+    {
+        const uint element_index = word_index / push.word_count;
+        const uint element_word = word_index - element_index * push.word_count;
+        push.dst[push.indices[element_index] * push.word_count + element_word] = push.payload[word_index];
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <daxa/daxa.inl>
+
+#define SCATTER_UPLOAD_WORKGROUP_X 128
+// Dispatches are capped to this many workgroups, every thread loops over the words with the dispatch thread count as stride.
+#define SCATTER_UPLOAD_MAX_WORKGROUPS 65535
+
+// Writes element i of payload to element indices[i] of dst. Elements are word_count u32s each.
+struct ScatterUploadPush
+{
+    daxa_BufferPtr(daxa_u32) indices;
+    daxa_BufferPtr(daxa_u32) payload;
+    daxa_RWBufferPtr(daxa_u32) dst;
+    daxa_u32 element_count;
+    daxa_u32 word_count;
+    daxa_u32 dispatch_thread_count;
+};
+
+#if defined(__cplusplus)
+#include <daxa/utils/pipeline_manager.hpp>
+
+inline auto scatter_upload_pipeline_compile_info() -> daxa::ComputePipelineCompileInfo
+{
+    return {
+        .shader_info = {
+            .source = daxa::ShaderFile{"scatter_upload.hlsl"},
+            .compile_options = {.entry_point = "entry_scatter_upload"},
+        },
+        .push_constant_size = sizeof(ScatterUploadPush),
+        .name = "scatter upload pipeline",
+    };
+}
+#endif // __cplusplus
@@ -1,4 +1,5 @@
 #include "asset_processor.hpp"
+#include "staging_budget.hpp"
 #include <daxa/types.hpp>
 #include <fastgltf/tools.hpp>
 #include <fastgltf/types.hpp>
@@ -10,14 +11,6 @@
 #include <ktx.h>
 
 #pragma region IMAGE_RAW_DATA_LOADING_HELPERS
-struct ImageFromRawInfo
-{
-    std::vector<std::byte> raw_data;
-    std::filesystem::path image_path;
-    fastgltf::MimeType mime_type;
-    int ktx_compression = KTX_TTF_BC7_RGBA;
-};
-
 using RawDataRet = std::variant<std::monostate, AssetProcessor::AssetLoadResultCode, ImageFromRawInfo>;
 
 struct RawImageDataFromURIInfo
@@ -131,6 +124,7 @@ struct ParsedImageData
     u32 mips_to_copy = {};
     std::array<u32,16> mip_copy_offsets = {};
     bool compressed_bc5_rg = {};
+    u64 reserved_staging_size = {};
 };
 
 using ParsedImageRet = std::variant<std::monostate, AssetProcessor::AssetLoadResultCode, ParsedImageData>;
@@ -308,7 +302,14 @@ constexpr static auto daxa_image_format_from_pixel_info(PixelInfo const & info)
     return format;
 };
 
-static auto free_image_parse_raw_image_data(ImageFromRawInfo && raw_data, daxa::Device & device, TextureMaterialType type) -> ParsedImageRet
+static void discard_parsed_image(daxa::Device & device, StagingBudgetWait const & staging_wait, ParsedImageData const & parsed_data)
+{
+    device.destroy_buffer(parsed_data.src_buffer);
+    device.destroy_image(parsed_data.dst_image);
+    release_staging_memory(staging_wait, parsed_data.reserved_staging_size);
+}
+
+static auto free_image_parse_raw_image_data(ImageFromRawInfo && raw_data, daxa::Device & device, TextureMaterialType type, StagingBudgetWait staging_wait) -> cinder::task<ParsedImageRet>
 {
     bool load_as_srgb = type == TextureMaterialType::DIFFUSE;
     /// NOTE: Since we handle the image data loading ourselves we need to wrap the buffer with a FreeImage
@@ -327,11 +328,11 @@ static auto free_image_parse_raw_image_data(ImageFromRawInfo && raw_data, daxa::
     // could not deduce filetype at all
     if (image_format == FIF_UNKNOWN)
     {
-        return AssetProcessor::AssetLoadResultCode::ERROR_UNKNOWN_FILETYPE_FORMAT;
+        co_return AssetProcessor::AssetLoadResultCode::ERROR_UNKNOWN_FILETYPE_FORMAT;
     }
     if (!FreeImage_FIFSupportsReading(image_format))
     {
-        return AssetProcessor::AssetLoadResultCode::ERROR_UNSUPPORTED_READ_FOR_FILEFORMAT;
+        co_return AssetProcessor::AssetLoadResultCode::ERROR_UNSUPPORTED_READ_FOR_FILEFORMAT;
     }
     FIBITMAP * image_bitmap = FreeImage_LoadFromMemory(image_format, fif_memory_wrapper);
     defer
@@ -340,7 +341,7 @@ static auto free_image_parse_raw_image_data(ImageFromRawInfo && raw_data, daxa::
     };
     if (!image_bitmap)
     {
-        return AssetProcessor::AssetLoadResultCode::ERROR_COULD_NOT_READ_TEXTURE_FILE_FROM_MEMSTREAM;
+        co_return AssetProcessor::AssetLoadResultCode::ERROR_COULD_NOT_READ_TEXTURE_FILE_FROM_MEMSTREAM;
     }
     u32 bits_per_pixel = FreeImage_GetBPP(image_bitmap);
     if (bits_per_pixel != 32 && bits_per_pixel != 24) {
@@ -368,7 +369,7 @@ static auto free_image_parse_raw_image_data(ImageFromRawInfo && raw_data, daxa::
     ParsedChannel parsed_channel = parse_channel_info(image_type);
     if (auto const * err = std::get_if<AssetProcessor::AssetLoadResultCode>(&parsed_channel))
     {
-        return *err;
+        co_return *err;
     }
 
     ChannelInfo const & channel_info = std::get<ChannelInfo>(parsed_channel);
@@ -400,6 +401,12 @@ static auto free_image_parse_raw_image_data(ImageFromRawInfo && raw_data, daxa::
     FreeImage_FlipVertical(modified_bitmap);
     ParsedImageData ret = {};
     u32 const total_image_byte_size = width * height * rounded_channel_count * channel_info.byte_size;
+    std::optional<u64> const reserved_staging_size = co_await reserve_staging_memory(staging_wait, total_image_byte_size);
+    if (!reserved_staging_size.has_value())
+    {
+        co_return AssetProcessor::AssetLoadResultCode::CANCELLED;
+    }
+    ret.reserved_staging_size = reserved_staging_size.value();
     ret.src_buffer = device.create_buffer({
         .size = total_image_byte_size,
         .allocate_info = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,
@@ -423,12 +430,26 @@ static auto free_image_parse_raw_image_data(ImageFromRawInfo && raw_data, daxa::
             daxa::ImageUsageFlagBits::SHADER_SAMPLED,
         .name = raw_data.image_path.filename().string(),
     });
-    return ret;
+    co_return ret;
 }
 
-static auto ktx_parse_raw_image_data(ImageFromRawInfo & raw_data, daxa::Device & device, TextureMaterialType type) -> ParsedImageRet
+struct KtxTextureDeleter
+{
+    void operator()(ktxTexture2 * texture) const { ktxTexture_Destroy(ktxTexture(texture)); }
+};
+
+struct TranscodedKtxImage
+{
+    std::unique_ptr<ktxTexture2, KtxTextureDeleter> texture = {};
+    bool compressed_bc5_rg = {};
+};
+
+using TranscodedKtxRet = std::variant<AssetProcessor::AssetLoadResultCode, TranscodedKtxImage>;
+
+/// NOTE: Transcoding is split from creating the staging buffer, the size of the staging memory is only known afterwards.
+//        Loads reserve the staging memory of all their images at once in between, see staging_budget.hpp.
+static auto ktx_transcode_raw_image_data(ImageFromRawInfo & raw_data, TextureMaterialType type) -> TranscodedKtxRet
 {
-    bool const load_as_srgb = (type == TextureMaterialType::DIFFUSE) || (type == TextureMaterialType::DIFFUSE_OPACITY);
     ktx_transcode_fmt_e transcode_format;
     switch (type)
     {
@@ -439,7 +460,6 @@ static auto ktx_parse_raw_image_data(ImageFromRawInfo & raw_data, daxa::Device &
 
     ktxTexture2* texture;
     KTX_error_code result;
-    ktx_size_t offset;
     
     result = ktxTexture2_CreateFromMemory(
         r_cast<ktx_uint8_t*>(raw_data.raw_data.data()),
@@ -450,7 +470,10 @@ static auto ktx_parse_raw_image_data(ImageFromRawInfo & raw_data, daxa::Device &
     {
         return AssetProcessor::AssetLoadResultCode::ERROR_FAILED_TO_PROCESS_KTX;
     }
-    defer{ktxTexture_Destroy(ktxTexture(texture));};
+    TranscodedKtxImage ret = {
+        .texture = std::unique_ptr<ktxTexture2, KtxTextureDeleter>{texture},
+        .compressed_bc5_rg = transcode_format == KTX_TTF_BC5_RG,
+    };
 
     ktx_transcode_flags flags = KTX_TF_HIGH_QUALITY;
     flags |= type == TextureMaterialType::DIFFUSE_OPACITY ? KTX_TF_TRANSCODE_ALPHA_DATA_TO_OPAQUE_FORMATS : 0u;
@@ -459,16 +482,23 @@ static auto ktx_parse_raw_image_data(ImageFromRawInfo & raw_data, daxa::Device &
     {
         return AssetProcessor::AssetLoadResultCode::ERROR_FAILED_TO_PROCESS_KTX;
     }
-    
+    return ret;
+}
+
+// Releases the reserved staging memory itself when it fails.
+static auto ktx_create_parsed_image(
+    ImageFromRawInfo const & raw_data, TranscodedKtxImage const & transcoded, daxa::Device & device,
+    StagingBudgetWait const & staging_wait, u64 reserved_staging_size) -> ParsedImageRet
+{
+    ktxTexture2 * texture = transcoded.texture.get();
     u32 const numLevels = texture->numLevels;
     u32 const numLayers = texture->numLayers;
     u32 const baseWidth = texture->baseWidth;
     u32 const baseHeight = texture->baseHeight;
     u32 const baseDepth = texture->baseDepth;
-    u32 const mips = static_cast<u32>(floor(std::log2(std::min(baseWidth, baseHeight)))) + 1;
-    bool const isArray = texture->isArray;
 
     ParsedImageData ret = {};
+    ret.reserved_staging_size = reserved_staging_size;
     daxa::BufferId staging = device.create_buffer({
         .size = texture->dataSize,
         .allocate_info = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,  // Host local memory.
@@ -491,16 +521,19 @@ static auto ktx_parse_raw_image_data(ImageFromRawInfo & raw_data, daxa::Device &
     });
     ret.dst_image = image_id;
     ret.src_buffer = staging;
-    ret.compressed_bc5_rg = transcode_format == KTX_TTF_BC5_RG;
+    ret.compressed_bc5_rg = transcoded.compressed_bc5_rg;
     ret.mips_to_copy = texture->numLevels;
     for (u32 mip = 0; mip < texture->numLevels; ++mip)
     {
         u32 const layer = 0;
         u32 const faceSlice = 0;
         usize offset = {};
-        result = ktxTexture_GetImageOffset(ktxTexture(texture), mip, layer, faceSlice, &offset);
+        KTX_error_code const result = ktxTexture_GetImageOffset(ktxTexture(texture), mip, layer, faceSlice, &offset);
         if (result != KTX_SUCCESS)
         {
+            device.destroy_buffer(staging);
+            device.destroy_image(image_id);
+            release_staging_memory(staging_wait, ret.reserved_staging_size);
             return AssetProcessor::AssetLoadResultCode::ERROR_FAILED_TO_PROCESS_KTX;
         }
         usize size = ktxTexture_GetImageSize(ktxTexture(texture), mip);
@@ -514,7 +547,8 @@ static auto ktx_parse_raw_image_data(ImageFromRawInfo & raw_data, daxa::Device &
 #pragma endregion
 
 AssetProcessor::AssetProcessor(daxa::Device device)
-    : _device{std::move(device)}
+    : _device{std::move(device)},
+      _staging_budget{std::make_unique<cinder::AsyncBudget>(STAGING_MEMORY_BUDGET)}
 {
 // call this ONLY when linking with FreeImage as a static library
 #ifdef FREEIMAGE_LIB
@@ -538,7 +572,7 @@ auto AssetProcessor::load_nonmanifest_texture(std::filesystem::path const & file
         return std::get<AssetProcessor::AssetLoadResultCode>(raw_data_ret);
     }
     ImageFromRawInfo & raw_data = std::get<ImageFromRawInfo>(raw_data_ret);
-    ParsedImageRet parsed_data_ret = free_image_parse_raw_image_data(std::move(raw_data), _device, TextureMaterialType::DIFFUSE);
+    ParsedImageRet parsed_data_ret = cinder::sync_wait(free_image_parse_raw_image_data(std::move(raw_data), _device, TextureMaterialType::DIFFUSE, {}));
     if (auto const * error = std::get_if<AssetProcessor::AssetLoadResultCode>(&parsed_data_ret))
     {
         return *error;
@@ -574,11 +608,31 @@ auto AssetProcessor::load_nonmanifest_texture(std::filesystem::path const & file
     return parsed_data.dst_image;
 }
 
-auto AssetProcessor::load_texture(LoadTextureInfo const & info) -> AssetLoadResultCode
+auto AssetProcessor::load_texture(LoadTextureInfo info) -> cinder::task<AssetLoadResultCode>
+{
+    /// NOTE: Reading blocks on the disk while decoding is cpu heavy, switch lanes in between so neither stalls the other.
+    if (info.thread_pool != nullptr) { co_await cinder::resume_on_io(*info.thread_pool); }
+    if (info.cancellation.is_cancelled())
+    {
+        co_return AssetLoadResultCode::CANCELLED;
+    }
+    ReadTextureRet read_ret = read_texture(info);
+    if (auto const * error = std::get_if<AssetLoadResultCode>(&read_ret))
+    {
+        co_return *error;
+    }
+    if (info.cancellation.is_cancelled())
+    {
+        co_return AssetLoadResultCode::CANCELLED;
+    }
+    if (info.thread_pool != nullptr) { co_await cinder::resume_on(*info.thread_pool); }
+    co_return co_await process_texture(info, std::get<ImageFromRawInfo>(std::move(read_ret)));
+}
+
+auto AssetProcessor::read_texture(LoadTextureInfo const & info) -> ReadTextureRet
 {
     fastgltf::Asset const & gltf_asset = *info.asset;
     fastgltf::Image const & image = gltf_asset.images.at(info.gltf_image_index);
-    std::vector<std::byte> raw_data = {};
 
     RawDataRet ret = {};
     if (auto const * uri = std::get_if<fastgltf::sources::URI>(&image.data))
@@ -606,52 +660,92 @@ auto AssetProcessor::load_texture(LoadTextureInfo const & info) -> AssetLoadResu
     {
         return *error;
     }
-    ImageFromRawInfo & raw_image_data = std::get<ImageFromRawInfo>(ret);
+    return std::get<ImageFromRawInfo>(std::move(ret));
+}
+
+auto AssetProcessor::process_texture(LoadTextureInfo info, ImageFromRawInfo raw_image_data) -> cinder::task<AssetLoadResultCode>
+{
+    StagingBudgetWait const staging_wait = {
+        .budget = _staging_budget.get(),
+        .thread_pool = info.thread_pool,
+        .cancellation = info.cancellation,
+    };
     ParsedImageRet parsed_data_ret = {};
     ParsedImageRet opaque_data_ret = {std::monostate{}};
     if (raw_image_data.mime_type == fastgltf::MimeType::KTX2)
     {
-        parsed_data_ret = ktx_parse_raw_image_data(raw_image_data, _device, info.texture_material_type);
-        if(info.texture_material_type == TextureMaterialType::DIFFUSE)
+        TranscodedKtxRet transcoded_ret = ktx_transcode_raw_image_data(raw_image_data, info.texture_material_type);
+        if (auto const * error = std::get_if<AssetLoadResultCode>(&transcoded_ret))
+        {
+            co_return *error;
+        }
+        TranscodedKtxImage const & transcoded = std::get<TranscodedKtxImage>(transcoded_ret);
+        /// NOTE: Diffuse textures also upload their alpha as a separate opacity image. It is uploaded if it transcodes.
+        std::optional<TranscodedKtxImage> opacity = {};
+        if(info.texture_material_type == TextureMaterialType::DIFFUSE && !info.cancellation.is_cancelled())
+        {
+            TranscodedKtxRet opacity_ret = ktx_transcode_raw_image_data(raw_image_data, TextureMaterialType::DIFFUSE_OPACITY);
+            if (auto * opacity_transcoded = std::get_if<TranscodedKtxImage>(&opacity_ret)) { opacity = std::move(*opacity_transcoded); }
+        }
+        /// NOTE: One reservation for both images, each upload releases its own share.
+        std::optional<std::array<u64, 2>> const reserved_staging_sizes = co_await reserve_staging_memory(staging_wait, std::array<u64, 2>{
+            transcoded.texture->dataSize,
+            opacity.has_value() ? opacity->texture->dataSize : 0,
+        });
+        if (!reserved_staging_sizes.has_value())
         {
-            opaque_data_ret = ktx_parse_raw_image_data(raw_image_data, _device, TextureMaterialType::DIFFUSE_OPACITY);
+            co_return AssetLoadResultCode::CANCELLED;
+        }
+        parsed_data_ret = ktx_create_parsed_image(raw_image_data, transcoded, _device, staging_wait, reserved_staging_sizes.value()[0]);
+        if (opacity.has_value())
+        {
+            opaque_data_ret = ktx_create_parsed_image(raw_image_data, opacity.value(), _device, staging_wait, reserved_staging_sizes.value()[1]);
         }
     }
     else
     {
-        parsed_data_ret = free_image_parse_raw_image_data(std::move(raw_image_data), _device, info.texture_material_type);
+        parsed_data_ret = co_await free_image_parse_raw_image_data(std::move(raw_image_data), _device, info.texture_material_type, staging_wait);
+    }
+    /// NOTE: Last check before the texture becomes visible to the upload, everything parsed so far is thrown away.
+    if (info.cancellation.is_cancelled())
+    {
+        if (auto const * parsed_data = std::get_if<ParsedImageData>(&parsed_data_ret)) { discard_parsed_image(_device, staging_wait, *parsed_data); }
+        if (auto const * opaque_data = std::get_if<ParsedImageData>(&opaque_data_ret)) { discard_parsed_image(_device, staging_wait, *opaque_data); }
+        co_return AssetLoadResultCode::CANCELLED;
     }
     if (auto const * error = std::get_if<AssetProcessor::AssetLoadResultCode>(&parsed_data_ret))
     {
-        return *error;
+        if (auto const * opaque_data = std::get_if<ParsedImageData>(&opaque_data_ret)) { discard_parsed_image(_device, staging_wait, *opaque_data); }
+        co_return *error;
     }
     ParsedImageData const & parsed_data = std::get<ParsedImageData>(parsed_data_ret);
     ParsedImageData const * opaque_data = std::get_if<ParsedImageData>(&opaque_data_ret);
-    /// NOTE: Append the processed texture to the upload queue.
+    /// NOTE: Hand the processed texture over to the upload.
+    std::array<LoadedTextureInfo, 2> uploads = {};
+    uploads[0] = LoadedTextureInfo{
+        .staging_buffer = parsed_data.src_buffer,
+        .dst_image = parsed_data.dst_image,
+        .mips_to_copy = parsed_data.mips_to_copy,
+        .mip_copy_offsets = parsed_data.mip_copy_offsets,
+        .texture_manifest_index = info.texture_manifest_index,
+        .compressed_bc5_rg = parsed_data.compressed_bc5_rg,
+        .reserved_staging_size = parsed_data.reserved_staging_size,
+    };
+    if(opaque_data)
     {
-        std::lock_guard<std::mutex> lock{*_texture_upload_mutex};
-        _upload_texture_queue.push_back(LoadedTextureInfo{
-            .staging_buffer = parsed_data.src_buffer,
-            .dst_image = parsed_data.dst_image,
-            .mips_to_copy = parsed_data.mips_to_copy,
-            .mip_copy_offsets = parsed_data.mip_copy_offsets,
+        uploads[1] = LoadedTextureInfo{
+            .staging_buffer = opaque_data->src_buffer,
+            .dst_image = opaque_data->dst_image,
+            .mips_to_copy = opaque_data->mips_to_copy,
+            .mip_copy_offsets = opaque_data->mip_copy_offsets,
             .texture_manifest_index = info.texture_manifest_index,
-            .compressed_bc5_rg = parsed_data.compressed_bc5_rg,
-        });
-        if(opaque_data)
-        {
-            _upload_texture_queue.push_back(LoadedTextureInfo{
-                .staging_buffer = opaque_data->src_buffer,
-                .dst_image = opaque_data->dst_image,
-                .mips_to_copy = opaque_data->mips_to_copy,
-                .mip_copy_offsets = opaque_data->mip_copy_offsets,
-                .texture_manifest_index = info.texture_manifest_index,
-                .secondary_texture = true,
-                .compressed_bc5_rg = false,
-            });
-        }
+            .secondary_texture = true,
+            .compressed_bc5_rg = false,
+            .reserved_staging_size = opaque_data->reserved_staging_size,
+        };
     }
-    return AssetLoadResultCode::SUCCESS;
+    queue_texture_uploads(info.main_thread, std::span<LoadedTextureInfo const>{uploads.data(), opaque_data != nullptr ? 2u : 1u});
+    co_return AssetLoadResultCode::SUCCESS;
 }
 
 /// NOTE: Overload ElementTraits for glm vec3 for fastgltf to understand the type.
@@ -671,12 +765,15 @@ struct fastgltf::ElementTraits<glm::vec2> : fastgltf::ElementTraitsBase<float, f
 {
 };
 
+/// NOTE: Reads the accessor from its file and decodes it straight into dst, which has to fit accessor.count elements.
+//        The file section and the u16 index widening only live in the scratch arena of the calling thread.
 template <typename ElemT, bool IS_INDEX_BUFFER>
-auto load_accessor_data_from_file(
+auto read_accessor_into(
     std::filesystem::path const & root_path,
     fastgltf::Asset const & gltf_asset,
-    fastgltf::Accessor const & accesor)
-    -> std::variant<std::vector<ElemT>, AssetProcessor::AssetLoadResultCode>
+    fastgltf::Accessor const & accesor,
+    ElemT * dst)
+    -> AssetProcessor::AssetLoadResultCode
 {
     static_assert(!IS_INDEX_BUFFER || std::is_same_v<ElemT, u32>, "Index Buffer must be u32");
     fastgltf::BufferView const & gltf_buffer_view = gltf_asset.bufferViews.at(accesor.bufferViewIndex.value());
@@ -694,13 +791,13 @@ auto load_accessor_data_from_file(
     {
         return AssetProcessor::AssetLoadResultCode::ERROR_COULD_NOT_OPEN_GLTF;
     }
+    ScratchArena & scratch = ThreadPool::current_scratch_arena();
+    ScratchArena::Scope const scratch_scope{scratch};
     /// NOTE: Only load the relevant part of the file containing the view of the buffer we actually need.
     ifs.seekg(gltf_buffer_view.byteOffset + accesor.byteOffset + uri.fileByteOffset);
-    std::vector<u16> raw = {};
     auto const elem_byte_size = fastgltf::getElementByteSize(accesor.type, accesor.componentType);
-    raw.resize((accesor.count * elem_byte_size) / 2);
-    /// NOTE: Only load the relevant part of the file containing the view of the buffer we actually need.
-    if (!ifs.read(r_cast<char *>(raw.data()), accesor.count * elem_byte_size))
+    std::span<std::byte> const raw = scratch.allocate_array<std::byte>(accesor.count * elem_byte_size);
+    if (!ifs.read(r_cast<char *>(raw.data()), raw.size()))
     {
         return AssetProcessor::AssetLoadResultCode::ERROR_COULD_NOT_READ_BUFFER_IN_GLTF;
     }
@@ -710,45 +807,48 @@ auto load_accessor_data_from_file(
         ///         Fastgltf expects a ptr to the begin of the buffer, so we just subtract the offsets.
         ///         Fastgltf adds these on in the accessor tool, so in the end it gets the right ptr.
         auto const fastgltf_reverse_byte_offset = (gltf_buffer_view.byteOffset + accesor.byteOffset);
-        return r_cast<std::byte *>(raw.data()) - fastgltf_reverse_byte_offset;
+        return raw.data() - fastgltf_reverse_byte_offset;
     };
 
-    std::vector<ElemT> ret(accesor.count);
     if constexpr (IS_INDEX_BUFFER)
     {
         /// NOTE: Transform the loaded file section into a 32 bit index buffer.
         if (accesor.componentType == fastgltf::ComponentType::UnsignedShort)
         {
-            std::vector<u16> u16_index_buffer(accesor.count);
+            std::span<u16> const u16_index_buffer = scratch.allocate_array<u16>(accesor.count);
             fastgltf::copyFromAccessor<u16>(gltf_asset, accesor, u16_index_buffer.data(), buffer_adapter);
             for (size_t i = 0; i < u16_index_buffer.size(); ++i)
             {
-                ret[i] = s_cast<u32>(u16_index_buffer[i]);
+                dst[i] = s_cast<u32>(u16_index_buffer[i]);
             }
         }
         else
         {
-            fastgltf::copyFromAccessor<u32>(gltf_asset, accesor, ret.data(), buffer_adapter);
+            fastgltf::copyFromAccessor<u32>(gltf_asset, accesor, dst, buffer_adapter);
         }
     }
     else
     {
-        fastgltf::copyFromAccessor<ElemT>(gltf_asset, accesor, ret.data(), buffer_adapter);
+        fastgltf::copyFromAccessor<ElemT>(gltf_asset, accesor, dst, buffer_adapter);
     }
-    return ret;
+    return AssetProcessor::AssetLoadResultCode::SUCCESS;
 }
 
-auto AssetProcessor::load_mesh(LoadMeshInfo const & info) -> AssetLoadResultCode
+auto AssetProcessor::load_mesh(LoadMeshInfo info) -> cinder::task<AssetLoadResultCode>
 {
+    if (info.cancellation.is_cancelled())
+    {
+        co_return AssetProcessor::AssetLoadResultCode::CANCELLED;
+    }
     fastgltf::Asset & gltf_asset = *info.asset;
     fastgltf::Mesh & gltf_mesh = gltf_asset.meshes[info.gltf_mesh_index];
     fastgltf::Primitive & gltf_prim = gltf_mesh.primitives[info.gltf_primitive_index];
 
-/// NOTE: Process indices (they are required)
+/// NOTE: Validate indices (they are required)
 #pragma region INDICES
     if (!gltf_prim.indicesAccessor.has_value())
     {
-        return AssetProcessor::AssetLoadResultCode::ERROR_MISSING_INDEX_BUFFER;
+        co_return AssetProcessor::AssetLoadResultCode::ERROR_MISSING_INDEX_BUFFER;
     }
     fastgltf::Accessor & index_buffer_gltf_accessor = gltf_asset.accessors.at(gltf_prim.indicesAccessor.value());
     bool const index_buffer_accessor_valid =
@@ -758,22 +858,17 @@ auto AssetProcessor::load_mesh(LoadMeshInfo const & info) -> AssetLoadResultCode
         index_buffer_gltf_accessor.bufferViewIndex.has_value();
     if (!index_buffer_accessor_valid)
     {
-        return AssetProcessor::AssetLoadResultCode::ERROR_FAULTY_INDEX_BUFFER_GLTF_ACCESSOR;
+        co_return AssetProcessor::AssetLoadResultCode::ERROR_FAULTY_INDEX_BUFFER_GLTF_ACCESSOR;
     }
-    auto index_buffer_data = load_accessor_data_from_file<u32, true>(std::filesystem::path{info.asset_path}.remove_filename(), gltf_asset, index_buffer_gltf_accessor);
-    if (auto const * err = std::get_if<AssetProcessor::AssetLoadResultCode>(&index_buffer_data))
-    {
-        return *err;
-    }
-    std::vector<u32> index_buffer = std::get<std::vector<u32>>(std::move(index_buffer_data));
+    u32 const index_count = s_cast<u32>(index_buffer_gltf_accessor.count);
 #pragma endregion
 
-/// NOTE: Load vertex positions
+/// NOTE: Validate vertex positions
 #pragma region VERTICES
     auto vert_attrib_iter = gltf_prim.findAttribute(VERT_ATTRIB_POSITION_NAME);
     if (vert_attrib_iter == gltf_prim.attributes.end())
     {
-        return AssetProcessor::AssetLoadResultCode::ERROR_MISSING_VERTEX_POSITIONS;
+        co_return AssetProcessor::AssetLoadResultCode::ERROR_MISSING_VERTEX_POSITIONS;
     }
     fastgltf::Accessor & gltf_vertex_pos_accessor = gltf_asset.accessors.at(vert_attrib_iter->second);
     bool const gltf_vertex_pos_accessor_valid =
@@ -781,58 +876,39 @@ auto AssetProcessor::load_mesh(LoadMeshInfo const & info) -> AssetLoadResultCode
         gltf_vertex_pos_accessor.type == fastgltf::AccessorType::Vec3;
     if (!gltf_vertex_pos_accessor_valid)
     {
-        return AssetProcessor::AssetLoadResultCode::ERROR_FAULTY_GLTF_VERTEX_POSITIONS;
+        co_return AssetProcessor::AssetLoadResultCode::ERROR_FAULTY_GLTF_VERTEX_POSITIONS;
     }
-    // TODO: we can probably load this directly into the staging buffer.
-    auto vertex_pos_result = load_accessor_data_from_file<glm::vec3, false>(std::filesystem::path{info.asset_path}.remove_filename(), gltf_asset, gltf_vertex_pos_accessor);
-    if (auto const * err = std::get_if<AssetProcessor::AssetLoadResultCode>(&vertex_pos_result))
-    {
-        return *err;
-    }
-    std::vector<glm::vec3> vert_positions = std::get<std::vector<glm::vec3>>(std::move(vertex_pos_result));
-    u32 const vertex_count = s_cast<u32>(vert_positions.size());
+    u32 const vertex_count = s_cast<u32>(gltf_vertex_pos_accessor.count);
 #pragma endregion
 
-/// NOTE: Load vertex UVs
+/// NOTE: Validate vertex UVs, they are optional and zeroed when missing
 #pragma region UVS
     auto texcoord0_attrib_iter = gltf_prim.findAttribute(VERT_ATTRIB_TEXCOORD0_NAME);
-    bool has_uv = true;
-    if (texcoord0_attrib_iter == gltf_prim.attributes.end())
-    {
-        has_uv = false;
-        // return AssetProcessor::AssetLoadResultCode::ERROR_MISSING_VERTEX_TEXCOORD_0;
-    }
-    fastgltf::Accessor & gltf_vertex_texcoord0_accessor = gltf_asset.accessors.at(texcoord0_attrib_iter->second);
-    bool const gltf_vertex_texcoord0_accessor_valid =
-        gltf_vertex_texcoord0_accessor.componentType == fastgltf::ComponentType::Float &&
-        gltf_vertex_texcoord0_accessor.type == fastgltf::AccessorType::Vec2;
-    if (!gltf_vertex_texcoord0_accessor_valid && has_uv)
-    {
-        return AssetProcessor::AssetLoadResultCode::ERROR_FAULTY_GLTF_VERTEX_TEXCOORD_0;
-    }
-    std::vector<glm::vec2> vert_texcoord0;
-    if(has_uv)
-    {
-        auto vertex_texcoord0_pos_result = load_accessor_data_from_file<glm::vec2, false>(std::filesystem::path{info.asset_path}.remove_filename(), gltf_asset, gltf_vertex_texcoord0_accessor);
-        if (auto const * err = std::get_if<AssetProcessor::AssetLoadResultCode>(&vertex_texcoord0_pos_result))
+    fastgltf::Accessor * gltf_vertex_texcoord0_accessor = {};
+    if (texcoord0_attrib_iter != gltf_prim.attributes.end())
+    {
+        gltf_vertex_texcoord0_accessor = &gltf_asset.accessors.at(texcoord0_attrib_iter->second);
+        bool const gltf_vertex_texcoord0_accessor_valid =
+            gltf_vertex_texcoord0_accessor->componentType == fastgltf::ComponentType::Float &&
+            gltf_vertex_texcoord0_accessor->type == fastgltf::AccessorType::Vec2;
+        if (!gltf_vertex_texcoord0_accessor_valid)
         {
-            return *err;
+            co_return AssetProcessor::AssetLoadResultCode::ERROR_FAULTY_GLTF_VERTEX_TEXCOORD_0;
+        }
+        // The uvs are decoded straight into staging memory sized for vertex_count elements.
+        if (gltf_vertex_texcoord0_accessor->count != vertex_count)
+        {
+            co_return AssetProcessor::AssetLoadResultCode::ERROR_FAULTY_GLTF_VERTEX_TEXCOORD_0;
         }
-        vert_texcoord0 = std::get<std::vector<glm::vec2>>(std::move(vertex_texcoord0_pos_result));
-    }
-    else
-    {
-        vert_texcoord0 = std::vector<glm::vec2>(vert_positions.size());
     }
-    DBG_ASSERT_TRUE_M(vert_texcoord0.size() == vert_positions.size(), "[AssetProcessor::load_mesh()] Mismatched position and uv count");
 #pragma endregion
 
-/// NOTE: Load vertex normals
+/// NOTE: Validate vertex normals
 #pragma region NORMALS
     auto normals_attrib_iter = gltf_prim.findAttribute(VERT_ATTRIB_NORMAL_NAME);
     if (normals_attrib_iter == gltf_prim.attributes.end())
     {
-        return AssetProcessor::AssetLoadResultCode::ERROR_MISSING_VERTEX_NORMALS;
+        co_return AssetProcessor::AssetLoadResultCode::ERROR_MISSING_VERTEX_NORMALS;
     }
     fastgltf::Accessor & gltf_vertex_normals_accessor = gltf_asset.accessors.at(normals_attrib_iter->second);
     bool const gltf_vertex_normals_accessor_valid =
@@ -840,22 +916,30 @@ auto AssetProcessor::load_mesh(LoadMeshInfo const & info) -> AssetLoadResultCode
         gltf_vertex_normals_accessor.type == fastgltf::AccessorType::Vec3;
     if (!gltf_vertex_normals_accessor_valid)
     {
-        return AssetProcessor::AssetLoadResultCode::ERROR_FAULTY_GLTF_VERTEX_NORMALS;
+        co_return AssetProcessor::AssetLoadResultCode::ERROR_FAULTY_GLTF_VERTEX_NORMALS;
     }
-    auto vertex_normals_pos_result = load_accessor_data_from_file<glm::vec3, false>(std::filesystem::path{info.asset_path}.remove_filename(), gltf_asset, gltf_vertex_normals_accessor);
-    if (auto const * err = std::get_if<AssetProcessor::AssetLoadResultCode>(&vertex_normals_pos_result))
+    if (gltf_vertex_normals_accessor.count != vertex_count)
     {
-        return *err;
+        co_return AssetProcessor::AssetLoadResultCode::ERROR_FAULTY_GLTF_VERTEX_NORMALS;
     }
-    std::vector<glm::vec3> vert_normals = std::get<std::vector<glm::vec3>>(std::move(vertex_normals_pos_result));
-    DBG_ASSERT_TRUE_M(vert_normals.size() == vert_positions.size(), "[AssetProcessor::load_mesh()] Mismatched position and uv count");
 #pragma endregion
 
     u32 const total_mesh_buffer_size =
-        sizeof(daxa_f32vec3) * vert_positions.size() +
-        sizeof(daxa_f32vec2) * vert_texcoord0.size() +
-        sizeof(daxa_f32vec3) * vert_normals.size() + 
-        sizeof(daxa_u32) * index_buffer.size();
+        sizeof(daxa_f32vec3) * vertex_count +
+        sizeof(daxa_f32vec2) * vertex_count +
+        sizeof(daxa_f32vec3) * vertex_count +
+        sizeof(daxa_u32) * index_count;
+
+    StagingBudgetWait const staging_wait = {
+        .budget = _staging_budget.get(),
+        .thread_pool = info.thread_pool,
+        .cancellation = info.cancellation,
+    };
+    std::optional<u64> const reserved_staging_size = co_await reserve_staging_memory(staging_wait, total_mesh_buffer_size);
+    if (!reserved_staging_size.has_value())
+    {
+        co_return AssetProcessor::AssetLoadResultCode::CANCELLED;
+    }
 
     /// NOTE: Fill GPUMesh runtime data
     GPUMesh mesh = {};
@@ -876,87 +960,109 @@ auto AssetProcessor::load_mesh(LoadMeshInfo const & info) -> AssetLoadResultCode
         });
     }
     auto staging_ptr = _device.get_host_address(staging_buffer).value();
+    auto const discard_buffers = [&]()
+    {
+        _device.destroy_buffer(staging_buffer);
+        _device.destroy_buffer(std::bit_cast<daxa::BufferId>(mesh.mesh_buffer));
+        release_staging_memory(staging_wait, reserved_staging_size.value());
+    };
+
+    /// NOTE: The accessor data is read from disk on the io lane and decoded straight into the staging memory.
+    if (info.thread_pool != nullptr) { co_await cinder::resume_on_io(*info.thread_pool); }
+    if (info.cancellation.is_cancelled())
+    {
+        discard_buffers();
+        co_return AssetProcessor::AssetLoadResultCode::CANCELLED;
+    }
+    std::filesystem::path const root_path = std::filesystem::path{info.asset_path}.remove_filename();
 
     u32 accumulated_offset = 0;
     // ---
     mesh.vertex_positions = mesh_bda + accumulated_offset;
-    std::memcpy(
-        staging_ptr + accumulated_offset,
-        vert_positions.data(),
-        vert_positions.size() * sizeof(daxa_f32vec3));
-    accumulated_offset += sizeof(daxa_f32vec3) * vert_positions.size();
+    AssetLoadResultCode result = read_accessor_into<glm::vec3, false>(root_path, gltf_asset, gltf_vertex_pos_accessor, r_cast<glm::vec3 *>(staging_ptr + accumulated_offset));
+    accumulated_offset += sizeof(daxa_f32vec3) * vertex_count;
     // ---
     mesh.vertex_uvs = mesh_bda + accumulated_offset;
-    std::memcpy(
-        staging_ptr + accumulated_offset,
-        vert_texcoord0.data(),
-        vert_texcoord0.size() * sizeof(daxa_f32vec2));
-    accumulated_offset += sizeof(daxa_f32vec2) * vert_texcoord0.size();
+    if (result == AssetLoadResultCode::SUCCESS)
+    {
+        if (gltf_vertex_texcoord0_accessor != nullptr)
+        {
+            result = read_accessor_into<glm::vec2, false>(root_path, gltf_asset, *gltf_vertex_texcoord0_accessor, r_cast<glm::vec2 *>(staging_ptr + accumulated_offset));
+        }
+        else
+        {
+            std::memset(staging_ptr + accumulated_offset, 0, sizeof(daxa_f32vec2) * vertex_count);
+        }
+    }
+    accumulated_offset += sizeof(daxa_f32vec2) * vertex_count;
     // ---
     mesh.vertex_normals = mesh_bda + accumulated_offset;
-    std::memcpy(
-        staging_ptr + accumulated_offset,
-        vert_normals.data(),
-        vert_normals.size() * sizeof(daxa_f32vec3));
-    accumulated_offset += sizeof(daxa_f32vec3) * vert_normals.size();
+    if (result == AssetLoadResultCode::SUCCESS)
+    {
+        result = read_accessor_into<glm::vec3, false>(root_path, gltf_asset, gltf_vertex_normals_accessor, r_cast<glm::vec3 *>(staging_ptr + accumulated_offset));
+    }
+    accumulated_offset += sizeof(daxa_f32vec3) * vertex_count;
     // ---
     mesh.indices = mesh_bda + accumulated_offset;
-    std::memcpy(
-        staging_ptr + accumulated_offset,
-        index_buffer.data(),
-        index_buffer.size() * sizeof(daxa_u32));
-    accumulated_offset += sizeof(daxa_u32) * index_buffer.size();
+    if (result == AssetLoadResultCode::SUCCESS)
+    {
+        result = read_accessor_into<u32, true>(root_path, gltf_asset, index_buffer_gltf_accessor, r_cast<u32 *>(staging_ptr + accumulated_offset));
+    }
+    accumulated_offset += sizeof(daxa_u32) * index_count;
+    /// NOTE: Don't keep the io lane busy with whatever awaits this load.
+    if (info.thread_pool != nullptr) { co_await cinder::resume_on(*info.thread_pool); }
+    if (result != AssetLoadResultCode::SUCCESS)
+    {
+        discard_buffers();
+        co_return result;
+    }
     mesh.material_index = info.material_manifest_index;
     mesh.vertex_count = vertex_count;
-    mesh.index_count = s_cast<u32>(index_buffer.size());
+    mesh.index_count = index_count;
 
-    /// NOTE: Append the processed mesh to the upload queue.
-    {
-        std::lock_guard<std::mutex> lock{*_mesh_upload_mutex};
-        _upload_mesh_queue.push_back(MeshUploadInfo{
-            .staging_buffer = staging_buffer,
-            .mesh_buffer = std::bit_cast<daxa::BufferId>(mesh.mesh_buffer),
-            .mesh = mesh,
-            .manifest_index = info.manifest_index});
-    }
-    return AssetProcessor::AssetLoadResultCode::SUCCESS;
+    /// NOTE: Hand the processed mesh over to the upload.
+    queue_mesh_upload(info.main_thread, MeshUploadInfo{
+        .staging_buffer = staging_buffer,
+        .mesh_buffer = std::bit_cast<daxa::BufferId>(mesh.mesh_buffer),
+        .mesh = mesh,
+        .manifest_index = info.manifest_index,
+        .reserved_staging_size = reserved_staging_size.value()});
+    co_return AssetProcessor::AssetLoadResultCode::SUCCESS;
 }
 
-auto AssetProcessor::record_gpu_load_processing_commands() -> RecordCommandsRet
+#pragma region RECORD_UPLOAD_COMMANDS
+// Copies from the staging buffers into the mesh buffers, returns the staging memory that can be released.
+// The barrier making the copies visible is recorded once for the whole frame.
+static auto record_mesh_upload_commands(
+    daxa::Device & device,
+    daxa::CommandRecorder & recorder,
+    std::span<AssetProcessor::MeshUploadInfo const> mesh_uploads) -> u64
 {
-    RecordCommandsRet ret = {};
-    {
-        std::lock_guard<std::mutex> lock{*_mesh_upload_mutex};
-        ret.uploaded_meshes = std::move(_upload_mesh_queue);
-        _upload_mesh_queue = {};
-    }
-    auto recorder = _device.create_command_recorder({});
-#pragma region RECORD_MESH_UPLOAD_COMMANDS
-    for (MeshUploadInfo & mesh_upload : ret.uploaded_meshes)
+    u64 staging_memory_released = {};
+    for (AssetProcessor::MeshUploadInfo const & mesh_upload : mesh_uploads)
     {
         /// NOTE: copy from staging buffer to buffer and delete staging memory.
         recorder.copy_buffer_to_buffer({
             .src_buffer = mesh_upload.staging_buffer,
             .dst_buffer = mesh_upload.mesh_buffer,
-            .size = _device.info_buffer(mesh_upload.mesh_buffer).value().size,
+            .size = device.info_buffer(mesh_upload.mesh_buffer).value().size,
         });
         recorder.destroy_buffer_deferred(mesh_upload.staging_buffer);
+        staging_memory_released += mesh_upload.reserved_staging_size;
     }
-    recorder.pipeline_barrier({
-        .src_access = daxa::AccessConsts::TRANSFER_WRITE,
-        .dst_access = daxa::AccessConsts::READ_WRITE,
-    });
-#pragma endregion
+    return staging_memory_released;
+}
 
-#pragma region RECORD_TEXTURE_UPLOAD_COMMANDS
-    {
-        std::lock_guard<std::mutex> lock{*_texture_upload_mutex};
-        ret.uploaded_textures = std::move(_upload_texture_queue);
-        _upload_texture_queue = {};
-    }
-    for (LoadedTextureInfo const & texture_upload : ret.uploaded_textures)
+// Transitions, fills and transitions back the images, returns the staging memory that can be released.
+static auto record_texture_upload_commands(
+    daxa::Device & device,
+    daxa::CommandRecorder & recorder,
+    std::span<AssetProcessor::LoadedTextureInfo const> texture_uploads) -> u64
+{
+    u64 staging_memory_released = {};
+    for (AssetProcessor::LoadedTextureInfo const & texture_upload : texture_uploads)
     {
-        daxa::ImageViewInfo image_view_info = _device.info_image_view(texture_upload.dst_image.default_view()).value();
+        daxa::ImageViewInfo image_view_info = device.info_image_view(texture_upload.dst_image.default_view()).value();
         /// TODO: If we are generating mips this will need to change
         recorder.pipeline_barrier_image_transition({
             .dst_access = daxa::AccessConsts::TRANSFER_WRITE,
@@ -965,9 +1071,9 @@ auto AssetProcessor::record_gpu_load_processing_commands() -> RecordCommandsRet
             .image_id = texture_upload.dst_image,
         });
     }
-    for (LoadedTextureInfo const & texture_upload : ret.uploaded_textures)
+    for (AssetProcessor::LoadedTextureInfo const & texture_upload : texture_uploads)
     {
-        daxa::ImageInfo image_info = _device.info_image(texture_upload.dst_image).value();
+        daxa::ImageInfo image_info = device.info_image(texture_upload.dst_image).value();
         for (u32 mip = 0; mip < texture_upload.mips_to_copy; ++mip)
         {
             u32 width = std::max(1u, image_info.size.x >> mip);
@@ -985,8 +1091,9 @@ auto AssetProcessor::record_gpu_load_processing_commands() -> RecordCommandsRet
             });
         }
         recorder.destroy_buffer_deferred(texture_upload.staging_buffer);
+        staging_memory_released += texture_upload.reserved_staging_size;
     }
-    for (LoadedTextureInfo const & texture_upload : ret.uploaded_textures)
+    for (AssetProcessor::LoadedTextureInfo const & texture_upload : texture_uploads)
     {
         recorder.pipeline_barrier_image_transition({
             .src_access = daxa::AccessConsts::TRANSFER_WRITE,
@@ -996,7 +1103,94 @@ auto AssetProcessor::record_gpu_load_processing_commands() -> RecordCommandsRet
             .image_id = texture_upload.dst_image,
         });
     }
+    return staging_memory_released;
+}
 #pragma endregion
+
+auto AssetProcessor::main_thread_upload_recorder() -> daxa::CommandRecorder &
+{
+    if (!_main_thread_upload_recorder.has_value())
+    {
+        _main_thread_upload_recorder.emplace(_device.create_command_recorder({}));
+    }
+    return _main_thread_upload_recorder.value();
+}
+
+void AssetProcessor::queue_mesh_upload(MainThreadExecutor * main_thread, MeshUploadInfo const & upload)
+{
+    if (main_thread == nullptr)
+    {
+        std::lock_guard<std::mutex> lock{*_mesh_upload_mutex};
+        _upload_mesh_queue.push_back(upload);
+        return;
+    }
+    /// NOTE: Recording is the part of the upload that scales with the number of finished loads, doing it in the follow up
+    //        lets the frame budget of the main thread executor decide how many uploads make it into a frame.
+    main_thread->post([this, upload]
+        {
+            record_mesh_upload_commands(_device, main_thread_upload_recorder(), std::span<MeshUploadInfo const>{&upload, 1});
+            _main_thread_uploaded_meshes.push_back(upload);
+        });
+}
+
+void AssetProcessor::queue_texture_uploads(MainThreadExecutor * main_thread, std::span<LoadedTextureInfo const> uploads)
+{
+    if (main_thread == nullptr)
+    {
+        std::lock_guard<std::mutex> lock{*_texture_upload_mutex};
+        _upload_texture_queue.insert(_upload_texture_queue.end(), uploads.begin(), uploads.end());
+        return;
+    }
+    main_thread->post([this, uploads = std::vector<LoadedTextureInfo>(uploads.begin(), uploads.end())]
+        {
+            record_texture_upload_commands(_device, main_thread_upload_recorder(), uploads);
+            _main_thread_uploaded_textures.insert(_main_thread_uploaded_textures.end(), uploads.begin(), uploads.end());
+        });
+}
+
+auto AssetProcessor::record_gpu_load_processing_commands() -> RecordCommandsRet
+{
+    RecordCommandsRet ret = {};
+    {
+        std::lock_guard<std::mutex> lock{*_mesh_upload_mutex};
+        ret.uploaded_meshes = std::move(_upload_mesh_queue);
+        _upload_mesh_queue = {};
+    }
+    {
+        std::lock_guard<std::mutex> lock{*_texture_upload_mutex};
+        ret.uploaded_textures = std::move(_upload_texture_queue);
+        _upload_texture_queue = {};
+    }
+    /// NOTE: Continue the recorder the main thread follow ups recorded into, the queued uploads are appended to it.
+    daxa::CommandRecorder recorder = std::move(main_thread_upload_recorder());
+    _main_thread_upload_recorder.reset();
+    u64 staging_memory_released = {};
+    staging_memory_released += record_mesh_upload_commands(_device, recorder, ret.uploaded_meshes);
+    staging_memory_released += record_texture_upload_commands(_device, recorder, ret.uploaded_textures);
+    for (MeshUploadInfo const & mesh_upload : _main_thread_uploaded_meshes)
+    {
+        staging_memory_released += mesh_upload.reserved_staging_size;
+    }
+    for (LoadedTextureInfo const & texture_upload : _main_thread_uploaded_textures)
+    {
+        staging_memory_released += texture_upload.reserved_staging_size;
+    }
+    ret.uploaded_meshes.insert(ret.uploaded_meshes.end(), _main_thread_uploaded_meshes.begin(), _main_thread_uploaded_meshes.end());
+    ret.uploaded_textures.insert(ret.uploaded_textures.end(), _main_thread_uploaded_textures.begin(), _main_thread_uploaded_textures.end());
+    _main_thread_uploaded_meshes.clear();
+    _main_thread_uploaded_textures.clear();
+    recorder.pipeline_barrier({
+        .src_access = daxa::AccessConsts::TRANSFER_WRITE,
+        .dst_access = daxa::AccessConsts::READ_WRITE,
+    });
+    /// NOTE: The staging buffers are only freed once the gpu is done with the copies. Releasing the budget at record time
+    //        lets waiting loads start preparing their data, the overshoot is bounded by the loads of the frames in flight.
+    if (staging_memory_released != 0) { _staging_budget->release(staging_memory_released); }
     ret.upload_commands = recorder.complete_current_commands();
     return ret;
-}
\ No newline at end of file
+}
+
+void AssetProcessor::abandon_suspended_loads()
+{
+    _staging_budget->abandon_waiters();
+}
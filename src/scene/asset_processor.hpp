@@ -6,6 +6,8 @@
 #include <mutex>
 
 #include "../cinder.hpp"
+#include "../multithreading/coroutine.hpp"
+#include "../multithreading/main_thread_executor.hpp"
 #include "../shader_shared/geometry.inl"
 #include <ktx.h>
 
@@ -23,6 +25,14 @@ enum struct TextureMaterialType
     ROUGHNESS_METALNESS,
 };
 
+struct ImageFromRawInfo
+{
+    std::vector<std::byte> raw_data;
+    std::filesystem::path image_path;
+    fastgltf::MimeType mime_type;
+    int ktx_compression = KTX_TTF_BC7_RGBA;
+};
+
 struct AssetProcessor
 {
     enum struct AssetLoadResultCode
@@ -50,6 +60,8 @@ struct AssetProcessor
         ERROR_MISSING_VERTEX_TANGENTS,
         ERROR_FAULTY_GLTF_VERTEX_TANGENTS,
         ERROR_FAILED_TO_PROCESS_KTX,
+        // Not an error, the load was cancelled and released everything it held.
+        CANCELLED,
     };
     static auto to_string(AssetLoadResultCode code) -> std::string_view
     {
@@ -77,6 +89,8 @@ struct AssetProcessor
             case AssetLoadResultCode::ERROR_FAULTY_GLTF_VERTEX_NORMALS: return "ERROR_FAULTY_GLTF_VERTEX_NORMALS"; 
             case AssetLoadResultCode::ERROR_MISSING_VERTEX_TANGENTS: return "ERROR_MISSING_VERTEX_TANGENTS"; 
             case AssetLoadResultCode::ERROR_FAULTY_GLTF_VERTEX_TANGENTS: return "ERROR_FAULTY_GLTF_VERTEX_TANGENTS"; 
+            case AssetLoadResultCode::ERROR_FAILED_TO_PROCESS_KTX: return "ERROR_FAILED_TO_PROCESS_KTX"; 
+            case AssetLoadResultCode::CANCELLED: return "CANCELLED"; 
             default: return "UNKNOWN";
         }
     }
@@ -100,6 +114,7 @@ struct AssetProcessor
         u32 texture_manifest_index = {};
         bool secondary_texture = {};
         bool compressed_bc5_rg = {};
+        u64 reserved_staging_size = {};
     };
     struct LoadTextureInfo
     {
@@ -109,8 +124,36 @@ struct AssetProcessor
         u32 gltf_image_index = {};
         u32 texture_manifest_index = {};
         TextureMaterialType texture_material_type = {};
+        // Pool the load continues on after switching between io and processing or after waiting for staging memory.
+        // Without a pool nothing suspends and the load runs synchronously (cinder::sync_wait).
+        ThreadPool * thread_pool = {};
+        // Checked after reading, after decoding and before allocating staging memory.
+        CancellationToken cancellation = {};
+        // The upload of the finished texture is recorded by a follow up posted here.
+        // Without an executor the texture is appended to the upload queue right away.
+        MainThreadExecutor * main_thread = {};
     };
-    auto load_texture(LoadTextureInfo const & info) -> AssetLoadResultCode;
+    /**
+     * NOTE:
+     * Coroutine reading the texture on the io lane and processing it on the workers.
+     * Suspends instead of blocking a worker while the staging memory budget is exhausted.
+     * A cancelled load frees its staging memory and images and never reaches the upload queue.
+     * THREADSAFETY:
+     * * internally synchronized, can be called on multiple threads in parallel.
+     */
+    auto load_texture(LoadTextureInfo info) -> cinder::task<AssetLoadResultCode>;
+
+    /**
+     * NOTE:
+     * The two stages of load_texture:
+     * 1. read_texture only reads the raw image data from disk
+     * 2. process_texture decodes/transcodes the raw data, fills the staging memory and appends the texture to the upload queue
+     * THREADSAFETY:
+     * * internally synchronized, can be called on multiple threads in parallel.
+     */
+    using ReadTextureRet = std::variant<AssetLoadResultCode, ImageFromRawInfo>;
+    auto read_texture(LoadTextureInfo const & info) -> ReadTextureRet;
+    auto process_texture(LoadTextureInfo info, ImageFromRawInfo raw_image_data) -> cinder::task<AssetLoadResultCode>;
 
     struct MeshUploadInfo
     {
@@ -120,6 +163,7 @@ struct AssetProcessor
 
         GPUMesh mesh = {};
         u32 manifest_index = {};
+        u64 reserved_staging_size = {};
     };
     struct LoadMeshInfo
     {
@@ -132,12 +176,21 @@ struct AssetProcessor
         // MUST BE VALID MATERIAL INDEX
         // REPLACE WITH DEFAULT MATERIAL BEFORE PASSING INDEX HERE!
         u32 material_manifest_index = {};
+        // Same as LoadTextureInfo::thread_pool.
+        ThreadPool * thread_pool = {};
+        // Checked after reading and before allocating staging memory.
+        CancellationToken cancellation = {};
+        // Same as LoadTextureInfo::main_thread.
+        MainThreadExecutor * main_thread = {};
     };
     /**
+     * NOTE:
+     * Coroutine, reads the mesh on the io lane and waits for the staging memory budget before allocating.
+     * A cancelled load frees its staging memory and never reaches the upload queue.
      * THREADSAFETY:
      * * internally synchronized, can be called on multiple threads in parallel.
      */
-    auto load_mesh(LoadMeshInfo const & info) -> AssetLoadResultCode;
+    auto load_mesh(LoadMeshInfo info) -> cinder::task<AssetLoadResultCode>;
 
     /**
      * NOTE:
@@ -148,11 +201,14 @@ struct AssetProcessor
      * 2. process the mesh and texture data
      * 3. upadte the mesh and texture manifest on the gpu
      * 4. memory barrier all following read commands on the queue
+     * Uploads of loads with a main thread executor were already recorded by their follow ups, they are appended to
+     * the returned commands and infos. Loads whose follow ups did not fit into the frame budget yet are not part of it.
      * THREADSAFETY:
      * * internally synchronized, can be called on multiple threads in parallel
      * * fully blocks, it makes no sense to parallelize this function
      * * optimally called once a frame
      * * should not be called in parallel with load_texture and load_mesh
+     * * must be called on the thread draining the main thread executor the loads post to
      */
     struct RecordCommandsRet
     {
@@ -162,11 +218,24 @@ struct AssetProcessor
     };
     auto record_gpu_load_processing_commands() -> RecordCommandsRet;
 
+    /**
+     * NOTE:
+     * Drops the loads suspended on the staging memory budget, they are never resumed.
+     * Must be called after the ThreadPool the loads were running on is destroyed and before the final upload flush.
+     */
+    void abandon_suspended_loads();
+
   private:
+    void queue_mesh_upload(MainThreadExecutor * main_thread, MeshUploadInfo const & upload);
+    void queue_texture_uploads(MainThreadExecutor * main_thread, std::span<LoadedTextureInfo const> uploads);
+    auto main_thread_upload_recorder() -> daxa::CommandRecorder &;
+
     static inline std::string const VERT_ATTRIB_POSITION_NAME = "POSITION";
     static inline std::string const VERT_ATTRIB_TEXCOORD0_NAME = "TEXCOORD_0";
     static inline std::string const VERT_ATTRIB_NORMAL_NAME = "NORMAL";
     static inline std::string const VERT_ATTRIB_TANGENT_NAME = "TANGENT";
+    // Staging memory the in flight loads may hold before they have to wait for uploads to be recorded.
+    static constexpr u64 STAGING_MEMORY_BUDGET = 512ull * 1024ull * 1024ull;
 
     daxa::Device _device = {};
     // TODO: Replace with lockless queue.
@@ -174,4 +243,10 @@ struct AssetProcessor
     std::vector<LoadedTextureInfo> _upload_texture_queue = {};
     std::unique_ptr<std::mutex> _mesh_upload_mutex = std::make_unique<std::mutex>();
     std::unique_ptr<std::mutex> _texture_upload_mutex = std::make_unique<std::mutex>();
+    std::unique_ptr<cinder::AsyncBudget> _staging_budget = {};
+    // Uploads recorded by main thread follow ups since the last record_gpu_load_processing_commands.
+    // Only touched by the main thread, no lock needed.
+    std::optional<daxa::CommandRecorder> _main_thread_upload_recorder = {};
+    std::vector<MeshUploadInfo> _main_thread_uploaded_meshes = {};
+    std::vector<LoadedTextureInfo> _main_thread_uploaded_textures = {};
 };
\ No newline at end of file
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "../cinder.hpp"
+#include "../affine_simd.hpp"
+#include "../slot_map.hpp"
+#include "../multithreading/thread_pool.hpp"
+#include "render_entity_soa.hpp"
+#include "transform_hierarchy.hpp"
+using namespace cinder::types;
+
+/**
+ * DESCRIPTION:
+ * Entity transform updates, shared by the Scene and the entity transform update bench.
+ * Entities are stored in a DenseSlotMap, EntityT needs the members
+ *   cinder::Trs local_transform, glm::mat4x3 transform, glm::mat4x3 combined_transform, std::optional<Id> parent.
+ * Setting transforms only writes the TRS and marks the entities dirty in the slot map. The update builds the local
+ * matrices of dirty entities, propagates the combined transforms of their subtrees and writes them into the packed arrays.
+ * NOTES:
+ * - Every entity changed since the last update is processed once, no matter how often it was set
+ * - The dirty set of the slot map is left alone, the caller clears it once everything that reads it is done
+ * THREADSAFETY:
+ * * not synchronized, the update uses the thread pool internally
+ */
+enum struct SetTransformsErrorCode
+{
+    SIZE_MISMATCH,
+    INVALID_ENTITY_ID,
+};
+
+template <typename IdT>
+struct ModifiedEntityTransform
+{
+    IdT entity = {};
+    glm::mat4x4 prev_transform = {};
+    glm::mat4x4 curr_transform = {};
+};
+
+template <typename EntityT>
+struct EntityTransformUpdateInfo
+{
+    cinder::DenseSlotMap<EntityT> & entities;
+    TransformHierarchy & hierarchy;
+    RenderEntitySoA & soa;
+    // Local matrices and propagation run in parallel on it, everything runs on the calling thread when null.
+    ThreadPool * thread_pool = {};
+};
+
+template <typename EntityT>
+auto entity_parent_slot_index(EntityT const & entity) -> u32
+{
+    return entity.parent.has_value() ? entity.parent->index : TransformHierarchy::INVALID_INDEX;
+}
+
+// Sets the local transforms of entities, transforms[i] belongs to ids[i].
+// All ids are validated before anything is written, a batch containing an invalid id changes nothing.
+template <typename EntityT>
+auto set_entity_transforms(
+    cinder::DenseSlotMap<EntityT> & entities,
+    std::span<typename cinder::DenseSlotMap<EntityT>::Id const> ids,
+    std::span<cinder::Trs const> transforms) -> std::optional<SetTransformsErrorCode>
+{
+    if (ids.size() != transforms.size())
+    {
+        return SetTransformsErrorCode::SIZE_MISMATCH;
+    }
+    for (auto const id : ids)
+    {
+        if (!entities.is_id_valid(id))
+        {
+            return SetTransformsErrorCode::INVALID_ENTITY_ID;
+        }
+    }
+    /// NOTE: Only the TRS is written here. Matrices are built once per dirty entity by the update,
+    //        no matter how often an entity is set in between.
+    for (usize i = 0; i < ids.size(); ++i)
+    {
+        entities.slot_by_index(ids[i].index)->local_transform = transforms[i];
+        entities.mark_dirty(ids[i]);
+    }
+    return std::nullopt;
+}
+
+// Call after creating, destroying or reparenting entities, before the next update.
+template <typename EntityT>
+void rebuild_transform_hierarchy(cinder::DenseSlotMap<EntityT> const & entities, TransformHierarchy & hierarchy)
+{
+    std::vector<TransformHierarchy::Node> hierarchy_nodes = {};
+    hierarchy_nodes.reserve(entities.size());
+    for (usize dense_index = 0; dense_index < entities.size(); ++dense_index)
+    {
+        hierarchy_nodes.push_back({
+            .slot_index = entities.id_by_dense_index(dense_index).index,
+            .parent_slot_index = entity_parent_slot_index(entities.values()[dense_index]),
+        });
+    }
+    hierarchy.rebuild(hierarchy_nodes);
+}
+
+// Builds the local matrices of the entities dirty in the slot map and marks their subtrees dirty in the hierarchy.
+template <typename EntityT>
+void build_local_transforms(EntityTransformUpdateInfo<EntityT> const & info)
+{
+    /// NOTE: Marking an entity marks its whole subtree, its children move with it.
+    std::vector<u32> changed_slots = {};
+    changed_slots.reserve(info.entities.dirty_count());
+    info.entities.for_each_dirty([&](auto id)
+        {
+            info.hierarchy.mark_dirty(id.index);
+            changed_slots.push_back(id.index); });
+    /// NOTE: Local matrices are only built for entities whose own TRS changed.
+    //        Children of a moved entity keep theirs, propagation only recomputes their combined transforms.
+    auto build_local_transform = [&](u32 changed_index)
+    {
+        if (EntityT * entity = info.entities.slot_by_index(changed_slots[changed_index]))
+        {
+            entity->transform = cinder::affine::from_trs(entity->local_transform);
+        }
+    };
+    if (info.thread_pool != nullptr)
+    {
+        info.thread_pool->parallel_for({0, s_cast<u32>(changed_slots.size())}, build_local_transform, 1024, TaskPriority::CRITICAL);
+    }
+    else
+    {
+        for (u32 changed_index = 0; changed_index < changed_slots.size(); ++changed_index)
+        {
+            build_local_transform(changed_index);
+        }
+    }
+}
+
+// Propagates the combined transforms of the dirty subtrees of the hierarchy and writes the entities into the packed arrays.
+// modified_entities is refilled with the entities that were in the packed arrays before, with their combined transforms
+// before and after the update. write_packed(u32 dense_index, EntityT const & entity) writes the remaining packed
+// elements of the caller, it is called concurrently for different entities.
+template <typename EntityT, typename WritePackedFnT>
+void propagate_entity_transforms(
+    EntityTransformUpdateInfo<EntityT> const & info,
+    std::vector<ModifiedEntityTransform<typename cinder::DenseSlotMap<EntityT>::Id>> & modified_entities,
+    WritePackedFnT && write_packed)
+{
+    u32 const target_task_count = info.thread_pool != nullptr ? info.thread_pool->thread_count() * 4 : 1;
+    TransformHierarchy::PropagationWork const propagation_work = info.hierarchy.take_dirty_work(target_task_count);
+    // Places new entities into the packed arrays, changes their layout so it can not run in parallel.
+    // Entities already in the packed arrays existed before this update, their previous combined transform is recorded.
+    modified_entities.clear();
+    info.hierarchy.for_each_entity(propagation_work, [&](u32 slot_index, u32)
+        {
+            if (info.soa.dense_index(slot_index) != RenderEntitySoA::INVALID_INDEX)
+            {
+                modified_entities.push_back({
+                    .entity = info.entities.id_by_index(slot_index),
+                    .prev_transform = glm::mat4x4(info.entities.slot_by_index(slot_index)->combined_transform),
+                });
+            }
+            info.soa.prepare_write(slot_index); });
+
+    /// NOTE: Parents are propagated before their children, every combined transform is computed once
+    //        from the cached combined transform of the parent. Results go straight into the packed arrays,
+    //        each entity only writes its own elements, so independent subtrees run in parallel.
+    auto update_entity = [&](u32 slot_index, u32 parent_slot_index)
+    {
+        EntityT * entity = info.entities.slot_by_index(slot_index);
+        entity->combined_transform = entity->transform;
+        if (parent_slot_index != TransformHierarchy::INVALID_INDEX)
+        {
+            entity->combined_transform = cinder::affine::compose(info.entities.slot_by_index(parent_slot_index)->combined_transform, entity->transform);
+        }
+        u32 const dense_index = info.soa.dense_index(slot_index);
+        info.soa.transforms[dense_index] = entity->transform;
+        info.soa.combined_transforms[dense_index] = entity->combined_transform;
+        info.soa.parents[dense_index] = entity_parent_slot_index(*entity);
+        write_packed(dense_index, std::as_const(*entity));
+    };
+    if (info.thread_pool != nullptr)
+    {
+        info.hierarchy.propagate(propagation_work, *info.thread_pool, update_entity);
+    }
+    else
+    {
+        info.hierarchy.for_each_entity(propagation_work, update_entity);
+    }
+    for (auto & modified_entity : modified_entities)
+    {
+        modified_entity.curr_transform = glm::mat4x4(info.entities.slot_by_index(modified_entity.entity.index)->combined_transform);
+    }
+}
@@ -0,0 +1,93 @@
+#include "render_entity_soa.hpp"
+
+#include "../shader_shared/geometry.inl"
+
+auto RenderEntitySoA::prepare_write(u32 slot_index) -> u32
+{
+    if (slot_index >= slot_to_dense.size())
+    {
+        slot_to_dense.resize(slot_index + 1, INVALID_INDEX);
+    }
+    u32 dense_index = slot_to_dense[slot_index];
+    if (dense_index == INVALID_INDEX)
+    {
+        dense_index = size();
+        transforms.push_back(glm::mat4x3(glm::identity<glm::mat4x3>()));
+        combined_transforms.push_back(glm::mat4x3(glm::identity<glm::mat4x3>()));
+        parents.push_back(INVALID_INDEX);
+        mesh_groups.push_back(INVALID_MANIFEST_INDEX);
+        dense_to_slot.push_back(slot_index);
+        slot_to_dense[slot_index] = dense_index;
+        dirty_slots.resize(slot_to_dense.size());
+        dirty_slots.mark(slot_index);
+        dirty_dense.resize(size());
+    }
+    dirty_dense.mark(dense_index);
+    return dense_index;
+}
+
+void RenderEntitySoA::remove(u32 slot_index)
+{
+    u32 const dense_index = this->dense_index(slot_index);
+    if (dense_index == INVALID_INDEX)
+    {
+        return;
+    }
+    u32 const last_dense_index = size() - 1;
+    /// NOTE: Swap remove, the last entity moves into the hole so the arrays stay packed.
+    if (dense_index != last_dense_index)
+    {
+        transforms[dense_index] = transforms[last_dense_index];
+        combined_transforms[dense_index] = combined_transforms[last_dense_index];
+        parents[dense_index] = parents[last_dense_index];
+        mesh_groups[dense_index] = mesh_groups[last_dense_index];
+        dense_to_slot[dense_index] = dense_to_slot[last_dense_index];
+        slot_to_dense[dense_to_slot[dense_index]] = dense_index;
+        dirty_dense.mark(dense_index);
+        dirty_slots.mark(dense_to_slot[dense_index]);
+    }
+    transforms.pop_back();
+    combined_transforms.pop_back();
+    parents.pop_back();
+    mesh_groups.pop_back();
+    dense_to_slot.pop_back();
+    slot_to_dense[slot_index] = INVALID_INDEX;
+    dirty_slots.mark(slot_index);
+    /// NOTE: The removed tail is past the end of the packed arrays and is not uploaded anymore.
+    dirty_dense.unmark(last_dense_index);
+}
+
+auto RenderEntitySoA::dense_index(u32 slot_index) const -> u32
+{
+    return slot_index < slot_to_dense.size() ? slot_to_dense[slot_index] : INVALID_INDEX;
+}
+
+auto RenderEntitySoA::size() const -> u32
+{
+    return s_cast<u32>(dense_to_slot.size());
+}
+
+void RenderEntitySoA::clear_dirty()
+{
+    dirty_dense.clear();
+    dirty_slots.clear();
+}
+
+static auto plan_tracked_upload(cinder::SlotChangeTracker const & tracker, UploadPlanInfo const & info) -> UploadPlan
+{
+    std::vector<u32> dirty_indices = {};
+    dirty_indices.reserve(tracker.dirty_count());
+    tracker.for_each_dirty([&](u32 index)
+        { dirty_indices.push_back(index); });
+    return plan_uploads(dirty_indices, info);
+}
+
+auto RenderEntitySoA::plan_dense_upload(UploadPlanInfo const & info) const -> UploadPlan
+{
+    return plan_tracked_upload(dirty_dense, info);
+}
+
+auto RenderEntitySoA::plan_slot_upload(UploadPlanInfo const & info) const -> UploadPlan
+{
+    return plan_tracked_upload(dirty_slots, info);
+}
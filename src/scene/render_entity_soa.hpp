@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "../cinder.hpp"
+#include "../slot_change_tracker.hpp"
+#include "upload_plan.hpp"
+using namespace cinder::types;
+
+/**
+ * DESCRIPTION:
+ * Packed structure of arrays of the render entity data the gpu reads, a mirror of the entity slot map.
+ * The arrays are uploaded as they are, the gpu buffers hold the same packed layout.
+ * NOTES:
+ * - Element i of every packed array belongs to the entity in slot dense_to_slot[i], slot_to_dense is the way back.
+ *   Together they are a sparse set, the gpu iterates [0, size()) tightly and looks entities up through slot_to_dense
+ * - Removing swap removes, the last entity moves into the hole
+ * - Writes are tracked per element, for the packed arrays and for slot_to_dense. plan_dense_upload and plan_slot_upload
+ *   coalesce them into few copies plus one scatter, see upload_plan.hpp. Uploads only touch changed entities, no
+ *   matter how far apart they are in the arrays
+ * - prepare_write changes the layout and the dirty sets and has to be called serially. Writing the packed
+ *   elements of different entities afterwards is thread safe
+ * THREADSAFETY:
+ * * not synchronized, see NOTES
+ */
+struct RenderEntitySoA
+{
+    static constexpr u32 INVALID_INDEX = ~0u;
+
+    // Packed, indexed by dense index.
+    std::vector<glm::mat4x3> transforms = {};
+    std::vector<glm::mat4x3> combined_transforms = {};
+    // Slot index of the parent entity, INVALID_INDEX for entities without parent.
+    std::vector<u32> parents = {};
+    // INVALID_MANIFEST_INDEX for entities without mesh group.
+    std::vector<u32> mesh_groups = {};
+    std::vector<u32> dense_to_slot = {};
+    // Indexed by slot index, INVALID_INDEX for slots without an entity.
+    std::vector<u32> slot_to_dense = {};
+
+    cinder::SlotChangeTracker dirty_dense = {};
+    cinder::SlotChangeTracker dirty_slots = {};
+
+    // Adds the entity if it is not in the arrays yet and marks its packed elements dirty. Returns its dense index.
+    auto prepare_write(u32 slot_index) -> u32;
+    void remove(u32 slot_index);
+    auto dense_index(u32 slot_index) const -> u32;
+    auto size() const -> u32;
+    void clear_dirty();
+    // Plans for the dirty elements, one plan over all packed arrays and one over slot_to_dense.
+    auto plan_dense_upload(UploadPlanInfo const & info = {}) const -> UploadPlan;
+    auto plan_slot_upload(UploadPlanInfo const & info = {}) const -> UploadPlan;
+    // Element sizes of one packed entity and one slot_to_dense entry, the per entity cost of an upload.
+    static constexpr usize PACKED_ENTITY_SIZE = sizeof(glm::mat4x3) * 2 + sizeof(u32) * 3;
+    static constexpr usize SLOT_ENTRY_SIZE = sizeof(u32);
+};
@@ -2,10 +2,14 @@
 
 #include <fstream>
 
+#include "../rendering/tasks/scatter_upload.inl"
+
 #include <fastgltf/core.hpp>
 
 #include <fmt/format.h>
 #include <glm/gtx/quaternion.hpp>
+#include <glm/gtx/matrix_decompose.hpp>
+#include <cmath>
 #include <thread>
 #include <chrono>
 #include <ktx.h>
@@ -20,10 +24,12 @@ Scene::Scene(daxa::Device device)
     meshgroup_mutex = std::make_unique<std::mutex>();
     /// TODO: THIS IS TEMPORARY! Make manifest and entity buffers growable!
     gpu_scratch_buffer = cinder::make_task_buffer(_device, scratch_buffer_size, "gpu_scratch_buffer"); 
-    gpu_entity_parents = cinder::make_task_buffer(_device, sizeof(RenderEntityId) * MAX_ENTITIES, "_gpu_entity_parents");
+    gpu_entity_parents = cinder::make_task_buffer(_device, sizeof(u32) * MAX_ENTITIES, "_gpu_entity_parents");
     gpu_entity_transforms = cinder::make_task_buffer(_device, sizeof(daxa_f32mat4x3) * MAX_ENTITIES, "_gpu_entity_transforms");
     gpu_entity_combined_transforms = cinder::make_task_buffer(_device, sizeof(daxa_f32mat4x3) * MAX_ENTITIES, "_gpu_entity_combined_transforms");
     gpu_entity_mesh_groups = cinder::make_task_buffer(_device, sizeof(u32) * MAX_ENTITIES, "_gpu_entity_mesh_groups");
+    gpu_entity_slot_indices = cinder::make_task_buffer(_device, sizeof(u32) * MAX_ENTITIES, "_gpu_entity_slot_indices");
+    gpu_entity_dense_indices = cinder::make_task_buffer(_device, sizeof(u32) * MAX_ENTITIES, "_gpu_entity_dense_indices");
     gpu_mesh_manifest = cinder::make_task_buffer(_device, sizeof(GPUMesh) * MAX_MESHES, "_gpu_mesh_manifest");
     gpu_mesh_group_manifest = cinder::make_task_buffer(_device, sizeof(GPUMeshGroup) * MAX_MESHES, "_gpu_mesh_group_manifest");
     gpu_material_manifest = cinder::make_task_buffer(_device, sizeof(GPUMaterial) * MAX_MATERIALS, "_gpu_material_manifest");
@@ -118,6 +124,19 @@ auto Scene::load_manifest_from_gltf(LoadManifestInfo const & info) -> std::varia
     return root_r_ent_id;
 }
 
+void Scene::cancel_asset_loads(u32 gltf_asset_manifest_index)
+{
+    gltf_asset_manifest.at(gltf_asset_manifest_index).load_cancellation.cancel();
+}
+
+void Scene::cancel_pending_loads()
+{
+    for (GltfAssetManifestEntry & asset : gltf_asset_manifest)
+    {
+        asset.load_cancellation.cancel();
+    }
+}
+
 static auto get_load_manifest_data_from_gltf(Scene & scene, Scene::LoadManifestInfo const & info) -> std::variant<LoadManifestFromFileContext, Scene::LoadManifestErrorCode>
 {
     auto file_path = info.root_path / info.asset_name;
@@ -356,37 +375,51 @@ static auto update_entities_from_gltf(Scene & scene, Scene::LoadManifestInfo con
     for (u32 node_index = 0; node_index < s_cast<u32>(load_ctx.asset.nodes.size()); node_index++)
     {
         node_index_to_entity_id.push_back(scene._render_entities.create_slot());
-        scene._dirty_render_entities.push_back(node_index_to_entity_id.back());
     }
     for (u32 node_index = 0; node_index < s_cast<u32>(load_ctx.asset.nodes.size()); node_index++)
     {
-        // TODO: For now store transform as a matrix - later should be changed to something else (TRS: translation, rotor, scale).
-        auto fastgltf_to_glm_mat4x3_transform = [](std::variant<fastgltf::TRS, fastgltf::Node::TransformMatrix> const & trans) -> glm::mat4x3
+        auto fastgltf_to_trs = [](std::variant<fastgltf::TRS, fastgltf::Node::TransformMatrix> const & trans, std::string_view node_name) -> cinder::Trs
         {
-            glm::mat4x3 ret_trans;
+            cinder::Trs ret_trs = {};
             if (auto const * trs = std::get_if<fastgltf::TRS>(&trans))
             {
-                auto const scale = glm::scale(glm::identity<glm::mat4x4>(), glm::vec3(trs->scale[0], trs->scale[1], trs->scale[2]));
-                auto const rotation = glm::toMat4(glm::quat(trs->rotation[3], trs->rotation[0], trs->rotation[1], trs->rotation[2]));
-                auto const translation = glm::translate(glm::identity<glm::mat4x4>(), glm::vec3(trs->translation[0], trs->translation[1], trs->translation[2]));
-                auto const rotated_scaled = rotation * scale;
-                auto const translated_rotated_scaled = translation * rotated_scaled;
-                /// NOTE: As the last row is always (0,0,0,1) we dont store it.
-                ret_trans = glm::mat4x3(translated_rotated_scaled);
+                ret_trs.translation = glm::vec3(trs->translation[0], trs->translation[1], trs->translation[2]);
+                ret_trs.rotation = glm::quat(trs->rotation[3], trs->rotation[0], trs->rotation[1], trs->rotation[2]);
+                ret_trs.scale = glm::vec3(trs->scale[0], trs->scale[1], trs->scale[2]);
             }
-            else if (auto const * trs = std::get_if<fastgltf::Node::TransformMatrix>(&trans))
+            else if (auto const * matrix = std::get_if<fastgltf::Node::TransformMatrix>(&trans))
             {
-                // Gltf and glm matrices are column major.
-                ret_trans = glm::mat4x3(std::bit_cast<glm::mat4x4>(*trs));
+                /// NOTE: Gltf requires node matrices to be decomposable into TRS. Gltf and glm matrices are column major.
+                glm::mat4x4 const transform = std::bit_cast<glm::mat4x4>(*matrix);
+                glm::vec3 skew = {};
+                glm::vec4 perspective = {};
+                bool const decomposed = glm::decompose(transform, ret_trs.scale, ret_trs.rotation, ret_trs.translation, skew, perspective);
+                /// NOTE: decompose divides by the scale, zero scale matrices (hidden nodes) come back as NaNs without failing.
+                auto is_finite = [](auto const & v)
+                {
+                    for (i32 i = 0; i < v.length(); ++i)
+                    {
+                        if (!std::isfinite(v[i])) { return false; }
+                    }
+                    return true;
+                };
+                if (!decomposed || !is_finite(ret_trs.scale) || !is_finite(ret_trs.rotation) || !is_finite(ret_trs.translation))
+                {
+                    MESSAGE(fmt::format("[WARNING] Node \"{}\" has a matrix that can not be decomposed into TRS, it is hidden with zero scale", node_name));
+                    ret_trs = {
+                        .translation = glm::vec3(transform[3]),
+                        .scale = glm::vec3(0.0f),
+                    };
+                }
             }
-            return ret_trans;
+            return ret_trs;
         };
 
         fastgltf::Node const & node = load_ctx.asset.nodes[node_index];
         RenderEntityId const parent_r_ent_id = node_index_to_entity_id[node_index];
         RenderEntity & r_ent = *scene._render_entities.slot(parent_r_ent_id);
         r_ent.mesh_group_manifest_index = node.meshIndex.has_value() ? std::optional<u32>(s_cast<u32>(node.meshIndex.value()) + load_ctx.mesh_group_manifest_offset) : std::optional<u32>(std::nullopt);
-        r_ent.transform = fastgltf_to_glm_mat4x3_transform(node.transform);
+        r_ent.local_transform = fastgltf_to_trs(node.transform, node.name.c_str());
         r_ent.name = node.name.c_str();
         if (node.meshIndex.has_value())
         {
@@ -426,7 +459,7 @@ static auto update_entities_from_gltf(Scene & scene, Scene::LoadManifestInfo con
     /// NOTE: Find all root render entities (aka render entities that have no parent) and store them as
     //        Child root entites under scene root node
     RenderEntityId root_r_ent_id = scene._render_entities.create_slot({
-        .transform = glm::mat4x3(glm::identity<glm::mat4x3>()),
+        .local_transform = {},
         .first_child = std::nullopt,
         .next_sibling = std::nullopt,
         .parent = std::nullopt,
@@ -434,7 +467,6 @@ static auto update_entities_from_gltf(Scene & scene, Scene::LoadManifestInfo con
         .name = info.asset_name.filename().replace_extension("").string() + "_" + std::to_string(load_ctx.gltf_asset_manifest_index),
     });
 
-    scene._dirty_render_entities.push_back(root_r_ent_id);
     RenderEntity & root_r_ent = *scene._render_entities.slot(root_r_ent_id);
     root_r_ent.type = EntityType::ROOT;
     std::optional<RenderEntityId> root_r_ent_prev_child = {};
@@ -456,43 +488,30 @@ static auto update_entities_from_gltf(Scene & scene, Scene::LoadManifestInfo con
             root_r_ent_prev_child = r_ent_id;
         }
     }
+    scene._transform_hierarchy_changed = true;
     return root_r_ent_id;
 }
 
-static void start_async_loads_of_dirty_meshes(Scene & scene, Scene::LoadManifestInfo const & info)
+static auto load_mesh_and_report(AssetProcessor & asset_processor, AssetProcessor::LoadMeshInfo load_info) -> cinder::task<>
 {
-    struct LoadMeshTask : Task
+    auto const ret_status = co_await asset_processor.load_mesh(load_info);
+    bool const failed =
+        ret_status != AssetProcessor::AssetLoadResultCode::SUCCESS &&
+        ret_status != AssetProcessor::AssetLoadResultCode::CANCELLED;
+    if (failed)
     {
-        struct TaskInfo
-        {
-            AssetProcessor::LoadMeshInfo load_info = {};
-            AssetProcessor * asset_processor = {};
-        };
-
-        TaskInfo info = {};
-        LoadMeshTask(TaskInfo const & info)
-            : info{info}
-        {
-            chunk_count = 1;
-        }
-
-        virtual void callback(u32 chunk_index, u32 thread_index) override
-        {
-            using namespace std::chrono_literals;
-            auto const ret_status = info.asset_processor->load_mesh(info.load_info);
-            if (ret_status != AssetProcessor::AssetLoadResultCode::SUCCESS)
-            {
-                DEBUG_MESSAGE(fmt::format("[ERROR]Failed to load mesh group {} mesh {} - error {}",
-                    info.load_info.gltf_mesh_index, info.load_info.gltf_primitive_index, AssetProcessor::to_string(ret_status)));
-            }
-            else
-            {
-                // DEBUG_MESSAGE(fmt::format("[SUCCESS] Successfuly loaded mesh group {} mesh {}",
-                //     info.load_info.gltf_mesh_index, info.load_info.gltf_primitive_index));
-            }
-        };
-    };
+        DEBUG_MESSAGE(fmt::format("[ERROR]Failed to load mesh group {} mesh {} - error {}",
+            load_info.gltf_mesh_index, load_info.gltf_primitive_index, AssetProcessor::to_string(ret_status)));
+    }
+    else
+    {
+        // DEBUG_MESSAGE(fmt::format("[SUCCESS] Successfuly loaded mesh group {} mesh {}",
+        //     load_info.gltf_mesh_index, load_info.gltf_primitive_index));
+    }
+}
 
+static void start_async_loads_of_dirty_meshes(Scene & scene, Scene::LoadManifestInfo const & info)
+{
     for (u32 mesh_manifest_index = 0; mesh_manifest_index < scene.new_mesh_manifest_entries; mesh_manifest_index++)
     {
         auto const & curr_asset = scene.gltf_asset_manifest.back();
@@ -500,57 +519,45 @@ static void start_async_loads_of_dirty_meshes(Scene & scene, Scene::LoadManifest
         auto const meshgroup_manifest_index = curr_asset.mesh_group_manifest_offset + mesh_manifest_entry.asset_local_mesh_index;
         // Launch loading of this mesh
         // TODO: ADD DUMMY MATERIAL INDEX!
-        info.thread_pool->async_dispatch(
-            std::make_shared<LoadMeshTask>(LoadMeshTask::TaskInfo{
-                .load_info = {
-                    .asset_path = curr_asset.path,
-                    .asset = curr_asset.gltf_asset.get(),
-                    .gltf_mesh_index = mesh_manifest_entry.asset_local_mesh_index,
-                    .gltf_primitive_index = mesh_manifest_entry.asset_local_primitive_index,
-                    .global_material_manifest_offset = curr_asset.material_manifest_offset,
-                    .manifest_index = mesh_manifest_index,
-                    .material_manifest_index = mesh_manifest_entry.material_index.value_or(INVALID_MANIFEST_INDEX),
-                },
-                .asset_processor = info.asset_processor.get(),
+        cinder::spawn(
+            *info.thread_pool,
+            load_mesh_and_report(*info.asset_processor, {
+                .asset_path = curr_asset.path,
+                .asset = curr_asset.gltf_asset.get(),
+                .gltf_mesh_index = mesh_manifest_entry.asset_local_mesh_index,
+                .gltf_primitive_index = mesh_manifest_entry.asset_local_primitive_index,
+                .global_material_manifest_offset = curr_asset.material_manifest_offset,
+                .manifest_index = mesh_manifest_index,
+                .material_manifest_index = mesh_manifest_entry.material_index.value_or(INVALID_MANIFEST_INDEX),
+                .thread_pool = info.thread_pool.get(),
+                .cancellation = curr_asset.load_cancellation.token(),
+                .main_thread = info.main_thread_executor,
             }),
             TaskPriority::LOW);
     }
 }
 
-static void start_async_loads_of_dirty_textures(Scene & scene, Scene::LoadManifestInfo const & info)
+static auto load_texture_and_report(AssetProcessor & asset_processor, AssetProcessor::LoadTextureInfo load_info) -> cinder::task<>
 {
-    struct LoadTextureTask : Task
+    auto const ret_status = co_await asset_processor.load_texture(load_info);
+    auto const texture_name = load_info.asset->images.at(load_info.gltf_image_index).name;
+    bool const failed =
+        ret_status != AssetProcessor::AssetLoadResultCode::SUCCESS &&
+        ret_status != AssetProcessor::AssetLoadResultCode::CANCELLED;
+    if (failed)
     {
-        struct TaskInfo
-        {
-            AssetProcessor::LoadTextureInfo load_info = {};
-            AssetProcessor * asset_processor = {};
-            u32 manifest_index = {};
-        };
-
-        TaskInfo info = {};
-        LoadTextureTask(TaskInfo const & info)
-            : info{info}
-        {
-            chunk_count = 1;
-        }
+        DEBUG_MESSAGE(fmt::format("[ERROR] Failed to load texture index {} name {} - error {}",
+            load_info.gltf_texture_index, texture_name, AssetProcessor::to_string(ret_status)));
+    }
+    else
+    {
+        // DEBUG_MESSAGE(fmt::format("[SUCCESS] Successfuly loaded texture index {} name {}",
+        //     load_info.gltf_texture_index, texture_name));
+    }
+}
 
-        virtual void callback(u32 chunk_index, u32 thread_index) override
-        {
-            auto const ret_status = info.asset_processor->load_texture(info.load_info);
-            auto const texture_name = info.load_info.asset->images.at(info.load_info.gltf_image_index).name;
-            if (ret_status != AssetProcessor::AssetLoadResultCode::SUCCESS)
-            {
-                DEBUG_MESSAGE(fmt::format("[ERROR] Failed to load texture index {} name {} - error {}",
-                    info.load_info.gltf_texture_index, texture_name, AssetProcessor::to_string(ret_status)));
-            }
-            else
-            {
-                // DEBUG_MESSAGE(fmt::format("[SUCCESS] Successfuly loaded texture index {} name {}",
-                //     info.load_info.gltf_texture_index, texture_name));
-            }
-        };
-    };
+static void start_async_loads_of_dirty_textures(Scene & scene, Scene::LoadManifestInfo const & info)
+{
     auto gltf_texture_to_image_index = [&](u32 const texture_index) -> std::optional<u32>
     {
         std::unique_ptr<fastgltf::Asset> const & asset =
@@ -584,17 +591,18 @@ static void start_async_loads_of_dirty_textures(Scene & scene, Scene::LoadManife
         if (!texture_manifest_entry.material_manifest_indices.empty())
         {
             // Launch loading of this texture
-            info.thread_pool->async_dispatch(
-                std::make_shared<LoadTextureTask>(LoadTextureTask::TaskInfo{
-                    .load_info = {
-                        .asset_path = curr_asset.path,
-                        .asset = curr_asset.gltf_asset.get(),
-                        .gltf_texture_index = texture_manifest_entry.asset_local_index,
-                        .gltf_image_index = texture_manifest_entry.asset_local_image_index,
-                        .texture_manifest_index = texture_manifest_index,
-                        .texture_material_type = texture_manifest_entry.type,
-                    },
-                    .asset_processor = info.asset_processor.get(),
+            cinder::spawn(
+                *info.thread_pool,
+                load_texture_and_report(*info.asset_processor, {
+                    .asset_path = curr_asset.path,
+                    .asset = curr_asset.gltf_asset.get(),
+                    .gltf_texture_index = texture_manifest_entry.asset_local_index,
+                    .gltf_image_index = texture_manifest_entry.asset_local_image_index,
+                    .texture_manifest_index = texture_manifest_index,
+                    .texture_material_type = texture_manifest_entry.type,
+                    .thread_pool = info.thread_pool.get(),
+                    .cancellation = curr_asset.load_cancellation.token(),
+                    .main_thread = info.main_thread_executor,
                 }),
                 TaskPriority::LOW);
         }
@@ -607,104 +615,166 @@ static void start_async_loads_of_dirty_textures(Scene & scene, Scene::LoadManife
     scene.new_texture_manifest_entries = 0;
 }
 
-auto Scene::record_gpu_manifest_update(RecordGPUManifestUpdateInfo const & info) -> daxa::ExecutableCommandList
+auto Scene::set_transforms(std::span<RenderEntityId const> entities, std::span<cinder::Trs const> transforms) -> std::optional<SetTransformsErrorCode>
 {
-    auto recorder = _device.create_command_recorder({});
-    /// TODO: Make buffers resize.
+    return set_entity_transforms(_render_entities, entities, transforms);
+}
 
-    // Calculate required staging buffer size:
+/// NOTE: Records uploads following UploadPlans. Copied ranges, scatter indices and scatter payloads of one update are
+//        packed into a single staging buffer, element data is written straight into it by the callers.
+struct PlannedUploadRecorder
+{
+    daxa::Device & device;
+    daxa::CommandRecorder & recorder;
+    daxa::ComputePipeline const * scatter_pipeline = {};
+    Scene::ManifestUploadStats & stats;
     daxa::BufferId staging_buffer = {};
-    usize staging_offset = 0;
-    std::byte * host_ptr = {};
-    if (_dirty_render_entities.size() > 0 || _modified_render_entities.size() > 0)
+    std::byte * staging_host_ptr = {};
+    daxa::DeviceAddress staging_address = {};
+    usize staging_offset = {};
+};
+
+static void create_planned_upload_staging(PlannedUploadRecorder & upload, usize size, std::string_view name)
+{
+    upload.staging_buffer = upload.device.create_buffer({
+        .size = size,
+        .allocate_info = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,
+        .name = name,
+    });
+    upload.recorder.destroy_buffer_deferred(upload.staging_buffer);
+    upload.staging_host_ptr = upload.device.get_host_address(upload.staging_buffer).value();
+    upload.staging_address = upload.device.get_device_address(upload.staging_buffer).value();
+    upload.staging_offset = 0;
+    upload.stats.staging_size += size;
+}
+
+// Uploads the scatter indices of the plan once, every array uploaded with the plan reads them.
+static auto stage_scatter_indices(PlannedUploadRecorder & upload, UploadPlan const & plan) -> daxa::DeviceAddress
+{
+    if (plan.scatter_indices.empty())
     {
-        usize required_staging_size = 0;
-        required_staging_size += sizeof(daxa_f32mat4x3) * (_dirty_render_entities.size() + _modified_render_entities.size()); // _gpu_entity_transforms
-        required_staging_size += sizeof(daxa_f32mat4x3) * (_dirty_render_entities.size() + _modified_render_entities.size()); // _gpu_entity_combined_transforms
-        required_staging_size += sizeof(GPUMeshGroup) * (_dirty_render_entities.size() + _modified_render_entities.size());   // _gpu_entity_mesh_groups
-        staging_buffer = _device.create_buffer({
-            .size = required_staging_size,
-            .allocate_info = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,
-            .name = "entities update staging",
-        });
-        recorder.destroy_buffer_deferred(staging_buffer);
-        host_ptr = _device.get_host_address(staging_buffer).value();
+        return {};
     }
+    std::memcpy(upload.staging_host_ptr + upload.staging_offset, plan.scatter_indices.data(), sizeof(u32) * plan.scatter_indices.size());
+    daxa::DeviceAddress const address = upload.staging_address + upload.staging_offset;
+    upload.staging_offset += plan.scatter_indices_size();
+    return address;
+}
 
-    /**
-     * TODO:
-     * - replace with compute shader
-     * - write two arrays, one containing entity ids other containing update data
-     * - write compute shader that reads both arrays, they then write the updates from staging to entity arrays
-     */
-    /// NOTE: Update dirty entities.
-    auto update_entity = [&](i32 i, RenderEntity * entity, u32 entity_index) -> glm::mat4
+// write_elements(u32 first_index, u32 count, std::byte * staging) writes count elements starting at first_index.
+template <typename WriteFnT>
+static void record_planned_upload(
+    PlannedUploadRecorder & upload, UploadPlan const & plan, daxa::DeviceAddress scatter_indices,
+    daxa::BufferId dst_buffer, usize element_size, WriteFnT && write_elements)
+{
+    for (UploadPlan::Range const range : plan.copies)
     {
-        usize offset = (staging_offset + (sizeof(glm::mat4x3) * 2 + sizeof(u32)) * i);
-        glm::mat4 transform4 = glm::mat4(
-            glm::vec4(entity->transform[0], 0.0f),
-            glm::vec4(entity->transform[1], 0.0f),
-            glm::vec4(entity->transform[2], 0.0f),
-            glm::vec4(entity->transform[3], 1.0f));
-        glm::mat4 combined_transform4 = transform4;
-        glm::mat4 combined_parent_transform4 = glm::identity<glm::mat4>();
-        std::optional<RenderEntityId> parent = entity->parent;
-        while (parent.has_value())
-        {
-            glm::mat4x3 parent_transform4 = glm::mat4(
-                glm::vec4(_render_entities.slot(parent.value())->transform[0], 0.0f),
-                glm::vec4(_render_entities.slot(parent.value())->transform[1], 0.0f),
-                glm::vec4(_render_entities.slot(parent.value())->transform[2], 0.0f),
-                glm::vec4(_render_entities.slot(parent.value())->transform[3], 1.0f));
-            combined_transform4 = parent_transform4 * combined_transform4;
-            combined_parent_transform4 = parent_transform4 * combined_parent_transform4;
-            parent = _render_entities.slot(parent.value())->parent;
-        }
-        u32 mesh_group_manifest_index = entity->mesh_group_manifest_index.value_or(INVALID_MANIFEST_INDEX);
-        struct RenderEntityUpdateStagingMemoryView
-        {
-            glm::mat4x3 transform;
-            glm::mat4x3 combined_transform;
-            u32 mesh_group_manifest_index;
-        };
-        entity->combined_transform = combined_transform4;
-        *r_cast<RenderEntityUpdateStagingMemoryView *>(host_ptr + offset) = {
-            .transform = transform4,
-            .combined_transform = combined_transform4,
-            .mesh_group_manifest_index = mesh_group_manifest_index,
-        };
-        recorder.copy_buffer_to_buffer({
-            .src_buffer = staging_buffer,
-            .dst_buffer = gpu_entity_transforms.get_state().buffers[0],
-            .src_offset = offset + offsetof(RenderEntityUpdateStagingMemoryView, transform),
-            .dst_offset = sizeof(glm::mat4x3) * entity_index,
-            .size = sizeof(glm::mat4x3),
-        });
-        recorder.copy_buffer_to_buffer({
-            .src_buffer = staging_buffer,
-            .dst_buffer = gpu_entity_combined_transforms.get_state().buffers[0],
-            .src_offset = offset + offsetof(RenderEntityUpdateStagingMemoryView, combined_transform),
-            .dst_offset = sizeof(glm::mat4x3) * entity_index,
-            .size = sizeof(glm::mat4x3),
+        usize const size = element_size * (range.end - range.begin);
+        write_elements(range.begin, range.end - range.begin, upload.staging_host_ptr + upload.staging_offset);
+        upload.recorder.copy_buffer_to_buffer({
+            .src_buffer = upload.staging_buffer,
+            .dst_buffer = dst_buffer,
+            .src_offset = upload.staging_offset,
+            .dst_offset = element_size * range.begin,
+            .size = size,
         });
-        recorder.copy_buffer_to_buffer({
-            .src_buffer = staging_buffer,
-            .dst_buffer = gpu_entity_mesh_groups.get_state().buffers[0],
-            .src_offset = offset + offsetof(RenderEntityUpdateStagingMemoryView, mesh_group_manifest_index),
-            .dst_offset = sizeof(u32) * entity_index,
-            .size = sizeof(u32),
-        });
-        return combined_parent_transform4;
+        upload.staging_offset += size;
+        upload.stats.copy_commands += 1;
+    }
+    if (plan.scatter_indices.empty())
+    {
+        return;
+    }
+    DBG_ASSERT_TRUE_M(upload.scatter_pipeline != nullptr, "[ERROR][record_planned_upload()] Scattering needs the scatter upload pipeline");
+    DBG_ASSERT_TRUE_M(element_size % sizeof(u32) == 0, "[ERROR][record_planned_upload()] Scattered elements have to be whole u32 words");
+    daxa::DeviceAddress const payload = upload.staging_address + upload.staging_offset;
+    for (u32 const index : plan.scatter_indices)
+    {
+        write_elements(index, 1, upload.staging_host_ptr + upload.staging_offset);
+        upload.staging_offset += element_size;
+    }
+    u32 const element_count = s_cast<u32>(plan.scatter_indices.size());
+    u32 const word_count = s_cast<u32>(element_size / sizeof(u32));
+    u32 const workgroup_count = std::min(
+        (element_count * word_count + SCATTER_UPLOAD_WORKGROUP_X - 1) / SCATTER_UPLOAD_WORKGROUP_X,
+        u32(SCATTER_UPLOAD_MAX_WORKGROUPS));
+    upload.recorder.set_pipeline(*upload.scatter_pipeline);
+    upload.recorder.push_constant(ScatterUploadPush{
+        .indices = scatter_indices,
+        .payload = payload,
+        .dst = upload.device.get_device_address(dst_buffer).value(),
+        .element_count = element_count,
+        .word_count = word_count,
+        .dispatch_thread_count = workgroup_count * SCATTER_UPLOAD_WORKGROUP_X,
+    });
+    upload.recorder.dispatch({.x = workgroup_count});
+    upload.stats.scatter_dispatches += 1;
+}
+
+// Writes elements of a packed cpu array that mirrors the gpu buffer as it is.
+template <typename T>
+static auto stage_packed_elements(std::vector<T> const & src)
+{
+    return [&src](u32 first_index, u32 count, std::byte * staging)
+    { std::memcpy(staging, src.data() + first_index, sizeof(T) * count); };
+}
+
+auto Scene::record_gpu_manifest_update(RecordGPUManifestUpdateInfo const & info) -> daxa::ExecutableCommandList
+{
+    auto recorder = _device.create_command_recorder({});
+    /// TODO: Make buffers resize.
+
+    if (_transform_hierarchy_changed)
+    {
+        rebuild_transform_hierarchy(_render_entities, _transform_hierarchy);
+        _transform_hierarchy_changed = false;
+    }
+    EntityTransformUpdateInfo<RenderEntity> const transform_update = {
+        .entities = _render_entities,
+        .hierarchy = _transform_hierarchy,
+        .soa = _render_entity_soa,
+        .thread_pool = info.thread_pool,
+    };
+    build_local_transforms(transform_update);
+    propagate_entity_transforms(transform_update, _modified_render_entities, [&](u32 dense_index, RenderEntity const & entity)
+        { _render_entity_soa.mesh_groups[dense_index] = entity.mesh_group_manifest_index.value_or(INVALID_MANIFEST_INDEX); });
+
+    /// NOTE: The gpu buffers mirror the packed arrays. Dirty elements are uploaded as coalesced range copies, the
+    //        sparse rest is scattered by one dispatch per array. The dense plan is shared by the five packed arrays.
+    _last_upload_stats = {};
+    PlannedUploadRecorder planned_upload = {
+        .device = _device,
+        .recorder = recorder,
+        .scatter_pipeline = info.scatter_upload_pipeline,
+        .stats = _last_upload_stats,
     };
-    for (u32 i = 0; i < _dirty_render_entities.size(); ++i)
+    UploadPlanInfo const upload_plan_info = info.scatter_upload_pipeline != nullptr ? UploadPlanInfo{} : UploadPlanInfo{.min_copy_size = 1};
+    UploadPlan const dense_plan = _render_entity_soa.plan_dense_upload(upload_plan_info);
+    UploadPlan const slot_plan = _render_entity_soa.plan_slot_upload(upload_plan_info);
+    if (!dense_plan.empty() || !slot_plan.empty())
     {
-        u32 entity_index = _dirty_render_entities[i].index;
-        auto * entity = _render_entities.slot(_dirty_render_entities[i]);
-        update_entity(i, entity, entity_index);
+        create_planned_upload_staging(
+            planned_upload,
+            dense_plan.staging_size(RenderEntitySoA::PACKED_ENTITY_SIZE) + slot_plan.staging_size(RenderEntitySoA::SLOT_ENTRY_SIZE),
+            "entities update staging");
+        daxa::DeviceAddress const dense_scatter_indices = stage_scatter_indices(planned_upload, dense_plan);
+        auto upload_packed = [&](daxa::TaskBuffer & dst, auto const & src)
+        {
+            record_planned_upload(planned_upload, dense_plan, dense_scatter_indices, dst.get_state().buffers[0], sizeof(src[0]), stage_packed_elements(src));
+        };
+        upload_packed(gpu_entity_transforms, _render_entity_soa.transforms);
+        upload_packed(gpu_entity_combined_transforms, _render_entity_soa.combined_transforms);
+        upload_packed(gpu_entity_parents, _render_entity_soa.parents);
+        upload_packed(gpu_entity_mesh_groups, _render_entity_soa.mesh_groups);
+        upload_packed(gpu_entity_slot_indices, _render_entity_soa.dense_to_slot);
+        daxa::DeviceAddress const slot_scatter_indices = stage_scatter_indices(planned_upload, slot_plan);
+        record_planned_upload(
+            planned_upload, slot_plan, slot_scatter_indices, gpu_entity_dense_indices.get_state().buffers[0],
+            sizeof(u32), stage_packed_elements(_render_entity_soa.slot_to_dense));
+        _render_entity_soa.clear_dirty();
     }
 
-    _dirty_render_entities.clear();
-    _modified_render_entities.clear();
+    _render_entities.clear_dirty();
 
     if (new_mesh_group_manifest_entries > 0)
     {
@@ -741,13 +811,24 @@ auto Scene::record_gpu_manifest_update(RecordGPUManifestUpdateInfo const & info)
         recorder.destroy_buffer_deferred(mesh_group_staging_buffer);
         GPUMeshGroup * staging_ptr = _device.get_host_address_as<GPUMeshGroup>(mesh_group_staging_buffer).value();
         u32 const mesh_group_manifest_offset = mesh_group_manifest.size() - new_mesh_group_manifest_entries;
-        for (u32 new_mesh_group_idx = 0; new_mesh_group_idx < new_mesh_group_manifest_entries; new_mesh_group_idx++)
+        auto fill_mesh_group_staging = [&](u32 new_mesh_group_idx)
         {
             u32 const mesh_group_manifest_idx = mesh_group_manifest_offset + new_mesh_group_idx;
             staging_ptr[new_mesh_group_idx].mesh_indices =
                 mesh_group_indices_array_addr +
                 sizeof(daxa_u32) * mesh_group_manifest.at(mesh_group_manifest_idx).mesh_manifest_indices_array_offset;
             staging_ptr[new_mesh_group_idx].count = mesh_group_manifest.at(mesh_group_manifest_idx).mesh_count;
+        };
+        if (info.thread_pool != nullptr)
+        {
+            info.thread_pool->parallel_for({0, new_mesh_group_manifest_entries}, fill_mesh_group_staging, 1024, TaskPriority::CRITICAL);
+        }
+        else
+        {
+            for (u32 new_mesh_group_idx = 0; new_mesh_group_idx < new_mesh_group_manifest_entries; new_mesh_group_idx++)
+            {
+                fill_mesh_group_staging(new_mesh_group_idx);
+            }
         }
         recorder.copy_buffer_to_buffer({
             .src_buffer = mesh_group_staging_buffer,
@@ -791,12 +872,20 @@ auto Scene::record_gpu_manifest_update(RecordGPUManifestUpdateInfo const & info)
         });
         recorder.destroy_buffer_deferred(material_staging_buffer);
         GPUMaterial * staging_ptr = _device.get_host_address_as<GPUMaterial>(material_staging_buffer).value();
-        std::vector<GPUMaterial> tmp_materials(new_material_manifest_entries);
-        for (i32 i = 0; i < new_material_manifest_entries; i++)
+        // Written straight into the staging memory, no temporary vector and memcpy.
+        auto fill_material_staging = [&](u32 i)
+        {
+            staging_ptr[i] = GPUMaterial{};
+            staging_ptr[i].base_color = std::bit_cast<daxa_f32vec3>(material_manifest.at(i + material_manifest_offset).base_color);
+        };
+        if (info.thread_pool != nullptr)
+        {
+            info.thread_pool->parallel_for({0, new_material_manifest_entries}, fill_material_staging, 1024, TaskPriority::CRITICAL);
+        }
+        else
         {
-            tmp_materials.at(i).base_color = std::bit_cast<daxa_f32vec3>(material_manifest.at(i + material_manifest_offset).base_color);
+            for (u32 i = 0; i < new_material_manifest_entries; i++) { fill_material_staging(i); }
         }
-        std::memcpy(staging_ptr, tmp_materials.data(), new_material_manifest_entries * sizeof(GPUMaterial));
 
         recorder.copy_buffer_to_buffer({
             .src_buffer = material_staging_buffer,
@@ -808,6 +897,13 @@ auto Scene::record_gpu_manifest_update(RecordGPUManifestUpdateInfo const & info)
     }
 
     /// TODO: Taskgraph this shit.
+    if (_last_upload_stats.scatter_dispatches > 0)
+    {
+        recorder.pipeline_barrier({
+            .src_access = daxa::AccessConsts::COMPUTE_SHADER_WRITE,
+            .dst_access = daxa::AccessConsts::READ_WRITE,
+        });
+    }
     recorder.pipeline_barrier({
         .src_access = daxa::AccessConsts::TRANSFER_WRITE,
         .dst_access = daxa::AccessConsts::READ_WRITE,
@@ -867,75 +963,70 @@ auto Scene::record_gpu_manifest_update(RecordGPUManifestUpdateInfo const & info)
                         break;
                         default: DBG_ASSERT_TRUE_M(false, "unimplemented"); break;
                     }
-                    /// NOTE: Add material index only if it was not added previously
-                    if (std::find(
-                            dirty_material_entry_indices.begin(),
-                            dirty_material_entry_indices.end(),
-                            material_using_texture_info.material_manifest_index) ==
-                        dirty_material_entry_indices.end())
-                    {
-                        dirty_material_entry_indices.push_back(material_using_texture_info.material_manifest_index);
-                    }
+                    dirty_material_entry_indices.push_back(material_using_texture_info.material_manifest_index);
                 }
             }
-            // // 2) Update GPU manifest
-            daxa::BufferId materials_update_staging_buffer = {};
-            GPUMaterial * staging_origin_ptr = {};
-            if (dirty_material_entry_indices.size())
+            /// NOTE: Materials using several uploaded textures show up multiple times, the plan needs each index once.
+            std::sort(dirty_material_entry_indices.begin(), dirty_material_entry_indices.end());
+            dirty_material_entry_indices.erase(
+                std::unique(dirty_material_entry_indices.begin(), dirty_material_entry_indices.end()),
+                dirty_material_entry_indices.end());
+            // 2) Update GPU manifest
+            UploadPlan const material_plan = plan_uploads(dirty_material_entry_indices, upload_plan_info);
+            if (!material_plan.empty())
             {
-                materials_update_staging_buffer = _device.create_buffer({
-                    .size = sizeof(GPUMaterial) * dirty_material_entry_indices.size(),
-                    .allocate_info = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,
-                    .name = "gpu materials update staging",
-                });
-                recorder.destroy_buffer_deferred(materials_update_staging_buffer);
-                staging_origin_ptr = _device.get_host_address_as<GPUMaterial>(materials_update_staging_buffer).value();
+                create_planned_upload_staging(planned_upload, material_plan.staging_size(sizeof(GPUMaterial)), "gpu materials update staging");
+                auto stage_materials = [&](u32 first_index, u32 count, std::byte * staging)
+                {
+                    for (u32 material_index = first_index; material_index < first_index + count; ++material_index)
+                    {
+                        GPUMaterial & gpu_material = r_cast<GPUMaterial *>(staging)[material_index - first_index];
+                        MaterialManifestEntry const & material = material_manifest.at(material_index);
+                        daxa::ImageId diffuse_id = {};
+                        daxa::ImageId opacity_id = {};
+                        daxa::ImageId normal_id = {};
+                        daxa::ImageId roughness_metalness_id = {};
+                        /// NOTE: We check if material even has diffuse info, if it does we need to check if the runtime value of this
+                        //        info is present - It might be that diffuse texture was uploaded marking this material as dirty, but
+                        //        the normal texture is not yet present thus we don't yet have the runtime info
+                        if (material.diffuse_info.has_value())
+                        {
+                            auto const & texture_entry = material_texture_manifest.at(material.diffuse_info.value().tex_manifest_index);
+                            diffuse_id = texture_entry.runtime_texture.value_or(daxa::ImageId{});
+                        }
+                        if (material.opacity_mask_info.has_value())
+                        {
+                            auto const & texture_entry = material_texture_manifest.at(material.opacity_mask_info.value().tex_manifest_index);
+                            opacity_id = texture_entry.secondary_runtime_texture.value_or(daxa::ImageId{});
+                        }
+                        if (material.normal_info.has_value())
+                        {
+                            auto const & texture_entry = material_texture_manifest.at(material.normal_info.value().tex_manifest_index);
+                            normal_id = texture_entry.runtime_texture.value_or(daxa::ImageId{});
+                        }
+                        if (material.roughness_metalness_info.has_value())
+                        {
+                            auto const & texture_entry = material_texture_manifest.at(material.roughness_metalness_info.value().tex_manifest_index);
+                            roughness_metalness_id = texture_entry.runtime_texture.value_or(daxa::ImageId{});
+                        }
+                        gpu_material.diffuse_texture_id = diffuse_id.default_view();
+                        gpu_material.opacity_texture_id = opacity_id.default_view();
+                        gpu_material.normal_texture_id = normal_id.default_view();
+                        gpu_material.roughnes_metalness_id = roughness_metalness_id.default_view();
+                        gpu_material.alpha_discard_enabled = material.alpha_discard_enabled;
+                        gpu_material.normal_compressed_bc5_rg = material.normal_compressed_bc5_rg;
+                        gpu_material.base_color = std::bit_cast<daxa_f32vec3>(material.base_color);
+                    }
+                };
+                record_planned_upload(
+                    planned_upload, material_plan, stage_scatter_indices(planned_upload, material_plan),
+                    gpu_material_manifest.get_state().buffers[0], sizeof(GPUMaterial), stage_materials);
             }
-            for (u32 dirty_materials_index = 0; dirty_materials_index < dirty_material_entry_indices.size(); dirty_materials_index++)
+            if (_last_upload_stats.scatter_dispatches > 0)
             {
-                MaterialManifestEntry const & material = material_manifest.at(dirty_material_entry_indices.at(dirty_materials_index));
-                daxa::ImageId diffuse_id = {};
-                daxa::ImageId opacity_id = {};
-                daxa::ImageId normal_id = {};
-                daxa::ImageId roughness_metalness_id = {};
-                /// NOTE: We check if material even has diffuse info, if it does we need to check if the runtime value of this
-                //        info is present - It might be that diffuse texture was uploaded marking this material as dirty, but
-                //        the normal texture is not yet present thus we don't yet have the runtime info
-                if (material.diffuse_info.has_value())
-                {
-                    auto const & texture_entry = material_texture_manifest.at(material.diffuse_info.value().tex_manifest_index);
-                    diffuse_id = texture_entry.runtime_texture.value_or(daxa::ImageId{});
-                }
-                if (material.opacity_mask_info.has_value())
-                {
-                    auto const & texture_entry = material_texture_manifest.at(material.opacity_mask_info.value().tex_manifest_index);
-                    opacity_id = texture_entry.secondary_runtime_texture.value_or(daxa::ImageId{});
-                }
-                if (material.normal_info.has_value())
-                {
-                    auto const & texture_entry = material_texture_manifest.at(material.normal_info.value().tex_manifest_index);
-                    normal_id = texture_entry.runtime_texture.value_or(daxa::ImageId{});
-                }
-                if (material.roughness_metalness_info.has_value())
-                {
-                    auto const & texture_entry = material_texture_manifest.at(material.roughness_metalness_info.value().tex_manifest_index);
-                    roughness_metalness_id = texture_entry.runtime_texture.value_or(daxa::ImageId{});
-                }
-                staging_origin_ptr[dirty_materials_index].diffuse_texture_id = diffuse_id.default_view();
-                staging_origin_ptr[dirty_materials_index].opacity_texture_id = opacity_id.default_view();
-                staging_origin_ptr[dirty_materials_index].normal_texture_id = normal_id.default_view();
-                staging_origin_ptr[dirty_materials_index].roughnes_metalness_id = roughness_metalness_id.default_view();
-                staging_origin_ptr[dirty_materials_index].alpha_discard_enabled = material.alpha_discard_enabled;
-                staging_origin_ptr[dirty_materials_index].normal_compressed_bc5_rg = material.normal_compressed_bc5_rg;
-                staging_origin_ptr[dirty_materials_index].base_color = std::bit_cast<daxa_f32vec3>(material.base_color);
-
-                daxa::BufferId gpu_material_manifest_buffer = gpu_material_manifest.get_state().buffers[0];
-                recorder.copy_buffer_to_buffer({
-                    .src_buffer = materials_update_staging_buffer,
-                    .dst_buffer = gpu_material_manifest_buffer,
-                    .src_offset = sizeof(GPUMaterial) * dirty_materials_index,
-                    .dst_offset = sizeof(GPUMaterial) * dirty_material_entry_indices.at(dirty_materials_index),
-                    .size = sizeof(GPUMaterial),
+                recorder.pipeline_barrier({
+                    .src_access = daxa::AccessConsts::COMPUTE_SHADER_WRITE,
+                    .dst_access = daxa::AccessConsts::READ,
                 });
             }
             recorder.pipeline_barrier({
@@ -1002,7 +1093,7 @@ auto Scene::record_gpu_manifest_update(RecordGPUManifestUpdateInfo const & info)
     return recorder.complete_current_commands();
 }
 
-auto Scene::create_and_record_build_as() -> daxa::ExecutableCommandList
+auto Scene::create_and_record_build_as(ThreadPool & thread_pool) -> daxa::ExecutableCommandList
 {
     auto get_aligned = [&](u64 to_align, u64 alignment) -> u64
     {
@@ -1088,32 +1179,39 @@ auto Scene::create_and_record_build_as() -> daxa::ExecutableCommandList
         .dst_access = daxa::AccessConsts::ACCELERATION_STRUCTURE_BUILD_READ
     });
 
-    std::vector<daxa_BlasInstanceData> blas_instances = {};
-    for (u32 entity_i = 0; entity_i < _render_entities.capacity(); ++entity_i)
-    {
-        RenderEntity const * r_ent = _render_entities.slot_by_index(entity_i);
-        if(r_ent != nullptr && r_ent->mesh_group_manifest_index.has_value())
+    /// NOTE: Every piece of the entity range collects its own instances, pieces are concatenated in range order.
+    using BlasInstances = std::vector<daxa_BlasInstanceData>;
+    cinder::PagedArray<RenderEntity> const & render_entities = _render_entities.values();
+    BlasInstances blas_instances = thread_pool.parallel_reduce(
+        {0, s_cast<u32>(render_entities.size())},
+        BlasInstances{},
+        [&](BlasInstances & instances, u32 entity_i)
         {
-            MeshGroupManifestEntry const & m_entry = mesh_group_manifest.at(r_ent->mesh_group_manifest_index.value());
-            if(!m_entry.blas.has_value())
+            RenderEntity const * r_ent = &render_entities[entity_i];
+            if(r_ent->mesh_group_manifest_index.has_value())
             {
-                continue;
-            }
+                MeshGroupManifestEntry const & m_entry = mesh_group_manifest.at(r_ent->mesh_group_manifest_index.value());
+                if(!m_entry.blas.has_value())
+                {
+                    return;
+                }
 
-            auto const t = r_ent->combined_transform;
-            blas_instances.push_back(daxa_BlasInstanceData{
-                .transform = {
-                    {t[0][0], t[1][0], t[2][0], t[3][0]},
-                    {t[0][1], t[1][1], t[2][1], t[3][1]},
-                    {t[0][2], t[1][2], t[2][2], t[3][2]},
-                },
-                .instance_custom_index = r_ent->mesh_group_manifest_index.value(),
-                .mask = 0xFF,
-                .instance_shader_binding_table_record_offset = 0,
-                .blas_device_address = _device.get_device_address(m_entry.blas.value()).value(),
-            });
-        }
-    }
+                instances.push_back(daxa_BlasInstanceData{
+                    .instance_custom_index = r_ent->mesh_group_manifest_index.value(),
+                    .mask = 0xFF,
+                    .instance_shader_binding_table_record_offset = 0,
+                    .blas_device_address = _device.get_device_address(m_entry.blas.value()).value(),
+                });
+                static_assert(sizeof(daxa_BlasInstanceData::transform) == sizeof(f32) * 12, "Instance transform is expected to be a row major 3x4 matrix");
+                cinder::affine::store_row_major_3x4(r_ent->combined_transform, r_cast<f32 *>(&instances.back().transform));
+            }
+        },
+        [](BlasInstances lhs, BlasInstances rhs)
+        {
+            lhs.insert(lhs.end(), rhs.begin(), rhs.end());
+            return lhs;
+        },
+        256);
 
     auto blas_instances_buffer = _device.create_buffer({
         .size = sizeof(daxa_BlasInstanceData) * blas_instances.size(),
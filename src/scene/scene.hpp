@@ -6,10 +6,14 @@
 #include <fastgltf/types.hpp>
 #include "../cinder.hpp"
 
+#include "../affine_simd.hpp"
 #include "../shader_shared/geometry.inl"
 #include "../slot_map.hpp"
 #include "../multithreading/thread_pool.hpp"
 #include "asset_processor.hpp"
+#include "entity_transform_update.hpp"
+#include "render_entity_soa.hpp"
+#include "transform_hierarchy.hpp"
 using namespace cinder::types;
 /**
  * DESCRIPTION:
@@ -83,7 +87,7 @@ struct MeshGroupManifestEntry
 };
 
 struct RenderEntity;
-using RenderEntityId = cinder::SlotMap<RenderEntity>::Id;
+using RenderEntityId = cinder::DenseSlotMap<RenderEntity>::Id;
 
 // TODO(msakmary) This assumes entity is only one of these types exclusively however this is not true
 //                for example, an entity can be both Transform (aka parent to other entities) and
@@ -100,6 +104,8 @@ enum struct EntityType
 
 struct RenderEntity
 {
+    // Local transform. The matrices below are caches, Scene::record_gpu_manifest_update rebuilds them for dirty entities.
+    cinder::Trs local_transform = {};
     glm::mat4x3 transform = {};
     glm::mat4x3 combined_transform = {};
     std::optional<RenderEntityId> first_child = {};
@@ -122,20 +128,23 @@ struct GltfAssetManifestEntry
     u32 mesh_group_manifest_offset = {};
     u32 mesh_manifest_offset = {};
     RenderEntityId root_render_entity = {};
+    // Shared by all mesh and texture loads started for this asset.
+    CancellationSource load_cancellation = {};
 };
 
-using RenderEntitySlotMap = cinder::SlotMap<RenderEntity>;
+using RenderEntitySlotMap = cinder::DenseSlotMap<RenderEntity>;
 
 struct Scene
 {
     /**
      * NOTES:
-     * - On the cpu, the entities are stored in a slotmap
-     * - On the gpu, render entities are stored in an 'soa' slotmap
+     * - On the cpu, the entities are stored in a dense slotmap, live entities are packed and iterated linearly
+     * - Entity storage is paged, creating entities never moves existing ones. RenderEntity pointers stay valid while loading
+     * - On the gpu, render entities are stored in packed 'soa' arrays mirrored from _render_entity_soa.
+     *   The first _render_entity_soa.size() elements are live, gpu_entity_slot_indices and gpu_entity_dense_indices
+     *   map between the packed arrays and entity slot indices
      * - the slotmaps capacity (and its underlying arrays) will only grow with time, it never shrinks
      * - all entity buffer updates are recorded within the scenes record commands function
-     * - WARNING: FOR NOW THE RENDERER ASSUMES TIGHTLY PACKED ENTITIES!
-     * - TODO: Upload sparse set to gpu so gpu can tightly iterate!
      * - TODO: Make the task buffers real buffers grow with time, unfix their size!
      * - TODO: Combine all into one task buffer when task graph gets array uses.
      */
@@ -147,19 +156,34 @@ struct Scene
 
     daxa::TaskBuffer gpu_entity_transforms = {};
     daxa::TaskBuffer gpu_entity_combined_transforms = {};
-    // UNUSED, but later we wanna do
+    // Slot index of the parent. UNUSED, but later we wanna do
     // the compined transform calculation on the gpu!
     daxa::TaskBuffer gpu_entity_parents = {};
     daxa::TaskBuffer gpu_entity_mesh_groups = {};
+    // Packed index -> entity slot index.
+    daxa::TaskBuffer gpu_entity_slot_indices = {};
+    // Entity slot index -> packed index, ~0u for slots without an entity.
+    daxa::TaskBuffer gpu_entity_dense_indices = {};
+    // Cpu side of the packed gpu entity arrays, filled from the dirty entities when recording the manifest update.
+    RenderEntitySoA _render_entity_soa = {};
+    // Combined transforms are propagated through the hierarchy, dirty entities take their subtrees with them.
+    // Set _transform_hierarchy_changed after creating, destroying or reparenting entities, the order is rebuilt before the next update.
+    TransformHierarchy _transform_hierarchy = {};
+    bool _transform_hierarchy_changed = {};
+    // Entities to upload are tracked by the slot map, mark them with _render_entities.mark_dirty.
     RenderEntitySlotMap _render_entities = {};
-    std::vector<RenderEntityId> _dirty_render_entities = {};
-    struct ModifiedEntityInfo
+    using ModifiedEntityInfo = ModifiedEntityTransform<RenderEntityId>;
+    // Entities whose combined transform changed in the last record_gpu_manifest_update with their combined transforms
+    // before and after it, for motion vectors. Contains the subtrees of moved entities, not the entities created in that update.
+    std::vector<ModifiedEntityInfo> _modified_render_entities = {};
+    // Upload commands recorded for the entity arrays and the dirty materials by one record_gpu_manifest_update.
+    struct ManifestUploadStats
     {
-        RenderEntityId entity = {};
-        glm::mat4x4 prev_transform = {};
-        glm::mat4x4 curr_transform = {};
+        u32 copy_commands = {};
+        u32 scatter_dispatches = {};
+        usize staging_size = {};
     };
-    std::vector<ModifiedEntityInfo> _modified_render_entities = {};
+    ManifestUploadStats _last_upload_stats = {};
 
     /**
      * NOTES:
@@ -221,17 +245,44 @@ struct Scene
         std::filesystem::path asset_name;
         std::unique_ptr<ThreadPool> & thread_pool;
         std::unique_ptr<AssetProcessor> & asset_processor;
+        // Finished loads record their uploads in follow ups posted here, see AssetProcessor::LoadTextureInfo::main_thread.
+        MainThreadExecutor * main_thread_executor = {};
     };
     auto load_manifest_from_gltf(LoadManifestInfo const & info) -> std::variant<RenderEntityId, LoadManifestErrorCode>;
+    // Loads that did not reach the upload queues yet stop at their next stage and free what they hold.
+    // Their manifest entries stay unloaded.
+    void cancel_asset_loads(u32 gltf_asset_manifest_index);
+    void cancel_pending_loads();
+
+    using SetTransformsErrorCode = ::SetTransformsErrorCode;
+    static auto to_string(SetTransformsErrorCode result) -> std::string_view
+    {
+        switch (result)
+        {
+            case SetTransformsErrorCode::SIZE_MISMATCH:     return "SIZE_MISMATCH";
+            case SetTransformsErrorCode::INVALID_ENTITY_ID: return "INVALID_ENTITY_ID";
+            default:                                        return "UNKNOWN";
+        }
+        return "UNKNOWN";
+    }
+    // Sets the local transforms of entities, transforms[i] belongs to entities[i].
+    // All ids are validated before anything is written, a batch containing an invalid id changes nothing.
+    // Combined transforms and gpu buffers follow in the next record_gpu_manifest_update.
+    auto set_transforms(std::span<RenderEntityId const> entities, std::span<cinder::Trs const> transforms) -> std::optional<SetTransformsErrorCode>;
 
     struct RecordGPUManifestUpdateInfo
     {
         std::span<const AssetProcessor::MeshUploadInfo> uploaded_meshes = {};
         std::span<const AssetProcessor::LoadedTextureInfo> uploaded_textures = {};
+        // Used to fill the staging memory in parallel, everything runs on the calling thread when null.
+        ThreadPool * thread_pool = {};
+        // Writes sparse entity and material updates with one dispatch, see scene/upload_plan.hpp.
+        // Every update is uploaded with range copies when null.
+        daxa::ComputePipeline const * scatter_upload_pipeline = {};
     };
     auto record_gpu_manifest_update(RecordGPUManifestUpdateInfo const & info) -> daxa::ExecutableCommandList;
 
-    auto create_and_record_build_as() -> daxa::ExecutableCommandList;
+    auto create_and_record_build_as(ThreadPool & thread_pool) -> daxa::ExecutableCommandList;
 
     daxa::Device _device = {};
 };
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <numeric>
+#include <optional>
+
+#include "../cinder.hpp"
+#include "../multithreading/coroutine.hpp"
+using namespace cinder::types;
+
+/**
+ * DESCRIPTION:
+ * Waiting for the staging memory budget of asset loads.
+ * Loads running on the ThreadPool wait for the budget before allocating staging buffers.
+ * Without a thread pool (synchronous loads) the staging memory is allocated right away.
+ * NOTES:
+ * - The budget is only refilled once the uploads of finished loads are recorded. A load that needs several staging
+ *   buffers has to reserve them with a single call. Holding one share while waiting for the next dead locks once
+ *   every in flight load holds its first share
+ * THREADSAFETY:
+ * * internally synchronized through the budget
+ */
+struct StagingBudgetWait
+{
+    cinder::AsyncBudget * budget = {};
+    ThreadPool * thread_pool = {};
+    // Cancelled loads do not allocate staging memory.
+    CancellationToken cancellation = {};
+};
+
+// Reserves the staging memory of all buffers of a load at once and returns the share of each buffer.
+// Every share has to be released once its staging buffer is no longer needed, the shares are 0 for synchronous loads.
+// Returns nothing when the load was cancelled before or while waiting for the budget, nothing is reserved then.
+template <usize N>
+auto reserve_staging_memory(StagingBudgetWait staging_wait, std::array<u64, N> sizes) -> cinder::task<std::optional<std::array<u64, N>>>
+{
+    if (staging_wait.cancellation.is_cancelled()) { co_return std::nullopt; }
+    if (staging_wait.thread_pool == nullptr) { co_return std::array<u64, N>{}; }
+    u64 const total_size = std::accumulate(sizes.begin(), sizes.end(), u64(0));
+    co_await staging_wait.budget->acquire(*staging_wait.thread_pool, total_size);
+    // Waiting for the budget can take a while, don't hold on to it for a load that got cancelled in the meantime.
+    if (staging_wait.cancellation.is_cancelled())
+    {
+        staging_wait.budget->release(total_size);
+        co_return std::nullopt;
+    }
+    co_return sizes;
+}
+
+// Single staging buffer version, returns the amount that was reserved.
+inline auto reserve_staging_memory(StagingBudgetWait staging_wait, u64 size) -> cinder::task<std::optional<u64>>
+{
+    std::optional<std::array<u64, 1>> const reserved = co_await reserve_staging_memory(staging_wait, std::array<u64, 1>{size});
+    if (!reserved.has_value()) { co_return std::nullopt; }
+    co_return reserved.value()[0];
+}
+
+inline void release_staging_memory(StagingBudgetWait const & staging_wait, u64 reserved_size)
+{
+    if (reserved_size != 0) { staging_wait.budget->release(reserved_size); }
+}
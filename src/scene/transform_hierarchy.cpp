@@ -0,0 +1,181 @@
+#include "transform_hierarchy.hpp"
+
+#include <algorithm>
+
+void TransformHierarchy::rebuild(std::span<Node const> nodes)
+{
+    u32 slot_count = 0;
+    for (Node const & node : nodes)
+    {
+        slot_count = std::max(slot_count, node.slot_index + 1);
+    }
+    _slot_to_position.assign(slot_count, INVALID_INDEX);
+    for (Node const & node : nodes)
+    {
+        _slot_to_position[node.slot_index] = 0;
+    }
+    auto is_root = [&](Node const & node)
+    {
+        return node.parent_slot_index >= slot_count || _slot_to_position[node.parent_slot_index] == INVALID_INDEX;
+    };
+
+    /// NOTE: Children grouped by parent with a counting sort, children_offsets[slot] is the first child of slot.
+    std::vector<u32> children_offsets(slot_count + 1, 0);
+    for (Node const & node : nodes)
+    {
+        if (!is_root(node)) { children_offsets[node.parent_slot_index + 1] += 1; }
+    }
+    for (u32 slot_index = 0; slot_index < slot_count; ++slot_index)
+    {
+        children_offsets[slot_index + 1] += children_offsets[slot_index];
+    }
+    std::vector<u32> children(children_offsets[slot_count]);
+    std::vector<u32> children_fill(children_offsets.begin(), children_offsets.end() - 1);
+    std::vector<u32> stack = {};
+    for (Node const & node : nodes)
+    {
+        if (is_root(node)) { stack.push_back(node.slot_index); }
+        else { children[children_fill[node.parent_slot_index]++] = node.slot_index; }
+    }
+    /// NOTE: Reversed so the pre order visits roots and siblings in the order they were given in.
+    std::reverse(stack.begin(), stack.end());
+
+    _order.clear();
+    _order.reserve(nodes.size());
+    _parent_slots.assign(nodes.size(), INVALID_INDEX);
+    while (!stack.empty())
+    {
+        u32 const slot_index = stack.back();
+        stack.pop_back();
+        _slot_to_position[slot_index] = s_cast<u32>(_order.size());
+        _order.push_back(slot_index);
+        for (u32 child = children_offsets[slot_index + 1]; child > children_offsets[slot_index]; --child)
+        {
+            stack.push_back(children[child - 1]);
+        }
+    }
+    DBG_ASSERT_TRUE_M(_order.size() == nodes.size(), "[ERROR][TransformHierarchy::rebuild()] Hierarchy contains a cycle");
+    /// NOTE: Entities in a cycle are never reached from a root, they are left out of the hierarchy.
+    for (Node const & node : nodes)
+    {
+        u32 const position = _slot_to_position[node.slot_index];
+        if (position >= _order.size() || _order[position] != node.slot_index)
+        {
+            _slot_to_position[node.slot_index] = INVALID_INDEX;
+        }
+    }
+
+    /// NOTE: Children come after their parents, summing subtree sizes back to front finishes every child before its parent.
+    std::vector<u32> subtree_sizes(_order.size(), 1);
+    for (u32 position = s_cast<u32>(_order.size()); position > 0; --position)
+    {
+        u32 const slot_index = _order[position - 1];
+        for (u32 child = children_offsets[slot_index]; child < children_offsets[slot_index + 1]; ++child)
+        {
+            u32 const child_position = _slot_to_position[children[child]];
+            if (child_position == INVALID_INDEX) { continue; }
+            subtree_sizes[position - 1] += subtree_sizes[child_position];
+            _parent_slots[child_position] = slot_index;
+        }
+    }
+    _subtree_ends.resize(_order.size());
+    for (u32 position = 0; position < _order.size(); ++position)
+    {
+        _subtree_ends[position] = position + subtree_sizes[position];
+    }
+    _dirty_positions.clear();
+}
+
+void TransformHierarchy::mark_dirty(u32 slot_index)
+{
+    if (contains(slot_index))
+    {
+        _dirty_positions.push_back(_slot_to_position[slot_index]);
+    }
+}
+
+auto TransformHierarchy::take_dirty_ranges() -> std::vector<Range>
+{
+    std::vector<Range> ranges = {};
+    std::sort(_dirty_positions.begin(), _dirty_positions.end());
+    for (u32 const position : _dirty_positions)
+    {
+        /// NOTE: Subtrees are nested or disjoint. Sorted by position, a dirty subtree inside the previous one is skipped.
+        if (!ranges.empty() && position < ranges.back().end)
+        {
+            continue;
+        }
+        if (!ranges.empty() && position == ranges.back().end)
+        {
+            ranges.back().end = _subtree_ends[position];
+        }
+        else
+        {
+            ranges.push_back({position, _subtree_ends[position]});
+        }
+    }
+    _dirty_positions.clear();
+    return ranges;
+}
+
+auto TransformHierarchy::take_dirty_work(u32 target_task_count) -> PropagationWork
+{
+    /// NOTE: Small ranges cost more in scheduling than they save, below this they are never split.
+    static constexpr u32 MIN_TASK_SIZE = 256;
+    PropagationWork work = {};
+    std::vector<Range> const ranges = take_dirty_ranges();
+    u32 entity_count = 0;
+    for (Range const range : ranges)
+    {
+        entity_count += range.end - range.begin;
+    }
+    u32 const max_task_size = std::max(MIN_TASK_SIZE, entity_count / std::max(1u, target_task_count));
+    for (Range const range : ranges)
+    {
+        u32 position = range.begin;
+        while (position < range.end)
+        {
+            u32 const subtree_end = _subtree_ends[position];
+            if (subtree_end - position > max_task_size)
+            {
+                /// NOTE: Too large, the root goes first and its children are the next subtrees visited.
+                work.serial_positions.push_back(position);
+                position += 1;
+                continue;
+            }
+            // Neighbouring small subtrees are batched into one task.
+            bool const extends_last = !work.parallel_ranges.empty() && work.parallel_ranges.back().end == position &&
+                                      subtree_end - work.parallel_ranges.back().begin <= max_task_size;
+            if (extends_last)
+            {
+                work.parallel_ranges.back().end = subtree_end;
+            }
+            else
+            {
+                work.parallel_ranges.push_back({position, subtree_end});
+            }
+            position = subtree_end;
+        }
+    }
+    return work;
+}
+
+auto TransformHierarchy::contains(u32 slot_index) const -> bool
+{
+    return slot_index < _slot_to_position.size() && _slot_to_position[slot_index] != INVALID_INDEX;
+}
+
+auto TransformHierarchy::size() const -> u32
+{
+    return s_cast<u32>(_order.size());
+}
+
+auto TransformHierarchy::slot_at(u32 position) const -> u32
+{
+    return _order[position];
+}
+
+auto TransformHierarchy::parent_slot_at(u32 position) const -> u32
+{
+    return _parent_slots[position];
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "../cinder.hpp"
+#include "../multithreading/thread_pool.hpp"
+using namespace cinder::types;
+
+/**
+ * DESCRIPTION:
+ * Entity hierarchy in parent before child order, used to propagate combined transforms incrementally.
+ * NOTES:
+ * - Entities are stored in depth first pre order, the subtree of an entity is the contiguous range
+ *   [position, subtree end) right after it
+ * - Marking an entity dirty marks its whole subtree, the children of a moved parent are propagated with it
+ * - propagate visits every entity of the dirty subtrees exactly once, parents before their children.
+ *   Each combined transform is computed from the cached combined transform of its parent, parent chains are never walked
+ * - The order is rebuilt in O(N) when the topology changes. Loads add whole subtrees at once, so this is rare
+ * - Dirty subtrees do not depend on each other and are propagated in parallel. Subtrees too large for a single task
+ *   are split below their root, the roots are propagated first, then their child subtrees in parallel
+ * THREADSAFETY:
+ * * not synchronized
+ */
+struct TransformHierarchy
+{
+    static constexpr u32 INVALID_INDEX = ~0u;
+
+    struct Node
+    {
+        u32 slot_index = {};
+        // INVALID_INDEX for roots.
+        u32 parent_slot_index = INVALID_INDEX;
+    };
+    // Range of positions in the order, a subtree or a run of neighbouring subtrees.
+    struct Range
+    {
+        u32 begin = {};
+        u32 end = {};
+    };
+
+    // Replaces the order with the hierarchy described by nodes. Nodes whose parent is not in nodes are treated as roots.
+    void rebuild(std::span<Node const> nodes);
+    // Marks the subtree of the entity dirty. Ignored for slots that are not in the hierarchy.
+    void mark_dirty(u32 slot_index);
+    // Dirty subtrees merged into sorted, disjoint ranges of positions. The dirty set is empty afterwards.
+    auto take_dirty_ranges() -> std::vector<Range>;
+    struct PropagationWork
+    {
+        // Roots of subtrees too large for a single task, in parent before child order. Propagated before the ranges.
+        std::vector<u32> serial_positions = {};
+        // Independent of each other, the parents of all range roots are serial positions or were not dirty.
+        std::vector<Range> parallel_ranges = {};
+    };
+    // Dirty subtrees split into about target_task_count ranges. The dirty set is empty afterwards.
+    auto take_dirty_work(u32 target_task_count) -> PropagationWork;
+    // Calls fn(u32 slot_index, u32 parent_slot_index) for every entity of the work, parents before their children.
+    template <typename FnT>
+    void for_each_entity(PropagationWork const & work, FnT && fn) const
+    {
+        for (u32 const position : work.serial_positions)
+        {
+            fn(_order[position], _parent_slots[position]);
+        }
+        for (Range const range : work.parallel_ranges)
+        {
+            for (u32 position = range.begin; position < range.end; ++position)
+            {
+                fn(_order[position], _parent_slots[position]);
+            }
+        }
+    }
+    // Same as for_each_entity, the ranges are spread over the thread pool. fn is called concurrently for entities of
+    // different ranges, a parent is always finished before fn is called for its children.
+    template <typename FnT>
+    void propagate(PropagationWork const & work, ThreadPool & thread_pool, FnT && fn, TaskPriority priority = TaskPriority::CRITICAL) const
+    {
+        for (u32 const position : work.serial_positions)
+        {
+            fn(_order[position], _parent_slots[position]);
+        }
+        thread_pool.parallel_for({0, s_cast<u32>(work.parallel_ranges.size())}, [&](u32 range_index)
+            {
+                Range const range = work.parallel_ranges[range_index];
+                for (u32 position = range.begin; position < range.end; ++position)
+                {
+                    fn(_order[position], _parent_slots[position]);
+                } }, 1, priority);
+    }
+    // Calls fn(u32 slot_index, u32 parent_slot_index) for every entity in a dirty subtree, parents before their children.
+    // The dirty set is empty afterwards.
+    template <typename FnT>
+    void propagate(FnT && fn)
+    {
+        for_each_entity(take_dirty_work(1), fn);
+    }
+    auto contains(u32 slot_index) const -> bool;
+    auto size() const -> u32;
+    // Slot index of the entity at position in the order.
+    auto slot_at(u32 position) const -> u32;
+    auto parent_slot_at(u32 position) const -> u32;
+
+  private:
+    // Slot index of the entity at every position.
+    std::vector<u32> _order = {};
+    std::vector<u32> _parent_slots = {};
+    // One past the last position of the subtree rooted at every position.
+    std::vector<u32> _subtree_ends = {};
+    // INVALID_INDEX for slots that are not in the hierarchy.
+    std::vector<u32> _slot_to_position = {};
+    std::vector<u32> _dirty_positions = {};
+};
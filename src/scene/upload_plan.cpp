@@ -0,0 +1,60 @@
+#include "upload_plan.hpp"
+
+auto UploadPlan::empty() const -> bool
+{
+    return copies.empty() && scatter_indices.empty();
+}
+
+auto UploadPlan::copied_element_count() const -> u32
+{
+    u32 count = 0;
+    for (Range const range : copies)
+    {
+        count += range.end - range.begin;
+    }
+    return count;
+}
+
+auto UploadPlan::command_count() const -> u32
+{
+    return s_cast<u32>(copies.size()) + (scatter_indices.empty() ? 0 : 1);
+}
+
+auto UploadPlan::scatter_indices_size() const -> usize
+{
+    return (sizeof(u32) * scatter_indices.size() + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+}
+
+auto UploadPlan::staging_size(usize element_size) const -> usize
+{
+    return element_size * (copied_element_count() + scatter_indices.size()) + scatter_indices_size();
+}
+
+auto plan_uploads(std::span<u32 const> dirty_indices, UploadPlanInfo const & info) -> UploadPlan
+{
+    UploadPlan plan = {};
+    usize run_first = 0;
+    for (usize i = 0; i < dirty_indices.size(); ++i)
+    {
+        DBG_ASSERT_TRUE_M(i == 0 || dirty_indices[i - 1] < dirty_indices[i], "[ERROR][plan_uploads()] Dirty indices have to be sorted and unique");
+        bool const run_continues = i + 1 < dirty_indices.size() && dirty_indices[i + 1] - dirty_indices[i] <= info.max_gap + 1;
+        if (run_continues)
+        {
+            continue;
+        }
+        /// NOTE: The run spans dirty_indices[run_first, i], including the clean elements in its gaps.
+        u32 const begin = dirty_indices[run_first];
+        u32 const end = dirty_indices[i] + 1;
+        if (end - begin >= info.min_copy_size)
+        {
+            plan.copies.push_back({begin, end});
+        }
+        else
+        {
+            // Only the dirty elements are scattered, the gaps stay as they are.
+            plan.scatter_indices.insert(plan.scatter_indices.end(), dirty_indices.begin() + run_first, dirty_indices.begin() + i + 1);
+        }
+        run_first = i + 1;
+    }
+    return plan;
+}
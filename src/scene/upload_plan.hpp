@@ -0,0 +1,53 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "../cinder.hpp"
+using namespace cinder::types;
+
+/**
+ * DESCRIPTION:
+ * Turns the dirty elements of a gpu array into few upload commands.
+ * NOTES:
+ * - Runs of dirty elements become range copies. Runs separated by at most max_gap clean elements are merged into one
+ *   copy, uploading a few clean elements again is cheaper than recording another command
+ * - Runs shorter than min_copy_size are scattered instead. Their indices and payload are uploaded packed and a single
+ *   dispatch writes all of them, see rendering/tasks/scatter_upload.inl
+ * - With min_copy_size of 1 nothing is scattered, every run is copied
+ * - Plans only hold element indices, one plan is shared by all arrays indexed the same way
+ * THREADSAFETY:
+ * * pure functions
+ */
+struct UploadPlanInfo
+{
+    u32 max_gap = 4;
+    u32 min_copy_size = 8;
+};
+
+struct UploadPlan
+{
+    static constexpr usize STAGING_ALIGNMENT = 16;
+    struct Range
+    {
+        u32 begin = {};
+        u32 end = {};
+    };
+    // Sorted and disjoint.
+    std::vector<Range> copies = {};
+    // Sorted, every index appears once.
+    std::vector<u32> scatter_indices = {};
+
+    auto empty() const -> bool;
+    // Elements uploaded by the copies, including the clean elements merged into them.
+    auto copied_element_count() const -> u32;
+    // Commands recorded for one array, one per copy and one dispatch for all scattered elements.
+    auto command_count() const -> u32;
+    // Bytes of the scatter indices, padded so elements staged behind them stay aligned.
+    auto scatter_indices_size() const -> usize;
+    // Staging bytes for arrays with element_size bytes per element in total. The scatter indices are uploaded once.
+    auto staging_size(usize element_size) const -> usize;
+};
+
+// dirty_indices have to be sorted ascending and unique.
+auto plan_uploads(std::span<u32 const> dirty_indices, UploadPlanInfo const & info = {}) -> UploadPlan;
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "cinder.hpp"
+#include <algorithm>
+#include <bit>
+#include <vector>
+namespace cinder
+{
+    using namespace types;
+    /**
+     * DESCRIPTION:
+     * Per slot change tracking for the slot maps, a dirty bitset plus an epoch counter.
+     * NOTES:
+     * - The dirty bitset holds the slots changed since the last clear, marking a slot twice keeps a single entry
+     * - A summary bitset has one bit per dirty word, scanning only visits words that have dirty bits.
+     *   for_each_dirty and dirty_count scale with the amount of changes, not with the slot count
+     * - clear ends the epoch. Every slot remembers the epoch of its last change, consumers that don't run every clear
+     *   remember epoch() and ask for_each_changed_since later. Words remember the newest epoch of their slots, so
+     *   words that did not change since are skipped
+     * THREADSAFETY:
+     * * not synchronized
+     */
+    struct SlotChangeTracker
+    {
+        private:
+            std::vector<u64>
+                _dirty_words = {};
+            std::vector<u64>
+                _dirty_summary = {};
+            std::vector<u32>
+                _slot_epochs = {};
+            std::vector<u32>
+                _word_epochs = {};
+            u32
+                _epoch = 1;
+
+        public:
+            // Grows the tracked range to slot_count slots, called by the slot maps when they hand out a new slot index.
+            void resize(usize slot_count)
+            {
+                if (slot_count <= _slot_epochs.size()) { return; }
+                usize const word_count = (slot_count + 63) / 64;
+                _slot_epochs.resize(slot_count, 0);
+                _dirty_words.resize(word_count, 0);
+                _word_epochs.resize(word_count, 0);
+                _dirty_summary.resize((word_count + 63) / 64, 0);
+            }
+            void mark(u32 index)
+            {
+                u32 const word = index / 64;
+                _dirty_words[word] |= 1ull << (index % 64);
+                _dirty_summary[word / 64] |= 1ull << (word % 64);
+                _slot_epochs[index] = _epoch;
+                _word_epochs[word] = _epoch;
+            }
+            // For destroyed slots, they no longer show up as dirty. They still count as changed in this epoch.
+            void unmark(u32 index)
+            {
+                u32 const word = index / 64;
+                _dirty_words[word] &= ~(1ull << (index % 64));
+                if (_dirty_words[word] == 0) { _dirty_summary[word / 64] &= ~(1ull << (word % 64)); }
+            }
+            auto is_dirty(u32 index) const -> bool
+            {
+                return index / 64 < _dirty_words.size() && (_dirty_words[index / 64] & (1ull << (index % 64))) != 0;
+            }
+            // Calls fn(u32 slot_index) for every dirty slot in ascending index order.
+            template <typename FnT>
+            void for_each_dirty(FnT && fn) const
+            {
+                for (usize summary_index = 0; summary_index < _dirty_summary.size(); ++summary_index)
+                {
+                    u64 summary = _dirty_summary[summary_index];
+                    while (summary != 0)
+                    {
+                        usize const word = summary_index * 64 + std::countr_zero(summary);
+                        summary &= summary - 1;
+                        u64 bits = _dirty_words[word];
+                        while (bits != 0)
+                        {
+                            fn(s_cast<u32>(word * 64 + std::countr_zero(bits)));
+                            bits &= bits - 1;
+                        }
+                    }
+                }
+            }
+            auto dirty_count() const -> usize
+            {
+                usize count = 0;
+                for (usize summary_index = 0; summary_index < _dirty_summary.size(); ++summary_index)
+                {
+                    u64 summary = _dirty_summary[summary_index];
+                    while (summary != 0)
+                    {
+                        count += std::popcount(_dirty_words[summary_index * 64 + std::countr_zero(summary)]);
+                        summary &= summary - 1;
+                    }
+                }
+                return count;
+            }
+            // Calls fn(u32 slot_index) for every slot changed in epoch or later, in ascending index order.
+            template <typename FnT>
+            void for_each_changed_since(u32 epoch, FnT && fn) const
+            {
+                for (usize word = 0; word < _word_epochs.size(); ++word)
+                {
+                    if (_word_epochs[word] < epoch) { continue; }
+                    usize const end = std::min(_slot_epochs.size(), (word + 1) * 64);
+                    for (usize index = word * 64; index < end; ++index)
+                    {
+                        if (_slot_epochs[index] >= epoch) { fn(s_cast<u32>(index)); }
+                    }
+                }
+            }
+            // Ends the current epoch, the dirty set is empty afterwards.
+            void clear()
+            {
+                for (usize summary_index = 0; summary_index < _dirty_summary.size(); ++summary_index)
+                {
+                    u64 summary = _dirty_summary[summary_index];
+                    while (summary != 0)
+                    {
+                        _dirty_words[summary_index * 64 + std::countr_zero(summary)] = 0;
+                        summary &= summary - 1;
+                    }
+                    _dirty_summary[summary_index] = 0;
+                }
+                _epoch += 1;
+            }
+            // Epoch changes are currently recorded in, it ends with the next clear.
+            auto epoch() const -> u32
+            {
+                return _epoch;
+            }
+    };
+}
@@ -1,22 +1,34 @@
 #pragma once
 
 #include "cinder.hpp"
+#include "paged_array.hpp"
+#include "slot_change_tracker.hpp"
 #include <vector>
 #include <optional>
+#include <limits>
 namespace cinder
 {
     using namespace types;
+    /**
+     * NOTES:
+     * - Slots are stored in pages (PagedArray), creating slots never moves existing values.
+     *   Pointers returned by slot() stay valid until that slot is destroyed
+     * - Changes are tracked per slot (SlotChangeTracker). Created slots are dirty, everything else has to be marked
+     *   with mark_dirty. The consumer of the changes clears them once it processed them
+     */
     template <typename T>
     struct SlotMap
     {
         private:
             // TODO: It better to not use optional here.
-            std::vector<std::optional<T>>
+            PagedArray<std::optional<T>>
                 _slots = {};
             std::vector<u32>
                 _versions = {};
             std::vector<size_t>
                 _free_list = {};
+            SlotChangeTracker
+                _changes = {};
 
         public:
             struct Id
@@ -32,6 +44,7 @@ namespace cinder
                     u32 const index = _free_list.back();
                     _free_list.pop_back();
                     _slots[index] = std::move(v);
+                    _changes.mark(index);
                     return Id{index, _versions[index]};
                 }
                 else
@@ -39,6 +52,8 @@ namespace cinder
                     u32 const index = s_cast<u32>(_slots.size());
                     _slots.emplace_back(std::move(v));
                     _versions.emplace_back(1u);
+                    _changes.resize(_slots.size());
+                    _changes.mark(index);
                     return Id{index, 1u};
                 }
             }
@@ -47,6 +62,7 @@ namespace cinder
                 if (this->is_id_valid(id))
                 {
                     _slots[s_cast<size_t>(id.index)] = std::nullopt;
+                    _changes.unmark(id.index);
                     _versions[s_cast<size_t>(id.index)] += 1;
                     if (_versions[s_cast<size_t>(id.index)] < std::numeric_limits<u32>::max())
                     {
@@ -56,9 +72,10 @@ namespace cinder
                 }
                 return false;
             }
+            // Returns nullptr for free slots.
             auto slot_by_index(size_t index) -> T *
             {
-                if (index < this->_slots.size())
+                if (index < this->_slots.size() && _slots[index].has_value())
                 {
                     return &_slots[index].value();
                 }
@@ -85,6 +102,43 @@ namespace cinder
                 auto const uz_index = s_cast<size_t>(id.index);
                 return uz_index < _slots.size() && _versions[uz_index] == id.version;
             }
+            auto mark_dirty(Id id) -> bool
+            {
+                if (this->is_id_valid(id))
+                {
+                    _changes.mark(id.index);
+                    return true;
+                }
+                return false;
+            }
+            // Calls fn(Id) for every dirty slot, in ascending slot index order.
+            template <typename FnT>
+            void for_each_dirty(FnT && fn) const
+            {
+                _changes.for_each_dirty([&](u32 index)
+                    { fn(Id{index, _versions[index]}); });
+            }
+            // Calls fn(Id) for every live slot changed in epoch or later.
+            template <typename FnT>
+            void for_each_changed_since(u32 epoch, FnT && fn) const
+            {
+                _changes.for_each_changed_since(epoch, [&](u32 index)
+                    {
+                        if (_slots[index].has_value()) { fn(Id{index, _versions[index]}); } });
+            }
+            auto dirty_count() const -> usize
+            {
+                return _changes.dirty_count();
+            }
+            // Ends the current change epoch.
+            void clear_dirty()
+            {
+                _changes.clear();
+            }
+            auto epoch() const -> u32
+            {
+                return _changes.epoch();
+            }
             auto size() const -> usize
             {
                 return _slots.size() - _free_list.size();
@@ -94,4 +148,201 @@ namespace cinder
                 return _slots.size();
             }
         };
+
+    /**
+     * DESCRIPTION:
+     * Same interface as SlotMap, but the values are packed contiguously in a dense array.
+     * A sparse table maps the slot index of an Id to the dense index of its value.
+     * NOTES:
+     * - Iterating the live values (values(), begin/end) is a linear loop over size() elements, free slots are never touched
+     * - Values are stored in pages (PagedArray), creating slots never moves existing values
+     * - destroy_slot swap removes, the last value is moved into the hole. Dense indices and pointers to values
+     *   stay valid across creates, but not across destroys
+     * - Ids stay valid across destroys of other slots, slot indices are recycled like in SlotMap
+     * - Changes are tracked per slot index like in SlotMap
+     * THREADSAFETY:
+     * * not synchronized
+     */
+    template <typename T>
+    struct DenseSlotMap
+    {
+        private:
+            PagedArray<T>
+                _values = {};
+            // Slot index of every value, _values[i] is owned by the slot _dense_to_sparse[i].
+            std::vector<u32>
+                _dense_to_sparse = {};
+            // Dense index of every slot, INVALID_DENSE_INDEX for free slots.
+            std::vector<u32>
+                _sparse_to_dense = {};
+            std::vector<u32>
+                _versions = {};
+            std::vector<u32>
+                _free_list = {};
+            SlotChangeTracker
+                _changes = {};
+
+        public:
+            struct Id
+            {
+                u32 index = {};
+                u32 version = {};
+            };
+            static inline constexpr Id EMPTY_ID = { 0, 0 };
+            static inline constexpr u32 INVALID_DENSE_INDEX = std::numeric_limits<u32>::max();
+            auto create_slot(T&& v = {}) -> Id
+            {
+                u32 index = {};
+                if (_free_list.size() > 0)
+                {
+                    index = _free_list.back();
+                    _free_list.pop_back();
+                }
+                else
+                {
+                    index = s_cast<u32>(_sparse_to_dense.size());
+                    _sparse_to_dense.emplace_back(INVALID_DENSE_INDEX);
+                    _versions.emplace_back(1u);
+                    _changes.resize(_versions.size());
+                }
+                _sparse_to_dense[index] = s_cast<u32>(_values.size());
+                _values.emplace_back(std::move(v));
+                _dense_to_sparse.emplace_back(index);
+                _changes.mark(index);
+                return Id{index, _versions[index]};
+            }
+            auto destroy_slot(Id id) -> bool
+            {
+                if (this->is_id_valid(id))
+                {
+                    u32 const dense_index = _sparse_to_dense[id.index];
+                    u32 const last_dense_index = s_cast<u32>(_values.size() - 1);
+                    /// NOTE: Swap remove, the last value takes the place of the destroyed one.
+                    if (dense_index != last_dense_index)
+                    {
+                        _values[dense_index] = std::move(_values[last_dense_index]);
+                        _dense_to_sparse[dense_index] = _dense_to_sparse[last_dense_index];
+                        _sparse_to_dense[_dense_to_sparse[dense_index]] = dense_index;
+                    }
+                    _values.pop_back();
+                    _dense_to_sparse.pop_back();
+                    _sparse_to_dense[id.index] = INVALID_DENSE_INDEX;
+                    _changes.unmark(id.index);
+                    _versions[id.index] += 1;
+                    if (_versions[id.index] < std::numeric_limits<u32>::max())
+                    {
+                        _free_list.push_back(id.index);
+                    }
+                    return true;
+                }
+                return false;
+            }
+            // Returns nullptr for free slots.
+            auto slot_by_index(size_t index) -> T *
+            {
+                if (index < _sparse_to_dense.size() && _sparse_to_dense[index] != INVALID_DENSE_INDEX)
+                {
+                    return &_values[_sparse_to_dense[index]];
+                }
+                return nullptr;
+            }
+            auto slot_by_index(size_t index) const -> T const *
+            {
+                if (index < _sparse_to_dense.size() && _sparse_to_dense[index] != INVALID_DENSE_INDEX)
+                {
+                    return &_values[_sparse_to_dense[index]];
+                }
+                return nullptr;
+            }
+            auto slot(Id id) -> T *
+            {
+                if (this->is_id_valid(id))
+                {
+                    return &_values[_sparse_to_dense[id.index]];
+                }
+                return nullptr;
+            }
+            auto slot(Id id) const -> T const *
+            {
+                if (this->is_id_valid(id))
+                {
+                    return &_values[_sparse_to_dense[id.index]];
+                }
+                return nullptr;
+            }
+            auto is_id_valid(Id id) const -> bool
+            {
+                auto const uz_index = s_cast<size_t>(id.index);
+                return uz_index < _versions.size() && _versions[uz_index] == id.version;
+            }
+            // Live values, packed. values()[i] belongs to id_by_dense_index(i).
+            auto values() -> PagedArray<T> &
+            {
+                return _values;
+            }
+            auto values() const -> PagedArray<T> const &
+            {
+                return _values;
+            }
+            auto id_by_dense_index(size_t dense_index) const -> Id
+            {
+                u32 const index = _dense_to_sparse[dense_index];
+                return Id{index, _versions[index]};
+            }
+            // Id of the current value in slot index, only meaningful for live slots.
+            auto id_by_index(size_t index) const -> Id
+            {
+                return Id{s_cast<u32>(index), _versions[index]};
+            }
+            auto begin() { return _values.begin(); }
+            auto end() { return _values.end(); }
+            auto begin() const { return _values.begin(); }
+            auto end() const { return _values.end(); }
+            auto mark_dirty(Id id) -> bool
+            {
+                if (this->is_id_valid(id))
+                {
+                    _changes.mark(id.index);
+                    return true;
+                }
+                return false;
+            }
+            // Calls fn(Id) for every dirty slot, in ascending slot index order.
+            template <typename FnT>
+            void for_each_dirty(FnT && fn) const
+            {
+                _changes.for_each_dirty([&](u32 index)
+                    { fn(Id{index, _versions[index]}); });
+            }
+            // Calls fn(Id) for every live slot changed in epoch or later.
+            template <typename FnT>
+            void for_each_changed_since(u32 epoch, FnT && fn) const
+            {
+                _changes.for_each_changed_since(epoch, [&](u32 index)
+                    {
+                        if (_sparse_to_dense[index] != INVALID_DENSE_INDEX) { fn(Id{index, _versions[index]}); } });
+            }
+            auto dirty_count() const -> usize
+            {
+                return _changes.dirty_count();
+            }
+            // Ends the current change epoch.
+            void clear_dirty()
+            {
+                _changes.clear();
+            }
+            auto epoch() const -> u32
+            {
+                return _changes.epoch();
+            }
+            auto size() const -> usize
+            {
+                return _values.size();
+            }
+            // Amount of slot indices handed out so far, ids index into [0, capacity()).
+            auto capacity() const -> usize
+            {
+                return _versions.size();
+            }
+        };
 }
\ No newline at end of file